@@ -26,6 +26,7 @@
  * compressed frame arrives from the server.
  */
 static void Cl_WriteDemoHeader(void) {
+	extern int32_t cm_bvh_mode;
 	static entity_state_t null_state;
 	mem_buf_t msg;
 	byte buffer[MAX_MSG_SIZE];
@@ -44,6 +45,19 @@ static void Cl_WriteDemoHeader(void) {
 	Net_WriteShort(&msg, cl.client_num);
 	Net_WriteString(&msg, cl.config_strings[CS_NAME]);
 
+	vec3_t mins, maxs;
+	Net_GetBounds(mins, maxs);
+
+	Net_WritePosition(&msg, mins);
+	Net_WritePosition(&msg, maxs);
+
+	Net_WriteByte(&msg, cm_bvh_mode);
+
+	// and no connection bundle, as the config strings and baselines follow
+	Net_WriteString(&msg, "");
+	Net_WriteString(&msg, "");
+	Net_WriteLong(&msg, 0);
+
 	// and config_strings
 	for (size_t i = 0; i < MAX_CONFIG_STRINGS; i++) {
 		if (*cl.config_strings[i] != '\0') {
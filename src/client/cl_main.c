@@ -75,8 +75,11 @@ static void Cl_SendConnect(void) {
 	if (addr.port == 0) // use default port
 		addr.port = htons(PORT_SERVER);
 
-	Netchan_OutOfBandPrint(NS_UDP_CLIENT, &addr, "connect %i %i %u \"%s\"\n", PROTOCOL_MAJOR,
-			qport->integer, cls.challenge, Cvar_UserInfo());
+	// offer compression with our Huffman model, if we want it
+	const int32_t compress = net_compress->integer ? NET_HUFFMAN_MODEL : 0;
+
+	Netchan_OutOfBandPrint(NS_UDP_CLIENT, &addr, "connect %i %i %u \"%s\" %i\n", PROTOCOL_MAJOR,
+			qport->integer, cls.challenge, Cvar_UserInfo(), compress);
 
 	cvar_user_info_modified = false;
 }
@@ -288,6 +291,8 @@ void Cl_Disconnect(void) {
 
 	Cl_SendDisconnect(); // tell the server to deallocate us
 
+	Netchan_Release(&cls.net_chan);
+
 	if (cls.demo_file) { // stop demo recording
 		Cl_Stop_f();
 	}
@@ -303,6 +308,8 @@ void Cl_Disconnect(void) {
 		cls.download.file = NULL;
 	}
 
+	Cl_FreeBundle();
+
 	memset(cls.server_name, 0, sizeof(cls.server_name));
 
 	Cl_SetKeyDest(KEY_CONSOLE);
@@ -373,14 +380,17 @@ static void Cl_ConnectionlessPacket(void) {
 
 		Netchan_Setup(NS_UDP_CLIENT, &cls.net_chan, &net_from, qport->integer);
 
+		// the server has chosen whether to compress our packets, and with which model
+		cls.net_chan.compress = strtol(Cmd_Argv(1), NULL, 0) == NET_HUFFMAN_MODEL;
+
 		Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
 		Net_WriteString(&cls.net_chan.message, "new");
 
 		cls.state = CL_CONNECTED;
 
 		memset(cls.download_url, 0, sizeof(cls.download_url));
-		if (Cmd_Argc() == 2) { // http download url
-			g_strlcpy(cls.download_url, Cmd_Argv(1), sizeof(cls.download_url));
+		if (Cmd_Argc() == 3) { // http download url
+			g_strlcpy(cls.download_url, Cmd_Argv(2), sizeof(cls.download_url));
 		}
 		return;
 	}
@@ -539,6 +549,7 @@ static void Cl_InitLocal(void) {
 	Cmd_Add("disconnect", Cl_Disconnect_f, CMD_CLIENT, NULL);
 	Cmd_Add("rcon", Cl_Rcon_f, CMD_CLIENT, NULL);
 	Cmd_Add("precache", Cl_Precache_f, CMD_CLIENT, NULL);
+	Cmd_Add("bundle", Cl_Bundle_f, CMD_CLIENT, NULL);
 	Cmd_Add("download", Cl_Download_f, CMD_CLIENT, NULL);
 
 	// forward anything we don't handle locally to the server
@@ -671,12 +682,15 @@ void Cl_Frame(const uint32_t msec) {
  * @brief
  */
 void Cl_Init(void) {
+	extern _Bool cm_retain_bsp_file;
 
 	memset(&cls, 0, sizeof(cls));
 
 	if (dedicated->value)
 		return; // nothing running on the client
 
+	cm_retain_bsp_file = true; // the renderer shares the collision model's BSP file
+
 	cls.state = CL_DISCONNECTED;
 
 	Cl_InitConsole();
@@ -32,7 +32,8 @@ static char *sv_cmd_names[32] = {
 		"SV_CMD_PRINT",
 		"SV_CMD_RECONNECT",
 		"SV_CMD_SERVER_DATA",
-		"SV_CMD_SOUND" };
+		"SV_CMD_SOUND",
+		"SV_CMD_BUNDLE" };
 
 /**
  * @brief Returns true if the file exists, otherwise it attempts to start a download
@@ -73,21 +74,34 @@ _Bool Cl_CheckOrDownloadFile(const char *filename) {
 	// open the file if not opened yet
 
 	if (Fs_Exists(cls.download.tempname)) { // a temp file exists, resume download
-		int64_t len = Fs_Load(cls.download.tempname, NULL);
+		int64_t len = -1;
 
-		if ((cls.download.file = Fs_OpenAppend(cls.download.tempname))) {
+		file_t *file;
+		if ((file = Fs_OpenRead(cls.download.tempname))) {
+			len = Fs_Length(file);
+			Fs_Close(file);
+		}
 
-			if (Fs_Seek(cls.download.file, len - 1)) {
-				// give the server the offset to start the download
-				Com_Debug("Resuming %s...\n", cls.download.name);
+		// the server verifies the tail of what we have before resuming
+		char *checksum = NULL;
+		if (len > 0) {
+			const int64_t check = MIN(len, DOWNLOAD_RESUME_CHECK);
+			checksum = Fs_Checksum(cls.download.tempname, len - check, check);
+		}
 
-				g_snprintf(cmd, sizeof(cmd), "download %s %u", cls.download.name, (uint32_t) len);
-				Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
-				Net_WriteString(&cls.net_chan.message, cmd);
+		if (checksum && (cls.download.file = Fs_OpenAppend(cls.download.tempname))) {
+			// give the server the offset to start the download
+			Com_Debug("Resuming %s...\n", cls.download.name);
 
-				return false;
-			}
+			g_snprintf(cmd, sizeof(cmd), "download %s %" PRId64 " %s", cls.download.name, len, checksum);
+			Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
+			Net_WriteString(&cls.net_chan.message, cmd);
+
+			g_free(checksum);
+			return false;
 		}
+
+		g_free(checksum);
 	}
 
 	// or start if from the beginning
@@ -113,6 +127,31 @@ void Cl_Download_f(void) {
 	Cl_CheckOrDownloadFile(Cmd_Argv(1));
 }
 
+/**
+ * @brief
+ */
+static void Cl_ParseBaseline(void) {
+	static entity_state_t null_state;
+
+	const uint16_t number = Net_ReadShort(&net_message);
+	const uint16_t bits = Net_ReadShort(&net_message);
+
+	cl_entity_t *ent = &cl.entities[number];
+
+	Net_ReadDeltaEntity(&net_message, &null_state, &ent->baseline, number, bits);
+
+	// initialize clipping matrices
+	if (ent->baseline.solid) {
+		if (ent->baseline.solid == SOLID_BSP) {
+			Matrix4x4_CreateFromEntity(&ent->matrix, ent->baseline.origin, ent->baseline.angles, 1.0);
+			Matrix4x4_Invert_Simple(&ent->inverse_matrix, &ent->matrix);
+		} else { // bounding-box entities
+			Matrix4x4_CreateFromEntity(&ent->matrix, ent->baseline.origin, vec3_origin, 1.0);
+			Matrix4x4_Invert_Simple(&ent->inverse_matrix, &ent->matrix);
+		}
+	}
+}
+
 /**
  * @brief The server sends this command just after server_data. Hang onto the spawn
  * count and check for the media we'll need to enter the game.
@@ -132,27 +171,190 @@ void Cl_Precache_f(void) {
 }
 
 /**
- * @brief
+ * @brief Frees the connection bundle being received, if any.
  */
-static void Cl_ParseBaseline(void) {
-	static entity_state_t null_state;
+void Cl_FreeBundle(void) {
 
-	const uint16_t number = Net_ReadShort(&net_message);
-	const uint16_t bits = Net_ReadShort(&net_message);
+	if (cls.bundle.data) {
+		Mem_Free(cls.bundle.data);
+	}
 
-	cl_entity_t *ent = &cl.entities[number];
+	memset(&cls.bundle, 0, sizeof(cls.bundle));
+}
 
-	Net_ReadDeltaEntity(&net_message, &null_state, &ent->baseline, number, bits);
+/**
+ * @brief Decodes the connection bundle and parses the config strings and
+ * baselines it contains, as though they had arrived in net_message.
+ *
+ * @return True if the bundle was intact.
+ */
+static _Bool Cl_LoadBundle(const byte *data, size_t size) {
 
-	// initialize clipping matrices
-	if (ent->baseline.solid) {
-		if (ent->baseline.solid == SOLID_BSP) {
-			Matrix4x4_CreateFromEntity(&ent->matrix, ent->baseline.origin, ent->baseline.angles, 1.0);
-			Matrix4x4_Invert_Simple(&ent->inverse_matrix, &ent->matrix);
-		} else { // bounding-box entities
-			Matrix4x4_CreateFromEntity(&ent->matrix, ent->baseline.origin, vec3_origin, 1.0);
-			Matrix4x4_Invert_Simple(&ent->inverse_matrix, &ent->matrix);
+	if (size < 8) {
+		return false;
+	}
+
+	mem_buf_t header;
+	Mem_InitBuffer(&header, (byte *) data, size);
+	header.size = size;
+
+	const size_t raw_size = (uint32_t) Net_ReadLong(&header);
+	const size_t coded_size = (uint32_t) Net_ReadLong(&header);
+
+	byte *raw = Mem_Malloc(raw_size + 1);
+
+	if (coded_size) {
+		if (coded_size != size - 8 || !Net_HuffmanDecode(data + 8, coded_size, raw, raw_size)) {
+			Mem_Free(raw);
+			return false;
 		}
+	} else {
+		if (raw_size != size - 8) {
+			Mem_Free(raw);
+			return false;
+		}
+		memcpy(raw, data + 8, raw_size);
+	}
+
+	// parse the bundle in place of the current message
+	const mem_buf_t message = net_message;
+
+	Mem_InitBuffer(&net_message, raw, raw_size);
+	net_message.size = raw_size;
+
+	_Bool intact = true;
+
+	while (intact && net_message.read < net_message.size) {
+
+		switch (Net_ReadByte(&net_message)) {
+			case SV_CMD_BASELINE:
+				Cl_ParseBaseline();
+				break;
+
+			case SV_CMD_CONFIG_STRING:
+				Cl_ParseConfigString();
+				break;
+
+			default:
+				intact = false;
+				break;
+		}
+	}
+
+	intact = intact && net_message.read == net_message.size;
+
+	net_message = message;
+
+	Mem_Free(raw);
+	return intact;
+}
+
+/**
+ * @brief Requests the connection bundle from the offset we have received, or
+ * the config strings which follow it, if we have all of it.
+ */
+static void Cl_RequestBundle(void) {
+
+	Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
+	Net_WriteString(&cls.net_chan.message, va("bundle %i %s %u", cl.server_count, cls.bundle.hash,
+			(uint32_t) cls.bundle.received));
+}
+
+/**
+ * @brief Loads the received connection bundle, and caches it for subsequent
+ * connections.
+ */
+static void Cl_BundleComplete(void) {
+
+	if (!Cl_LoadBundle(cls.bundle.data, cls.bundle.size)) {
+		Com_Error(ERR_DROP, "Corrupt connection bundle\n");
+	}
+
+	file_t *file = Fs_OpenWrite(va("cache/%s.bundle", cls.bundle.name));
+	if (file) {
+		Fs_Write(file, cls.bundle.data, 1, cls.bundle.size);
+		Fs_Close(file);
+	}
+
+	Mem_Free(cls.bundle.data);
+	cls.bundle.data = NULL;
+}
+
+/**
+ * @brief Begins the connection bundle announced in server_data. If we have it
+ * cached, it is loaded immediately, so that the config strings which follow it
+ * are not overwritten. Otherwise, request it, or the remainder of it.
+ */
+static void Cl_BeginBundle(const char *name, const char *hash, size_t size) {
+
+	// a different bundle than the one we're receiving
+	if (g_strcmp0(cls.bundle.hash, hash) || cls.bundle.size != size || !cls.bundle.data) {
+		Cl_FreeBundle();
+
+		if (!size) { // demos carry their config strings and baselines inline
+			return;
+		}
+
+		g_strlcpy(cls.bundle.name, name, sizeof(cls.bundle.name));
+		g_strlcpy(cls.bundle.hash, hash, sizeof(cls.bundle.hash));
+		cls.bundle.size = size;
+
+		void *buffer;
+		const int64_t len = Fs_Load(va("cache/%s.bundle", name), &buffer);
+
+		if (len != -1) {
+			char *checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1, buffer, len);
+
+			if (!g_strcmp0(checksum, hash)) {
+				if (Cl_LoadBundle(buffer, len)) {
+					Com_Debug("Loaded cached bundle %s\n", hash);
+					cls.bundle.received = size;
+				} else {
+					Com_Warn("Cached bundle %s is corrupt\n", hash);
+				}
+			}
+
+			g_free(checksum);
+			Fs_Free(buffer);
+		}
+
+		if (cls.bundle.received < size) {
+			cls.bundle.data = Mem_Malloc(size);
+		}
+	}
+
+	Cl_RequestBundle();
+}
+
+/**
+ * @brief The server sends this command when the reliable queue could not take
+ * the whole connection bundle. Request the remainder of it.
+ */
+void Cl_Bundle_f(void) {
+
+	if (cls.state != CL_CONNECTED || !cls.bundle.size) {
+		return;
+	}
+
+	Cl_RequestBundle();
+}
+
+/**
+ * @brief Appends a piece of the connection bundle.
+ */
+static void Cl_ParseBundle(void) {
+
+	const size_t len = (uint16_t) Net_ReadShort(&net_message);
+
+	if (!cls.bundle.data || cls.bundle.received + len > cls.bundle.size) {
+		Com_Error(ERR_DROP, "Unexpected bundle data\n");
+	}
+
+	Net_ReadData(&net_message, cls.bundle.data + cls.bundle.received, len);
+	cls.bundle.received += len;
+
+	if (cls.bundle.received == cls.bundle.size) {
+		Cl_BundleComplete();
 	}
 }
 
@@ -210,12 +412,34 @@ static void Cl_ParseDownload(void) {
 	// read the data
 	size = Net_ReadShort(&net_message);
 	percent = Net_ReadByte(&net_message);
+	if (size == DOWNLOAD_FAILED) {
+		Com_Warn("Server failed to send %s\n", cls.download.name);
+
+		if (cls.download.file) { // don't resume what the server can't send
+			Fs_Close(cls.download.file);
+			cls.download.file = NULL;
+
+			Fs_Unlink(cls.download.tempname);
+		}
+
+		Cl_RequestNextDownload();
+		return;
+	}
+
 	if (size < 0) {
-		Com_Debug("Server does not have this file\n");
 		if (cls.download.file) {
-			// if here, we tried to resume a file but the server said no
+			// if here, we tried to resume a file but the server said no, so start over
+			Com_Debug("Server refused to resume %s\n", cls.download.name);
+
 			Fs_Close(cls.download.file);
 			cls.download.file = NULL;
+
+			Fs_Unlink(cls.download.tempname);
+
+			if (!Cl_CheckOrDownloadFile(cls.download.name))
+				return;
+		} else {
+			Com_Debug("Server does not have this file\n");
 		}
 		Cl_RequestNextDownload();
 		return;
@@ -236,10 +460,8 @@ static void Cl_ParseDownload(void) {
 
 	net_message.read += size;
 
-	if (percent != 100) {
-		Net_WriteByte(&cls.net_chan.message, CL_CMD_STRING);
-		Net_WriteString(&cls.net_chan.message, "next_download");
-	} else {
+	// the server streams the rest of the file without further requests
+	if (percent == 100) {
 		Fs_Close(cls.download.file);
 		cls.download.file = NULL;
 
@@ -261,6 +483,7 @@ static void Cl_ParseDownload(void) {
  * @brief
  */
 static void Cl_ParseServerData(void) {
+	extern int32_t cm_bvh_mode;
 
 	// wipe the cl_client_t struct
 	Cl_ClearState();
@@ -307,6 +530,26 @@ static void Cl_ParseServerData(void) {
 	str = Net_ReadString(&net_message);
 	Com_Print("\n");
 	Com_Print("%c%s\n", 2, str);
+
+	// and the bounds within which positions are quantized
+	vec3_t mins, maxs;
+	Net_ReadPosition(&net_message, mins);
+	Net_ReadPosition(&net_message, maxs);
+
+	Net_SetBounds(mins, maxs);
+
+	// and clip as the server does, should we load the world model
+	cm_bvh_mode = Clamp(Net_ReadByte(&net_message), CM_BVH_NEVER, CM_BVH_ALWAYS);
+
+	// and the connection bundle, which we may already have
+	char name[MAX_QPATH], hash[64];
+
+	g_strlcpy(name, Net_ReadString(&net_message), sizeof(name));
+	g_strlcpy(hash, Net_ReadString(&net_message), sizeof(hash));
+
+	const size_t size = (uint32_t) Net_ReadLong(&net_message);
+
+	Cl_BeginBundle(name, hash, size);
 }
 
 /**
@@ -490,6 +733,10 @@ void Cl_ParseServerMessage(void) {
 				Cl_ParseSound();
 				break;
 
+			case SV_CMD_BUNDLE:
+				Cl_ParseBundle();
+				break;
+
 			default:
 				// delegate to the client game module before failing
 				if (!cls.cgame->ParseMessage(cmd)) {
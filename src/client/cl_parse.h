@@ -29,6 +29,8 @@ _Bool Cl_CheckOrDownloadFile(const char *file_name);
 void Cl_ParseConfigString(void);
 void Cl_ParseServerMessage(void);
 void Cl_Download_f(void);
+void Cl_Bundle_f(void);
+void Cl_FreeBundle(void);
 void Cl_Precache_f(void);
 #endif /* __CL_LOCAL_H__ */
 
@@ -259,6 +259,18 @@ typedef struct {
 	char name[MAX_OS_PATH];
 } cl_download_t;
 
+/**
+ * @brief The connection bundle of config strings and baselines, as it is
+ * received from the server. It is cached by level name.
+ */
+typedef struct {
+	char name[MAX_QPATH];
+	char hash[64];
+	byte *data;
+	size_t size;
+	size_t received;
+} cl_bundle_t;
+
 // server information, for finding network games
 typedef enum {
 	SERVER_SOURCE_INTERNET,
@@ -314,6 +326,7 @@ typedef struct {
 
 	char download_url[MAX_OS_PATH]; // for http downloads
 	cl_download_t download; // current download (udp or http)
+	cl_bundle_t bundle; // current connection bundle
 
 	char demo_filename[MAX_OS_PATH];
 	file_t *demo_file;
@@ -872,27 +872,24 @@ static void R_LoadBspSurfacesArrays(r_model_t *mod) {
 }
 
 /**
- * @brief
+ * @brief Loads the BSP model from the file opened by the collision model, which
+ * is shared rather than read a second time. The buffer is not used.
  */
-void R_LoadBspModel(r_model_t *mod, void *buffer) {
+void R_LoadBspModel(r_model_t *mod, void *buffer __attribute__((unused))) {
 	extern void Cl_LoadingProgress(uint16_t percent, const char *file);
 
-	// byte-swap the entire header
-	d_bsp_header_t header = *(d_bsp_header_t *) buffer;
-
-	for (size_t i = 0; i < sizeof(d_bsp_header_t) / sizeof(int32_t); i++) {
-		((int32_t *) &header)[i] = LittleLong(((int32_t *) &header)[i]);
+	const cm_bsp_file_t *file = Cm_OpenBspFile(va("%s.bsp", mod->media.name));
+	if (!file) {
+		Com_Error(ERR_DROP, "Failed to load %s\n", mod->media.name);
 	}
 
-	if (header.version != BSP_VERSION && header.version != BSP_VERSION_QUETOO) {
-		Com_Error(ERR_DROP, "%s has unsupported version: %d\n", mod->media.name, header.version);
-	}
+	const d_bsp_header_t header = file->header;
 
 	mod->bsp = Mem_LinkMalloc(sizeof(r_bsp_model_t), mod);
 	mod->bsp->version = header.version;
 
 	// set the base pointer for lump loading
-	r_bsp_base = (byte *) buffer;
+	r_bsp_base = file->base;
 
 	R_LoadBspVertexes(mod->bsp, &header.lumps[BSP_LUMP_VERTEXES]);
 	Cl_LoadingProgress(4, "vertices");
@@ -936,6 +933,9 @@ void R_LoadBspModel(r_model_t *mod, void *buffer) {
 	R_LoadBspLights(mod->bsp);
 	Cl_LoadingProgress(50, "lights");
 
+	r_bsp_base = NULL;
+	Cm_CloseBspFile(file);
+
 	Com_Debug("!================================\n");
 	Com_Debug("!R_LoadBspModel: %s\n", mod->media.name);
 	Com_Debug("!  Verts:          %d\n", mod->bsp->num_vertexes);
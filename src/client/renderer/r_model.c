@@ -152,14 +152,17 @@ r_model_t *R_LoadModel(const char *name) {
 
 	if (!(mod = (r_model_t *) R_FindMedia(key))) {
 
-		void *buf;
+		void *buf = NULL;
 		const r_model_format_t *format = r_model_formats;
 		for (i = 0; i < lengthof(r_model_formats); i++, format++) {
 
 			StripExtension(name, key);
 			strcat(key, format->extension);
 
-			if (Fs_Load(key, &buf) != -1)
+			if (format->type == MOD_BSP) { // opened through the collision model
+				if (Fs_Exists(key))
+					break;
+			} else if (Fs_Load(key, &buf) != -1)
 				break;
 		}
 
@@ -0,0 +1,339 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "cm_local.h"
+
+/**
+ * @brief Selects which models are given a BVH at load. This is set by the
+ * server from `sv_collision_bvh`, and by the client from the server's data, so
+ * that prediction clips against the same structure as the server. The BVH is
+ * opt-in.
+ */
+int32_t cm_bvh_mode = CM_BVH_NEVER;
+
+/**
+ * @brief In CM_BVH_AUTO mode, models whose brushes are referenced by this many
+ * leafs on average, or whose leafs reference this many brushes on average, are
+ * given a BVH. Both are symptoms of the huge leafs of large, open maps.
+ */
+#define BVH_AUTO_REFS_PER_BRUSH		2.0
+#define BVH_AUTO_REFS_PER_LEAF		16.0
+
+/**
+ * @brief Nodes with this many brushes or fewer are always made leafs.
+ */
+#define BVH_LEAF_BRUSHES			4
+
+/**
+ * @brief The number of bins used to evaluate candidate splits.
+ */
+#define BVH_BINS					16
+
+/**
+ * @brief A brush being sorted into the hierarchy.
+ */
+typedef struct {
+	vec3_t mins, maxs;
+	vec3_t center;
+	int32_t brush;
+} cm_bvh_brush_t;
+
+/**
+ * @brief BVH builder state.
+ */
+typedef struct {
+	cm_bvh_t *bvh;
+	cm_bvh_brush_t *brushes;
+} cm_bvh_build_t;
+
+/**
+ * @return The surface area of the given bounds.
+ */
+static vec_t Cm_BvhArea(const vec3_t mins, const vec3_t maxs) {
+
+	const vec_t x = maxs[0] - mins[0];
+	const vec_t y = maxs[1] - mins[1];
+	const vec_t z = maxs[2] - mins[2];
+
+	return 2.0 * (x * y + y * z + z * x);
+}
+
+/**
+ * @brief Recursively builds the node at the given index over the specified
+ * run of brushes, splitting it where the surface area heuristic is minimal.
+ */
+static void Cm_BuildBvhNode(cm_bvh_build_t *build, int32_t node_num, int32_t first, int32_t count,
+		int32_t depth) {
+
+	cm_bvh_brush_t *brushes = build->brushes + first;
+
+	vec3_t mins, maxs, center_mins, center_maxs;
+
+	ClearBounds(mins, maxs);
+	ClearBounds(center_mins, center_maxs);
+
+	for (int32_t i = 0; i < count; i++) {
+		AddPointToBounds(brushes[i].mins, mins, maxs);
+		AddPointToBounds(brushes[i].maxs, mins, maxs);
+		AddPointToBounds(brushes[i].center, center_mins, center_maxs);
+	}
+
+	cm_bvh_node_t *node = &build->bvh->nodes[node_num];
+
+	VectorCopy(mins, node->mins);
+	VectorCopy(maxs, node->maxs);
+
+	// split along the axis on which the brush centers are most spread out
+	int32_t axis = 0;
+	vec3_t extent;
+
+	VectorSubtract(center_maxs, center_mins, extent);
+
+	if (extent[1] > extent[axis])
+		axis = 1;
+	if (extent[2] > extent[axis])
+		axis = 2;
+
+	int32_t split = -1;
+
+	if (count > BVH_LEAF_BRUSHES && depth < CM_BVH_MAX_DEPTH && extent[axis] > 0.0) {
+
+		struct {
+			vec3_t mins, maxs;
+			int32_t count;
+		} bins[BVH_BINS];
+
+		for (int32_t i = 0; i < BVH_BINS; i++) {
+			ClearBounds(bins[i].mins, bins[i].maxs);
+			bins[i].count = 0;
+		}
+
+		const vec_t scale = BVH_BINS / extent[axis];
+
+		for (int32_t i = 0; i < count; i++) {
+			const int32_t b = Clamp((int32_t) ((brushes[i].center[axis] - center_mins[axis]) * scale), 0, BVH_BINS - 1);
+
+			AddPointToBounds(brushes[i].mins, bins[b].mins, bins[b].maxs);
+			AddPointToBounds(brushes[i].maxs, bins[b].mins, bins[b].maxs);
+			bins[b].count++;
+		}
+
+		// sweep from the right to accumulate the cost of each right side
+		vec_t right_cost[BVH_BINS];
+		vec3_t right_mins, right_maxs;
+		int32_t right_count = 0;
+
+		ClearBounds(right_mins, right_maxs);
+
+		for (int32_t i = BVH_BINS - 1; i > 0; i--) {
+			if (bins[i].count) {
+				AddPointToBounds(bins[i].mins, right_mins, right_maxs);
+				AddPointToBounds(bins[i].maxs, right_mins, right_maxs);
+				right_count += bins[i].count;
+			}
+			right_cost[i] = right_count ? right_count * Cm_BvhArea(right_mins, right_maxs) : 0.0;
+		}
+
+		// and then from the left, selecting the cheapest split
+		vec_t best_cost = count * Cm_BvhArea(mins, maxs); // the cost of not splitting
+		vec3_t left_mins, left_maxs;
+		int32_t left_count = 0;
+
+		ClearBounds(left_mins, left_maxs);
+
+		for (int32_t i = 0; i < BVH_BINS - 1; i++) {
+			if (bins[i].count) {
+				AddPointToBounds(bins[i].mins, left_mins, left_maxs);
+				AddPointToBounds(bins[i].maxs, left_mins, left_maxs);
+				left_count += bins[i].count;
+			}
+
+			if (left_count == 0 || left_count == count)
+				continue;
+
+			const vec_t cost = left_count * Cm_BvhArea(left_mins, left_maxs) + right_cost[i + 1];
+			if (cost < best_cost) {
+				best_cost = cost;
+				split = i;
+			}
+		}
+
+		// partition the brushes about the split
+		if (split != -1) {
+			int32_t i = 0, j = count - 1;
+
+			while (i <= j) {
+				const int32_t b = Clamp((int32_t) ((brushes[i].center[axis] - center_mins[axis]) * scale), 0, BVH_BINS - 1);
+
+				if (b <= split) {
+					i++;
+				} else {
+					const cm_bvh_brush_t swap = brushes[i];
+					brushes[i] = brushes[j];
+					brushes[j--] = swap;
+				}
+			}
+
+			split = i;
+		}
+	}
+
+	if (split <= 0 || split >= count) { // make a leaf
+		node->first = build->bvh->num_brushes;
+		node->count = count;
+
+		for (int32_t i = 0; i < count; i++) {
+			build->bvh->brushes[build->bvh->num_brushes++] = brushes[i].brush;
+		}
+
+		return;
+	}
+
+	// children are allocated in pairs
+	node->first = build->bvh->num_nodes;
+	node->count = 0;
+
+	build->bvh->num_nodes += 2;
+
+	Cm_BuildBvhNode(build, node->first + 0, first, split, depth + 1);
+	Cm_BuildBvhNode(build, node->first + 1, first + split, count - split, depth + 1);
+}
+
+/**
+ * @brief Model brush gathering state.
+ */
+typedef struct {
+	int32_t *brushes;
+	int32_t num_brushes;
+
+	int32_t *marks; // the model that last gathered each brush
+	int32_t mark;
+
+	int32_t num_leafs, num_refs;
+} cm_bvh_gather_t;
+
+/**
+ * @brief Gathers the unique brushes referenced by the leafs beneath the
+ * given node.
+ */
+static void Cm_GatherBvhBrushes_r(cm_bvh_gather_t *gather, int32_t num) {
+
+	while (num >= 0) {
+		const cm_bsp_node_t *node = &cm_bsp.nodes[num];
+
+		Cm_GatherBvhBrushes_r(gather, node->children[0]);
+		num = node->children[1];
+	}
+
+	const cm_bsp_leaf_t *leaf = &cm_bsp.leafs[-1 - num];
+
+	if (leaf->num_leaf_brushes) {
+		gather->num_leafs++;
+	}
+
+	for (int32_t i = 0; i < leaf->num_leaf_brushes; i++) {
+		const int32_t brush_num = cm_bsp.leaf_brushes[leaf->first_leaf_brush + i];
+
+		gather->num_refs++;
+
+		if (gather->marks[brush_num] == gather->mark)
+			continue;
+
+		gather->marks[brush_num] = gather->mark;
+
+		if (cm_bsp.brushes[brush_num].num_sides) {
+			gather->brushes[gather->num_brushes++] = brush_num;
+		}
+	}
+}
+
+/**
+ * @brief Builds a BVH over the brushes of each model selected by
+ * `cm_bvh_mode`, and attaches it to the model's head node so that
+ * Cm_BoxTrace may use it in place of the BSP.
+ */
+void Cm_BuildBvhs(void) {
+
+	if (cm_bvh_mode == CM_BVH_NEVER || !cm_bsp.num_brushes)
+		return;
+
+	cm_bsp.bvhs = Mem_Malloc(cm_bsp.num_models * sizeof(cm_bvh_t));
+
+	cm_bvh_gather_t gather;
+	memset(&gather, 0, sizeof(gather));
+
+	gather.brushes = Mem_LinkMalloc(cm_bsp.num_brushes * sizeof(int32_t), cm_bsp.bvhs);
+	gather.marks = Mem_LinkMalloc(cm_bsp.num_brushes * sizeof(int32_t), cm_bsp.bvhs);
+
+	cm_bvh_build_t build;
+	build.brushes = Mem_LinkMalloc(cm_bsp.num_brushes * sizeof(cm_bvh_brush_t), cm_bsp.bvhs);
+
+	for (int32_t i = 0; i < cm_bsp.num_models; i++) {
+		const cm_bsp_model_t *model = &cm_bsp.models[i];
+
+		if (model->head_node < 0)
+			continue;
+
+		gather.num_brushes = gather.num_leafs = gather.num_refs = 0;
+		gather.mark = i + 1;
+
+		Cm_GatherBvhBrushes_r(&gather, model->head_node);
+
+		if (!gather.num_brushes)
+			continue;
+
+		if (cm_bvh_mode == CM_BVH_AUTO) {
+			const vec_t refs_per_brush = gather.num_refs / (vec_t) gather.num_brushes;
+			const vec_t refs_per_leaf = gather.num_refs / (vec_t) gather.num_leafs;
+
+			if (refs_per_brush < BVH_AUTO_REFS_PER_BRUSH && refs_per_leaf < BVH_AUTO_REFS_PER_LEAF)
+				continue;
+		}
+
+		for (int32_t j = 0; j < gather.num_brushes; j++) {
+			const cm_bsp_brush_t *brush = &cm_bsp.brushes[gather.brushes[j]];
+			cm_bvh_brush_t *b = &build.brushes[j];
+
+			VectorCopy(brush->mins, b->mins);
+			VectorCopy(brush->maxs, b->maxs);
+			VectorMix(brush->mins, brush->maxs, 0.5, b->center);
+			b->brush = gather.brushes[j];
+		}
+
+		cm_bvh_t *bvh = build.bvh = &cm_bsp.bvhs[i];
+
+		bvh->nodes = Mem_LinkMalloc(gather.num_brushes * 2 * sizeof(cm_bvh_node_t), cm_bsp.bvhs);
+		bvh->brushes = Mem_LinkMalloc(gather.num_brushes * sizeof(int32_t), cm_bsp.bvhs);
+		bvh->num_nodes = 1;
+
+		Cm_BuildBvhNode(&build, 0, 0, gather.num_brushes, 0);
+
+		cm_bsp.nodes[model->head_node].bvh = bvh;
+
+		Com_Debug("Model %d: %d brushes, %d nodes (%.1f refs per brush, %.1f per leaf)\n", i,
+				bvh->num_brushes, bvh->num_nodes, gather.num_refs / (vec_t) gather.num_brushes,
+				gather.num_refs / (vec_t) gather.num_leafs);
+	}
+
+	Mem_Free(gather.brushes);
+	Mem_Free(gather.marks);
+	Mem_Free(build.brushes);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __CM_BVH_H__
+#define __CM_BVH_H__
+
+#include "cm_types.h"
+
+/**
+ * @brief Bounding volume hierarchy selection modes, for `cm_bvh_mode`.
+ */
+#define CM_BVH_NEVER			0 // always descend the BSP
+#define CM_BVH_AUTO				1 // build a BVH for models that would benefit from one
+#define CM_BVH_ALWAYS			2 // build a BVH for every model
+
+#ifdef __CM_LOCAL_H__
+
+/**
+ * @brief BVH nodes bound either two child nodes, which are adjacent, or a run
+ * of brushes.
+ */
+typedef struct {
+	vec3_t mins, maxs;
+	int32_t first; // the first child node, or the first brush for leafs
+	int32_t count; // the number of brushes, or 0 for interior nodes
+} cm_bvh_node_t;
+
+/**
+ * @brief A bounding volume hierarchy over the brushes of one model, built with
+ * the surface area heuristic. Each brush is referenced exactly once.
+ */
+typedef struct cm_bvh_s {
+	cm_bvh_node_t *nodes;
+	int32_t num_nodes;
+
+	int32_t *brushes;
+	int32_t num_brushes;
+} cm_bvh_t;
+
+/**
+ * @brief The deepest BVH the builder will produce, which bounds the traversal
+ * stack.
+ */
+#define CM_BVH_MAX_DEPTH		48
+
+void Cm_BuildBvhs(void);
+#endif /* __CM_LOCAL_H__ */
+
+#endif /* __CM_BVH_H__ */
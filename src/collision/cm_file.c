@@ -0,0 +1,153 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "cm_local.h"
+
+/**
+ * @brief The BSP files currently open. This is rarely more than one.
+ */
+static GList *cm_bsp_files;
+
+/**
+ * @brief Attempts to memory-map the specified file, which succeeds only when
+ * it resides in a directory on the search path rather than in an archive.
+ */
+static _Bool Cm_MapBspFile(cm_bsp_file_t *file) {
+
+	const char *dir = Fs_RealDir(file->name);
+	if (!dir || !g_file_test(dir, G_FILE_TEST_IS_DIR)) {
+		return false;
+	}
+
+	gchar *path = g_build_filename(dir, file->name, NULL);
+	GError *error = NULL;
+
+	file->mapped_file = g_mapped_file_new(path, false, &error);
+
+	if (error) {
+		Com_Debug("Failed to map %s: %s\n", path, error->message);
+		g_error_free(error);
+	}
+
+	g_free(path);
+
+	if (!file->mapped_file) {
+		return false;
+	}
+
+	file->base = (const byte *) g_mapped_file_get_contents(file->mapped_file);
+	file->size = g_mapped_file_get_length(file->mapped_file);
+
+	return true;
+}
+
+/**
+ * @brief Opens the named BSP file, or adds a reference to it if it is already
+ * open. The byte-swapped header is validated before the file is returned.
+ *
+ * @return The file, or NULL if it could not be found.
+ */
+const cm_bsp_file_t *Cm_OpenBspFile(const char *name) {
+
+	for (GList *e = cm_bsp_files; e; e = e->next) {
+		cm_bsp_file_t *file = (cm_bsp_file_t *) e->data;
+
+		if (!g_strcmp0(file->name, name)) {
+			file->ref_count++;
+			return file;
+		}
+	}
+
+	cm_bsp_file_t *file = Mem_Malloc(sizeof(cm_bsp_file_t));
+	g_strlcpy(file->name, name, sizeof(file->name));
+
+	if (!Cm_MapBspFile(file)) {
+		file->size = Fs_Load(name, &file->buffer);
+		file->base = (const byte *) file->buffer;
+	}
+
+	if (file->size == -1) {
+		Mem_Free(file);
+		return NULL;
+	}
+
+	if (file->size < (int64_t) sizeof(d_bsp_header_t)) {
+		Cm_CloseBspFile(file);
+		Com_Error(ERR_DROP, "%s is truncated\n", name);
+	}
+
+	// byte-swap the entire header
+	file->header = *(const d_bsp_header_t *) file->base;
+	for (size_t i = 0; i < sizeof(d_bsp_header_t) / sizeof(int32_t); i++) {
+		((int32_t *) &file->header)[i] = LittleLong(((int32_t *) &file->header)[i]);
+	}
+
+	if (file->header.version != BSP_VERSION && file->header.version != BSP_VERSION_QUETOO) {
+		const int32_t version = file->header.version;
+		Cm_CloseBspFile(file);
+		Com_Error(ERR_DROP, "%s has unsupported version: %d\n", name, version);
+	}
+
+	for (int32_t i = 0; i < BSP_LUMPS; i++) {
+		const d_bsp_lump_t *l = &file->header.lumps[i];
+
+		if (l->file_ofs < 0 || l->file_len < 0 || (int64_t) l->file_ofs + l->file_len > file->size) {
+			Cm_CloseBspFile(file);
+			Com_Error(ERR_DROP, "%s has invalid lump %d\n", name, i);
+		}
+	}
+
+	file->ref_count = 1;
+
+	cm_bsp_files = g_list_prepend(cm_bsp_files, file);
+
+	Com_Debug("Opened %s (%s, %" PRId64 " bytes)\n", name, file->mapped_file ? "mapped" : "loaded",
+			file->size);
+
+	return file;
+}
+
+/**
+ * @brief Releases a reference to the specified BSP file, closing it once it
+ * is no longer referenced.
+ */
+void Cm_CloseBspFile(const cm_bsp_file_t *file) {
+
+	if (!file) {
+		return;
+	}
+
+	cm_bsp_file_t *f = (cm_bsp_file_t *) file;
+
+	if (--f->ref_count > 0) {
+		return;
+	}
+
+	cm_bsp_files = g_list_remove(cm_bsp_files, f);
+
+	if (f->mapped_file) {
+		g_mapped_file_unref(f->mapped_file);
+	} else {
+		Fs_Free(f->buffer);
+	}
+
+	Mem_Free(f);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __CM_FILE_H__
+#define __CM_FILE_H__
+
+#include "files.h"
+
+/**
+ * @brief A BSP file, shared by every subsystem that loads it. Files residing
+ * in a directory are memory-mapped; those inside archives are read once into a
+ * single buffer. The header is byte-swapped and its lumps are validated to lie
+ * within the file, but lump contents are in file byte order.
+ */
+typedef struct {
+	char name[MAX_QPATH];
+	d_bsp_header_t header;
+
+	const byte *base;
+	int64_t size;
+
+	int32_t ref_count;
+
+	GMappedFile *mapped_file;
+	void *buffer;
+} cm_bsp_file_t;
+
+const cm_bsp_file_t *Cm_OpenBspFile(const char *name);
+void Cm_CloseBspFile(const cm_bsp_file_t *file);
+
+#endif /* __CM_FILE_H__ */
@@ -307,14 +307,20 @@ static void Cm_LoadBspBrushSides(const d_bsp_lump_t *l) {
 }
 
 /**
- * @brief Sets brush bounds for fast trace tests.
+ * @brief Sets brush bounds for fast trace tests, and packs each brush's side
+ * planes into structure-of-arrays form for the SIMD clipping kernels. Padding
+ * planes have a zero normal and a huge distance, so that every point lies
+ * behind them.
  */
 static void Cm_SetupBspBrushes(void) {
 	cm_bsp_brush_t *b = cm_bsp.brushes;
 
+	size_t count = 0;
 	for (int32_t i = 0; i < cm_bsp.num_brushes; i++, b++) {
 		const cm_bsp_brush_side_t *bs = cm_bsp.brush_sides + b->first_brush_side;
 
+		b->sides = bs;
+
 		b->mins[0] = -bs[0].plane->dist;
 		b->mins[1] = -bs[2].plane->dist;
 		b->mins[2] = -bs[4].plane->dist;
@@ -322,6 +328,43 @@ static void Cm_SetupBspBrushes(void) {
 		b->maxs[0] = bs[1].plane->dist;
 		b->maxs[1] = bs[3].plane->dist;
 		b->maxs[2] = bs[5].plane->dist;
+
+		b->num_side_planes = (b->num_sides + CM_SIMD_WIDTH - 1) & ~(CM_SIMD_WIDTH - 1);
+		count += b->num_side_planes * 4;
+	}
+
+	if (count == 0)
+		return;
+
+	cm_bsp.side_planes = Mem_Malloc((count + CM_SIMD_WIDTH) * sizeof(vec_t));
+
+	const uintptr_t align = CM_SIMD_WIDTH * sizeof(vec_t);
+	vec_t *out = (vec_t *) (((uintptr_t) cm_bsp.side_planes + align - 1) & ~(align - 1));
+
+	b = cm_bsp.brushes;
+	for (int32_t i = 0; i < cm_bsp.num_brushes; i++, b++) {
+		const cm_bsp_brush_side_t *bs = cm_bsp.brush_sides + b->first_brush_side;
+		const int32_t n = b->num_side_planes;
+
+		b->side_planes = out;
+
+		for (int32_t j = 0; j < n; j++) {
+			if (j < b->num_sides) {
+				const cm_bsp_plane_t *plane = bs[j].plane;
+
+				out[j + 0 * n] = plane->normal[0];
+				out[j + 1 * n] = plane->normal[1];
+				out[j + 2 * n] = plane->normal[2];
+				out[j + 3 * n] = plane->dist;
+			} else {
+				out[j + 0 * n] = 0.0;
+				out[j + 1 * n] = 0.0;
+				out[j + 2 * n] = 0.0;
+				out[j + 3 * n] = 1.0e30;
+			}
+		}
+
+		out += n * 4;
 	}
 }
 
@@ -380,8 +423,6 @@ static void Cm_LoadBspAreas(const d_bsp_lump_t *l) {
 	for (int32_t i = 0; i < count; i++, in++, out++) {
 		out->num_area_portals = LittleLong(in->num_area_portals);
 		out->first_area_portal = LittleLong(in->first_area_portal);
-		out->flood_valid = 0;
-		out->flood_num = 0;
 	}
 }
 
@@ -414,13 +455,25 @@ static void Cm_LoadBspAreaPortals(const d_bsp_lump_t *l) {
 	}
 }
 
+/**
+ * @brief If set, the BSP file is held until the next map is loaded, so that
+ * the renderer may share it. This is set only by the client, so that dedicated
+ * servers release the file as soon as the collision model is loaded.
+ */
+_Bool cm_retain_bsp_file = false;
+
 /**
  * @brief Loads in the BSP and all sub-models for collision detection. This
  * function can also be used to initialize or clean up the collision model by
  * invoking with NULL.
  */
 cm_bsp_model_t *Cm_LoadBspModel(const char *name, int64_t *size) {
-	void *buf;
+
+	Cm_CloseBspFile(cm_bsp.file);
+
+	Mem_Free(cm_bsp.bvhs);
+	Mem_Free(cm_bsp.side_planes);
+	Mem_Free(cm_bsp.vis_matrix);
 
 	memset(&cm_bsp, 0, sizeof(cm_bsp));
 	cm_vis = (d_bsp_vis_t *) cm_bsp.visibility;
@@ -433,52 +486,55 @@ cm_bsp_model_t *Cm_LoadBspModel(const char *name, int64_t *size) {
 		return &cm_bsp.models[0];
 	}
 
-	// load the file
-	const int64_t s = Fs_Load(name, &buf);
-	if (s == -1) {
+	// open the file, which the renderer may share
+	const cm_bsp_file_t *file = Cm_OpenBspFile(name);
+	if (!file) {
 		Com_Error(ERR_DROP, "Couldn't load %s\n", name);
 	}
 
 	if (size) {
-		*size = s;
-	}
-
-	// byte-swap the entire header
-	d_bsp_header_t header = *(d_bsp_header_t *) buf;
-	for (size_t i = 0; i < sizeof(d_bsp_header_t) / sizeof(int32_t); i++) {
-		((int32_t *) &header)[i] = LittleLong(((int32_t *) &header)[i]);
-	}
-
-	if (header.version != BSP_VERSION && header.version != BSP_VERSION_QUETOO) {
-		Com_Error(ERR_DROP, "%s has unsupported version: %d\n", name, header.version);
+		*size = file->size;
 	}
 
 	g_strlcpy(cm_bsp.name, name, sizeof(cm_bsp.name));
 
-	cm_bsp.base = (byte *) buf;
+	cm_bsp.file = file;
+	cm_bsp.base = file->base;
+
+	const d_bsp_header_t *header = &file->header;
 
 	// load into heap
-	Cm_LoadEntityString(&header.lumps[BSP_LUMP_ENTITIES]);
-	Cm_LoadBspPlanes(&header.lumps[BSP_LUMP_PLANES]);
-	Cm_LoadBspNodes(&header.lumps[BSP_LUMP_NODES]);
-	Cm_LoadBspSurfaces(&header.lumps[BSP_LUMP_TEXINFO]);
-	Cm_LoadBspLeafs(&header.lumps[BSP_LUMP_LEAFS]);
-	Cm_LoadBspLeafBrushes(&header.lumps[BSP_LUMP_LEAF_BRUSHES]);
-	Cm_LoadBspInlineModels(&header.lumps[BSP_LUMP_MODELS]);
-	Cm_LoadBspBrushes(&header.lumps[BSP_LUMP_BRUSHES]);
-	Cm_LoadBspBrushSides(&header.lumps[BSP_LUMP_BRUSH_SIDES]);
-	Cm_LoadBspVisibility(&header.lumps[BSP_LUMP_VISIBILITY]);
-	Cm_LoadBspAreas(&header.lumps[BSP_LUMP_AREAS]);
-	Cm_LoadBspAreaPortals(&header.lumps[BSP_LUMP_AREA_PORTALS]);
-
-	Fs_Free(buf);
+	Cm_LoadEntityString(&header->lumps[BSP_LUMP_ENTITIES]);
+	Cm_LoadBspPlanes(&header->lumps[BSP_LUMP_PLANES]);
+	Cm_LoadBspNodes(&header->lumps[BSP_LUMP_NODES]);
+	Cm_LoadBspSurfaces(&header->lumps[BSP_LUMP_TEXINFO]);
+	Cm_LoadBspLeafs(&header->lumps[BSP_LUMP_LEAFS]);
+	Cm_LoadBspLeafBrushes(&header->lumps[BSP_LUMP_LEAF_BRUSHES]);
+	Cm_LoadBspInlineModels(&header->lumps[BSP_LUMP_MODELS]);
+	Cm_LoadBspBrushes(&header->lumps[BSP_LUMP_BRUSHES]);
+	Cm_LoadBspBrushSides(&header->lumps[BSP_LUMP_BRUSH_SIDES]);
+	Cm_LoadBspVisibility(&header->lumps[BSP_LUMP_VISIBILITY]);
+	Cm_LoadBspAreas(&header->lumps[BSP_LUMP_AREAS]);
+	Cm_LoadBspAreaPortals(&header->lumps[BSP_LUMP_AREA_PORTALS]);
 
 	Cm_SetupBspBrushes();
 
+	Cm_BuildBvhs();
+
+	Cm_InitVisMatrix();
+
 	Cm_InitBoxHull();
 
 	Cm_FloodAreas();
 
+	// release the file, unless the renderer will load it next
+	if (!cm_retain_bsp_file) {
+		Cm_CloseBspFile(cm_bsp.file);
+
+		cm_bsp.file = NULL;
+		cm_bsp.base = NULL;
+	}
+
 	return &cm_bsp.models[0];
 }
 
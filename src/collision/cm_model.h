@@ -39,11 +39,13 @@ int32_t Cm_LeafArea(const int32_t leaf_num);
 
 #ifdef __CM_LOCAL_H__
 
-#include "files.h"
+#include "cm_file.h"
 
 typedef struct {
 	char name[MAX_QPATH];
-	byte *base;
+
+	const cm_bsp_file_t *file;
+	const byte *base;
 
 	int32_t entity_string_len;
 	char entity_string[MAX_BSP_ENT_STRING];
@@ -72,9 +74,18 @@ typedef struct {
 	int32_t num_brush_sides;
 	cm_bsp_brush_side_t brush_sides[MAX_BSP_BRUSH_SIDES + 6]; // extra for box hull
 
+	vec_t *side_planes; // the managed allocation backing each brush's side_planes
+
+	struct cm_bvh_s *bvhs; // the per-model BVHs, see Cm_BuildBvhs
+
 	int32_t num_visibility;
 	byte visibility[MAX_BSP_VISIBILITY];
 
+	size_t vis_row_size; // the cache-aligned stride of the vis matrices, or 0
+	byte *vis_matrix; // the managed allocation backing the matrices below
+	byte *pvs_matrix; // decompressed PVS, num_clusters * vis_row_size
+	byte *phs_matrix; // decompressed PHS, num_clusters * vis_row_size
+
 	int32_t num_areas;
 	cm_bsp_area_t areas[MAX_BSP_AREAS];
 
@@ -82,7 +93,10 @@ typedef struct {
 	d_bsp_area_portal_t area_portals[MAX_BSP_AREA_PORTALS];
 
 	_Bool portal_open[MAX_BSP_AREA_PORTALS];
-	int32_t flood_valid;
+	int32_t portal_areas[MAX_BSP_AREA_PORTALS][2]; // the two areas each portal joins
+
+	byte area_bits[MAX_BSP_AREAS][MAX_BSP_AREAS >> 3]; // the areas connected to each area
+	int32_t flood_seq; // odd while the area floods are being updated
 } cm_bsp_t;
 
 typedef d_bsp_vis_t cm_vis_t;
@@ -102,22 +102,29 @@ int32_t Cm_BoxOnPlaneSide(const vec3_t mins, const vec3_t maxs, const cm_bsp_pla
 }
 
 /**
- * @brief Bounding box to BSP tree structure for box positional testing.
+ * @brief Bounding box to BSP tree structure for box positional testing. The
+ * nodes and leaf of the box hull are reserved in the shared BSP so that its
+ * head node is unique, but the planes and brush that are clipped to are
+ * thread-local. This allows any number of threads to clip to boxes at once.
  */
 typedef struct {
 	int32_t head_node;
-	cm_bsp_plane_t *planes;
-	cm_bsp_brush_t *brush;
-	cm_bsp_leaf_t *leaf;
+	int32_t generation; // the box hull template this was copied from
+
+	cm_bsp_plane_t planes[12];
+	cm_bsp_brush_side_t brush_sides[6];
+	cm_bsp_brush_t brush;
 } cm_box_t;
 
-static cm_box_t cm_box;
+static cm_box_t cm_box_template;
+static __thread cm_box_t cm_box;
 
 /**
  * @brief Appends a brush (6 nodes, 12 planes) opaquely to the primary BSP
  * structure to represent the bounding box used for Cm_BoxLeafnums. This brush
  * is never tested by the rest of the collision detection code, as it resides
- * just beyond the parsed size of the map.
+ * just beyond the parsed size of the map. The planes and brush are also
+ * copied to the template from which each thread's box hull is initialized.
  */
 void Cm_InitBoxHull(void) {
 	static cm_bsp_surface_t null_surface;
@@ -141,37 +148,38 @@ void Cm_InitBoxHull(void) {
 		Com_Error(ERR_DROP, "MAX_BSP_BRUSH_SIDES\n");
 
 	// head node
-	cm_box.head_node = cm_bsp.num_nodes;
+	cm_box_template.head_node = cm_bsp.num_nodes;
 
 	// planes
-	cm_box.planes = &cm_bsp.planes[cm_bsp.num_planes];
+	cm_bsp_plane_t *planes = &cm_bsp.planes[cm_bsp.num_planes];
 
 	// leaf
-	cm_box.leaf = &cm_bsp.leafs[cm_bsp.num_leafs];
-	cm_box.leaf->contents = CONTENTS_MONSTER;
-	cm_box.leaf->first_leaf_brush = cm_bsp.num_leaf_brushes;
-	cm_box.leaf->num_leaf_brushes = 1;
+	cm_bsp_leaf_t *leaf = &cm_bsp.leafs[cm_bsp.num_leafs];
+	leaf->contents = CONTENTS_MONSTER;
+	leaf->first_leaf_brush = cm_bsp.num_leaf_brushes;
+	leaf->num_leaf_brushes = 1;
 
 	// leaf brush
 	cm_bsp.leaf_brushes[cm_bsp.num_leaf_brushes] = cm_bsp.num_brushes;
 
 	// brush
-	cm_box.brush = &cm_bsp.brushes[cm_bsp.num_brushes];
-	cm_box.brush->num_sides = 6;
-	cm_box.brush->first_brush_side = cm_bsp.num_brush_sides;
-	cm_box.brush->contents = CONTENTS_MONSTER;
+	cm_bsp_brush_t *brush = &cm_bsp.brushes[cm_bsp.num_brushes];
+	brush->num_sides = 6;
+	brush->first_brush_side = cm_bsp.num_brush_sides;
+	brush->sides = &cm_bsp.brush_sides[cm_bsp.num_brush_sides];
+	brush->contents = CONTENTS_MONSTER;
 
 	for (int32_t i = 0; i < 6; i++) {
 
 		// fill in planes, two per side
-		cm_bsp_plane_t *plane = &cm_box.planes[i * 2];
+		cm_bsp_plane_t *plane = &planes[i * 2];
 		plane->type = i >> 1;
 		VectorClear(plane->normal);
 		plane->normal[i >> 1] = 1.0;
 		plane->sign_bits = Cm_SignBitsForPlane(plane);
 		plane->num = (cm_bsp.num_planes >> 1) + (i >> 1) + 1;
 
-		plane = &cm_box.planes[i * 2 + 1];
+		plane = &planes[i * 2 + 1];
 		plane->type = PLANE_ANY_X + (i >> 1);
 		VectorClear(plane->normal);
 		plane->normal[i >> 1] = -1.0;
@@ -181,11 +189,11 @@ void Cm_InitBoxHull(void) {
 		const int32_t side = i & 1;
 
 		// fill in nodes, one per side
-		cm_bsp_node_t *node = &cm_bsp.nodes[cm_box.head_node + i];
+		cm_bsp_node_t *node = &cm_bsp.nodes[cm_box_template.head_node + i];
 		node->plane = cm_bsp.planes + (cm_bsp.num_planes + i * 2);
 		node->children[side] = -1 - cm_bsp.num_leafs;
 		if (i != 5)
-			node->children[side ^ 1] = cm_box.head_node + i + 1;
+			node->children[side ^ 1] = cm_box_template.head_node + i + 1;
 		else
 			node->children[side ^ 1] = -1 - cm_bsp.num_leafs;
 
@@ -193,34 +201,76 @@ void Cm_InitBoxHull(void) {
 		cm_bsp_brush_side_t *bside = &cm_bsp.brush_sides[cm_bsp.num_brush_sides + i];
 		bside->plane = cm_bsp.planes + (cm_bsp.num_planes + i * 2 + side);
 		bside->surface = &null_surface;
+
+		cm_box_template.brush_sides[i].surface = &null_surface;
 	}
+
+	memcpy(cm_box_template.planes, planes, sizeof(cm_box_template.planes));
+	cm_box_template.brush = *brush;
+
+	// invalidate every thread's box hull
+	cm_box_template.generation++;
 }
 
 /**
- * @brief Initializes the box hull for the specified bounds, returning the
- * head node for the resulting box hull tree.
+ * @return This thread's box hull, initialized from the template if it was
+ * created for a previous map.
+ */
+static cm_box_t *Cm_BoxHull(void) {
+
+	if (cm_box.generation != cm_box_template.generation) {
+		cm_box = cm_box_template;
+
+		for (int32_t i = 0; i < 6; i++) {
+			cm_box.brush_sides[i].plane = &cm_box.planes[i * 2 + (i & 1)];
+		}
+
+		cm_box.brush.sides = cm_box.brush_sides;
+	}
+
+	return &cm_box;
+}
+
+/**
+ * @brief Initializes this thread's box hull for the specified bounds,
+ * returning the head node for the resulting box hull tree.
  */
 int32_t Cm_SetBoxHull(const vec3_t mins, const vec3_t maxs, const int32_t contents) {
 
-	VectorCopy(mins, cm_box.brush->mins);
-	VectorCopy(maxs, cm_box.brush->maxs);
-	
-	cm_box.planes[0].dist = maxs[0];
-	cm_box.planes[1].dist = -maxs[0];
-	cm_box.planes[2].dist = mins[0];
-	cm_box.planes[3].dist = -mins[0];
-	cm_box.planes[4].dist = maxs[1];
-	cm_box.planes[5].dist = -maxs[1];
-	cm_box.planes[6].dist = mins[1];
-	cm_box.planes[7].dist = -mins[1];
-	cm_box.planes[8].dist = maxs[2];
-	cm_box.planes[9].dist = -maxs[2];
-	cm_box.planes[10].dist = mins[2];
-	cm_box.planes[11].dist = -mins[2];
-
-	cm_box.leaf->contents = cm_box.brush->contents = contents;
-
-	return cm_box.head_node;
+	cm_box_t *box = Cm_BoxHull();
+
+	VectorCopy(mins, box->brush.mins);
+	VectorCopy(maxs, box->brush.maxs);
+
+	box->planes[0].dist = maxs[0];
+	box->planes[1].dist = -maxs[0];
+	box->planes[2].dist = mins[0];
+	box->planes[3].dist = -mins[0];
+	box->planes[4].dist = maxs[1];
+	box->planes[5].dist = -maxs[1];
+	box->planes[6].dist = mins[1];
+	box->planes[7].dist = -mins[1];
+	box->planes[8].dist = maxs[2];
+	box->planes[9].dist = -maxs[2];
+	box->planes[10].dist = mins[2];
+	box->planes[11].dist = -mins[2];
+
+	box->brush.contents = contents;
+
+	return box->head_node;
+}
+
+/**
+ * @return This thread's box hull brush if the head node is that of the box
+ * hull, or `NULL`. Clipping to the box hull must use this brush rather than
+ * descend the shared nodes, whose planes are not updated by Cm_SetBoxHull.
+ */
+const cm_bsp_brush_t *Cm_BoxHullBrush(const int32_t head_node) {
+
+	if (head_node != cm_box_template.head_node || !cm_box_template.generation)
+		return NULL;
+
+	return &Cm_BoxHull()->brush;
 }
 
 /**
@@ -271,6 +321,11 @@ int32_t Cm_PointContents(const vec3_t p, int32_t head_node) {
 	if (!cm_bsp.num_nodes)
 		return 0;
 
+	// every node of the box hull leads to its leaf
+	const cm_bsp_brush_t *box = Cm_BoxHullBrush(head_node);
+	if (box)
+		return box->contents;
+
 	const int32_t leaf_num = Cm_PointLeafnum(p, head_node);
 
 	return cm_bsp.leafs[leaf_num].contents;
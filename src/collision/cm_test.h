@@ -34,6 +34,7 @@ size_t Cm_BoxLeafnums(const vec3_t mins, const vec3_t maxs, int32_t *list, size_
 
 #ifdef __CM_LOCAL_H__
 void Cm_InitBoxHull(void);
+const cm_bsp_brush_t *Cm_BoxHullBrush(const int32_t head_node);
 #endif
 
 #endif /* __CM_TEST_H__ */
@@ -21,6 +21,10 @@
 
 #include "cm_local.h"
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 /**
  * @brief Plane side epsilon (1.0 / 32.0) to keep floating point happy.
  */
@@ -41,42 +45,89 @@ typedef struct {
 
 	cm_trace_t trace;
 
-	int32_t brushes[32]; // used to avoid multiple intersection tests with brushes
+	uint32_t check_count; // used to avoid multiple intersection tests with brushes
 } cm_trace_data_t;
 
 /**
- * @brief
+ * @brief The check count of the trace that last tested each brush. Every trace
+ * on a given thread is issued a unique check count, so brushes are tested at
+ * most once per trace without clearing anything between leafs or traces.
  */
-static _Bool Cm_BrushAlreadyTested(cm_trace_data_t *data, const int32_t brush_num) {
+static __thread uint32_t cm_brush_check_counts[MAX_BSP_BRUSHES + 1];
+static __thread uint32_t cm_check_count;
 
-	const int32_t hash = brush_num & 31;
-	const _Bool skip = (data->brushes[hash] == brush_num);
+/**
+ * @brief The brush clipping counters of this thread.
+ */
+static __thread cm_trace_stats_t cm_trace_stats;
 
-	data->brushes[hash] = brush_num;
+/**
+ * @return A unique check count for a new trace on this thread.
+ */
+static uint32_t Cm_NextCheckCount(void) {
+
+	if (++cm_check_count == 0) { // wrapped, so start over
+		memset(cm_brush_check_counts, 0, sizeof(cm_brush_check_counts));
+		cm_check_count = 1;
+	}
 
-	return skip;
+	return cm_check_count;
 }
 
 /**
- * @brief Clips the bounded box to all brush sides for the given brush.
+ * @return True if the brush was already tested by this trace, marking it as
+ * tested otherwise.
  */
-static void Cm_TraceToBrush(cm_trace_data_t *data, const cm_bsp_brush_t *brush) {
+static _Bool Cm_BrushAlreadyTested(cm_trace_data_t *data, const int32_t brush_num) {
 
-	if (!brush->num_sides)
-		return;
+	if (cm_brush_check_counts[brush_num] == data->check_count) {
+		cm_trace_stats.brushes_skipped++;
+		return true;
+	}
 
-	if (!BoxIntersect(data->box_mins, data->box_maxs, brush->mins, brush->maxs))
-		return;
+	cm_brush_check_counts[brush_num] = data->check_count;
+	cm_trace_stats.brushes_tested++;
+
+	return false;
+}
+
+/**
+ * @return The brush clipping counters of the calling thread.
+ */
+cm_trace_stats_t Cm_TraceStats(void) {
+	return cm_trace_stats;
+}
 
-	vec_t enter_fraction = -1.0;
-	vec_t leave_fraction = 1.0;
+/**
+ * @brief Resets the brush clipping counters of the calling thread.
+ */
+void Cm_ClearTraceStats(void) {
+	memset(&cm_trace_stats, 0, sizeof(cm_trace_stats));
+}
 
-	const cm_bsp_plane_t *clip_plane = NULL;
-	const cm_bsp_brush_side_t *clip_side = NULL;
+/**
+ * @brief The result of clipping a sweep to the sides of a brush.
+ */
+typedef struct {
+	vec_t enter_fraction, leave_fraction;
+	int32_t clip_side; // the index of the side the sweep entered through, or -1
+	_Bool start_outside, end_outside;
+} cm_brush_clip_t;
+
+/**
+ * @brief Clips the sweep to each side of the brush in turn.
+ *
+ * @return False if the sweep is completely in front of any side.
+ */
+static _Bool Cm_ClipToBrushSides(const cm_trace_data_t *data, const cm_bsp_brush_t *brush,
+		cm_brush_clip_t *clip) {
 
-	_Bool end_outside = false, start_outside = false;
+	clip->enter_fraction = -1.0;
+	clip->leave_fraction = 1.0;
+	clip->clip_side = -1;
+	clip->start_outside = clip->end_outside = false;
 
-	const cm_bsp_brush_side_t *side = &cm_bsp.brush_sides[brush->first_brush_side];
+	const cm_bsp_brush_side_t *side = brush->sides;
 
 	for (int32_t i = 0; i < brush->num_sides; i++, side++) {
 		const cm_bsp_plane_t *plane = side->plane;
@@ -87,13 +138,13 @@ static void Cm_TraceToBrush(cm_trace_data_t *data, const cm_bsp_brush_t *brush)
 		const vec_t d2 = DotProduct(data->end, plane->normal) - dist;
 
 		if (d2 > 0.0)
-			end_outside = true; // end point is not in solid
+			clip->end_outside = true; // end point is not in solid
 		if (d1 > 0.0)
-			start_outside = true;
+			clip->start_outside = true;
 
 		// if completely in front of face, no intersection with entire brush
 		if (d1 > 0.0 && d2 >= d1)
-			return;
+			return false;
 
 		// if completely behind plane, no intersection
 		if (d1 <= 0.0 && d2 <= 0.0)
@@ -103,33 +154,251 @@ static void Cm_TraceToBrush(cm_trace_data_t *data, const cm_bsp_brush_t *brush)
 		if (d1 > d2) { // enter
 			const vec_t f = (d1 - DIST_EPSILON) / (d1 - d2);
 
-			if (f > enter_fraction) {
-				enter_fraction = f;
-				clip_plane = plane;
-				clip_side = side;
+			if (f > clip->enter_fraction) {
+				clip->enter_fraction = f;
+				clip->clip_side = i;
 			}
 		} else { // leave
 			const vec_t f = (d1 + DIST_EPSILON) / (d1 - d2);
 
-			if (f < leave_fraction)
-				leave_fraction = f;
+			if (f < clip->leave_fraction)
+				clip->leave_fraction = f;
 		}
 	}
 
+	return true;
+}
+
+/**
+ * @return True if the box at the trace start is behind every side of the brush.
+ */
+static _Bool Cm_BoxInBrushSides(const cm_trace_data_t *data, const cm_bsp_brush_t *brush) {
+
+	const cm_bsp_brush_side_t *side = brush->sides;
+
+	for (int32_t i = 0; i < brush->num_sides; i++, side++) {
+		const cm_bsp_plane_t *plane = side->plane;
+
+		const vec_t dist = plane->dist - DotProduct(data->offsets[plane->sign_bits], plane->normal);
+
+		const vec_t d1 = DotProduct(data->start, plane->normal) - dist;
+
+		// if completely in front of face, no intersection
+		if (d1 > 0.0)
+			return false;
+	}
+
+	return true;
+}
+
+#if defined(__SSE__)
+
+/**
+ * @brief Selects `b` where `mask` is set, and `a` elsewhere.
+ */
+static inline __m128 Cm_Select(const __m128 a, const __m128 b, const __m128 mask) {
+	return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+/**
+ * @brief Shifts the packed plane distances by the box corner nearest to each
+ * plane. This is the branch-free equivalent of the `offsets[sign_bits]` lookup.
+ */
+static inline __m128 Cm_OffsetDist(const cm_trace_data_t *data, const __m128 x, const __m128 y,
+		const __m128 z, const __m128 dist) {
+
+	const __m128 ox = _mm_min_ps(_mm_mul_ps(x, _mm_set1_ps(data->mins[0])),
+			_mm_mul_ps(x, _mm_set1_ps(data->maxs[0])));
+	const __m128 oy = _mm_min_ps(_mm_mul_ps(y, _mm_set1_ps(data->mins[1])),
+			_mm_mul_ps(y, _mm_set1_ps(data->maxs[1])));
+	const __m128 oz = _mm_min_ps(_mm_mul_ps(z, _mm_set1_ps(data->mins[2])),
+			_mm_mul_ps(z, _mm_set1_ps(data->maxs[2])));
+
+	return _mm_sub_ps(dist, _mm_add_ps(_mm_add_ps(ox, oy), oz));
+}
+
+/**
+ * @return The distances of the point to the packed planes.
+ */
+static inline __m128 Cm_PlaneDist(const vec3_t p, const __m128 x, const __m128 y,
+		const __m128 z, const __m128 dist) {
+
+	const __m128 dot = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(p[0]), x),
+			_mm_mul_ps(_mm_set1_ps(p[1]), y)),
+			_mm_mul_ps(_mm_set1_ps(p[2]), z));
+
+	return _mm_sub_ps(dot, dist);
+}
+
+/**
+ * @brief SSE implementation of Cm_ClipToBrushSides, evaluating CM_SIMD_WIDTH
+ * sides at a time from the brush's packed side planes. The enter and leave
+ * fractions are accumulated per lane without branching, and then reduced so
+ * that ties resolve to the lowest side, as they do in the scalar version.
+ */
+static _Bool Cm_ClipToBrushSides_SSE(const cm_trace_data_t *data, const cm_bsp_brush_t *brush,
+		cm_brush_clip_t *clip) {
+
+	const int32_t n = brush->num_side_planes;
+
+	const vec_t *nx = brush->side_planes;
+	const vec_t *ny = nx + n;
+	const vec_t *nz = ny + n;
+	const vec_t *nd = nz + n;
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 epsilon = _mm_set1_ps(DIST_EPSILON);
+
+	__m128 enter = _mm_set1_ps(-1.0);
+	__m128 enter_side = _mm_set1_ps(-1.0);
+	__m128 leave = _mm_set1_ps(1.0);
+
+	__m128 start_outside = zero, end_outside = zero;
+
+	__m128 side = _mm_set_ps(3.0, 2.0, 1.0, 0.0);
+	const __m128 width = _mm_set1_ps(CM_SIMD_WIDTH);
+
+	for (int32_t i = 0; i < n; i += CM_SIMD_WIDTH) {
+		const __m128 x = _mm_load_ps(nx + i);
+		const __m128 y = _mm_load_ps(ny + i);
+		const __m128 z = _mm_load_ps(nz + i);
+
+		const __m128 dist = Cm_OffsetDist(data, x, y, z, _mm_load_ps(nd + i));
+
+		const __m128 d1 = Cm_PlaneDist(data->start, x, y, z, dist);
+		const __m128 d2 = Cm_PlaneDist(data->end, x, y, z, dist);
+
+		const __m128 d1_outside = _mm_cmpgt_ps(d1, zero);
+		const __m128 d2_outside = _mm_cmpgt_ps(d2, zero);
+
+		// if completely in front of any face, no intersection with entire brush
+		if (_mm_movemask_ps(_mm_and_ps(d1_outside, _mm_cmpge_ps(d2, d1))))
+			return false;
+
+		start_outside = _mm_or_ps(start_outside, d1_outside);
+		end_outside = _mm_or_ps(end_outside, d2_outside);
+
+		// faces that are crossed are either entered or left
+		const __m128 crosses = _mm_or_ps(d1_outside, d2_outside);
+		const __m128 enters = _mm_and_ps(crosses, _mm_cmpgt_ps(d1, d2));
+		const __m128 leaves = _mm_andnot_ps(enters, crosses);
+
+		const __m128 d = _mm_sub_ps(d1, d2);
+
+		const __m128 f_enter = _mm_div_ps(_mm_sub_ps(d1, epsilon), d);
+		const __m128 f_leave = _mm_div_ps(_mm_add_ps(d1, epsilon), d);
+
+		const __m128 enter_mask = _mm_and_ps(enters, _mm_cmpgt_ps(f_enter, enter));
+		enter = Cm_Select(enter, f_enter, enter_mask);
+		enter_side = Cm_Select(enter_side, side, enter_mask);
+
+		const __m128 leave_mask = _mm_and_ps(leaves, _mm_cmplt_ps(f_leave, leave));
+		leave = Cm_Select(leave, f_leave, leave_mask);
+
+		side = _mm_add_ps(side, width);
+	}
+
+	vec_t enters[CM_SIMD_WIDTH] __attribute__((aligned(16)));
+	vec_t enter_sides[CM_SIMD_WIDTH] __attribute__((aligned(16)));
+	vec_t leaves[CM_SIMD_WIDTH] __attribute__((aligned(16)));
+
+	_mm_store_ps(enters, enter);
+	_mm_store_ps(enter_sides, enter_side);
+	_mm_store_ps(leaves, leave);
+
+	clip->enter_fraction = -1.0;
+	clip->leave_fraction = 1.0;
+	clip->clip_side = -1;
+
+	for (int32_t i = 0; i < CM_SIMD_WIDTH; i++) {
+		const int32_t s = (int32_t) enter_sides[i];
+
+		if (enters[i] > clip->enter_fraction ||
+				(enters[i] == clip->enter_fraction && s < clip->clip_side)) {
+			clip->enter_fraction = enters[i];
+			clip->clip_side = s;
+		}
+
+		clip->leave_fraction = MIN(clip->leave_fraction, leaves[i]);
+	}
+
+	clip->start_outside = _mm_movemask_ps(start_outside) != 0;
+	clip->end_outside = _mm_movemask_ps(end_outside) != 0;
+
+	return true;
+}
+
+/**
+ * @brief SSE implementation of Cm_BoxInBrushSides.
+ */
+static _Bool Cm_BoxInBrushSides_SSE(const cm_trace_data_t *data, const cm_bsp_brush_t *brush) {
+
+	const int32_t n = brush->num_side_planes;
+
+	const vec_t *nx = brush->side_planes;
+	const vec_t *ny = nx + n;
+	const vec_t *nz = ny + n;
+	const vec_t *nd = nz + n;
+
+	const __m128 zero = _mm_setzero_ps();
+
+	for (int32_t i = 0; i < n; i += CM_SIMD_WIDTH) {
+		const __m128 x = _mm_load_ps(nx + i);
+		const __m128 y = _mm_load_ps(ny + i);
+		const __m128 z = _mm_load_ps(nz + i);
+
+		const __m128 dist = Cm_OffsetDist(data, x, y, z, _mm_load_ps(nd + i));
+
+		const __m128 d1 = Cm_PlaneDist(data->start, x, y, z, dist);
+
+		if (_mm_movemask_ps(_mm_cmpgt_ps(d1, zero)))
+			return false;
+	}
+
+	return true;
+}
+
+#endif /* __SSE__ */
+
+/**
+ * @brief Clips the bounded box to all brush sides for the given brush.
+ */
+static void Cm_TraceToBrush(cm_trace_data_t *data, const cm_bsp_brush_t *brush) {
+
+	if (!brush->num_sides)
+		return;
+
+	if (!BoxIntersect(data->box_mins, data->box_maxs, brush->mins, brush->maxs))
+		return;
+
+	cm_brush_clip_t clip;
+
+#if defined(__SSE__)
+	if (brush->side_planes) {
+		if (!Cm_ClipToBrushSides_SSE(data, brush, &clip))
+			return;
+	} else
+#endif
+	if (!Cm_ClipToBrushSides(data, brush, &clip))
+		return;
+
 	// some sort of collision has occurred
 
-	if (!start_outside) { // original point was inside brush
+	if (!clip.start_outside) { // original point was inside brush
 		data->trace.start_solid = true;
-		if (!end_outside) {
+		if (!clip.end_outside) {
 			data->trace.all_solid = true;
 			data->trace.fraction = 0.0;
 			data->trace.contents = brush->contents;
 		}
-	} else if (enter_fraction < leave_fraction) { // pierced brush
-		if (enter_fraction > -1.0 && enter_fraction < data->trace.fraction) {
-			data->trace.fraction = MAX(0.0, enter_fraction);
-			data->trace.plane = *clip_plane;
-			data->trace.surface = clip_side->surface;
+	} else if (clip.enter_fraction < clip.leave_fraction) { // pierced brush
+		if (clip.enter_fraction > -1.0 && clip.enter_fraction < data->trace.fraction) {
+			const cm_bsp_brush_side_t *side = &brush->sides[clip.clip_side];
+
+			data->trace.fraction = MAX(0.0, clip.enter_fraction);
+			data->trace.plane = *side->plane;
+			data->trace.surface = side->surface;
 			data->trace.contents = brush->contents;
 		}
 	}
@@ -146,19 +415,14 @@ static void Cm_TestBoxInBrush(cm_trace_data_t *data, const cm_bsp_brush_t *brush
 	if (!BoxIntersect(data->box_mins, data->box_maxs, brush->mins, brush->maxs))
 		return;
 
-	const cm_bsp_brush_side_t *side = &cm_bsp.brush_sides[brush->first_brush_side];
-
-	for (int32_t i = 0; i < brush->num_sides; i++, side++) {
-		const cm_bsp_plane_t *plane = side->plane;
-
-		const vec_t dist = plane->dist - DotProduct(data->offsets[plane->sign_bits], plane->normal);
-
-		const vec_t d1 = DotProduct(data->start, plane->normal) - dist;
-
-		// if completely in front of face, no intersection
-		if (d1 > 0.0)
+#if defined(__SSE__)
+	if (brush->side_planes) {
+		if (!Cm_BoxInBrushSides_SSE(data, brush))
 			return;
-	}
+	} else
+#endif
+	if (!Cm_BoxInBrushSides(data, brush))
+		return;
 
 	// inside this brush
 	data->trace.start_solid = data->trace.all_solid = true;
@@ -176,9 +440,6 @@ static void Cm_TraceToLeaf(cm_trace_data_t *data, int32_t leaf_num) {
 	if (!(leaf->contents & data->contents))
 		return;
 
-	// reset the brushes cache for this leaf
-	memset(data->brushes, 0xff, sizeof(data->brushes));
-
 	// trace line against all brushes in the leaf
 	for (int32_t i = 0; i < leaf->num_leaf_brushes; i++) {
 		const int32_t brush_num = cm_bsp.leaf_brushes[leaf->first_leaf_brush + i];
@@ -315,92 +576,260 @@ static void Cm_TraceToNode(cm_trace_data_t *data, int32_t num, vec_t p1f, vec_t
 }
 
 /**
- * @brief Primary collision detection entry point. This function recurses down
- * the BSP tree from the specified head node, clipping the desired movement to
- * brushes that match the specified contents mask.
+ * @brief Tests the sweep against the bounds of a BVH node, expanded by the
+ * trace box.
  *
- * @param start The starting point.
- * @param end The desired end point.
- * @param mins The bounding box mins, in model space.
- * @param maxs The bounding box maxs, in model space.
- * @param head_node The BSP head node to recurse down.
- * @param contents The contents mask to clip to.
+ * @param enter The fraction at which the sweep enters the bounds.
  *
- * @return The trace.
+ * @return True if the sweep touches the bounds.
  */
-cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
-		const int32_t head_node, const int32_t contents) {
+static _Bool Cm_TraceToBvhNode(const cm_trace_data_t *data, const cm_bvh_node_t *node, vec_t *enter) {
 
-	static __thread cm_trace_data_t data;
-	memset(&data, 0, sizeof(data));
+	if (!BoxIntersect(data->box_mins, data->box_maxs, node->mins, node->maxs))
+		return false;
 
-	data.trace.fraction = 1.0;
+	vec_t t0 = 0.0, t1 = 1.0;
 
-	if (!cm_bsp.num_nodes) { // map not loaded
-		return data.trace;
+	for (int32_t i = 0; i < 3; i++) {
+		const vec_t lo = node->mins[i] - data->maxs[i] - 1.0;
+		const vec_t hi = node->maxs[i] - data->mins[i] + 1.0;
+
+		const vec_t d = data->end[i] - data->start[i];
+
+		if (fabsf(d) < 0.0001) {
+			if (data->start[i] < lo || data->start[i] > hi)
+				return false;
+			continue;
+		}
+
+		vec_t ta = (lo - data->start[i]) / d;
+		vec_t tb = (hi - data->start[i]) / d;
+
+		if (ta > tb) {
+			const vec_t t = ta;
+			ta = tb;
+			tb = t;
+		}
+
+		t0 = MAX(t0, ta);
+		t1 = MIN(t1, tb);
+
+		if (t0 > t1)
+			return false;
+	}
+
+	*enter = t0;
+	return true;
+}
+
+/**
+ * @brief Clips the trace to the brushes of a BVH, visiting nearer nodes first
+ * and skipping those beyond what the trace has already hit.
+ */
+static void Cm_TraceToBvh(cm_trace_data_t *data, const cm_bvh_t *bvh) {
+
+	struct {
+		int32_t node;
+		vec_t enter;
+	} stack[CM_BVH_MAX_DEPTH + 2];
+
+	int32_t depth = 0;
+
+	const _Bool position_test = VectorCompare(data->start, data->end);
+
+	if (Cm_TraceToBvhNode(data, &bvh->nodes[0], &stack[0].enter)) {
+		stack[depth++].node = 0;
+	}
+
+	while (depth) {
+		depth--;
+
+		if (stack[depth].enter > data->trace.fraction)
+			continue; // already hit something nearer
+
+		const cm_bvh_node_t *node = &bvh->nodes[stack[depth].node];
+
+		if (node->count) {
+			for (int32_t i = 0; i < node->count; i++) {
+				const cm_bsp_brush_t *b = &cm_bsp.brushes[bvh->brushes[node->first + i]];
+
+				if (!(b->contents & data->contents))
+					continue;
+
+				cm_trace_stats.brushes_tested++;
+
+				if (position_test) {
+					Cm_TestBoxInBrush(data, b);
+				} else {
+					Cm_TraceToBrush(data, b);
+				}
+
+				if (data->trace.all_solid)
+					return;
+			}
+			continue;
+		}
+
+		vec_t enter[2];
+		_Bool hit[2];
+
+		hit[0] = Cm_TraceToBvhNode(data, &bvh->nodes[node->first + 0], &enter[0]);
+		hit[1] = Cm_TraceToBvhNode(data, &bvh->nodes[node->first + 1], &enter[1]);
+
+		// push the farther child first, so that the nearer is visited first
+		const int32_t near = hit[1] && (!hit[0] || enter[1] < enter[0]);
+
+		for (int32_t i = 1; i >= 0; i--) {
+			const int32_t child = i ? near ^ 1 : near;
+
+			if (hit[child]) {
+				stack[depth].node = node->first + child;
+				stack[depth].enter = enter[child];
+				depth++;
+			}
+		}
 	}
+}
 
-	VectorCopy(start, data.start);
-	VectorCopy(end, data.end);
+/**
+ * @brief Initializes the trace data for a sweep of the specified box from
+ * start to end.
+ */
+static void Cm_InitTraceData(cm_trace_data_t *data, const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, const int32_t contents) {
 
-	VectorCopy(mins, data.mins);
-	VectorCopy(maxs, data.maxs);
+	memset(data, 0, sizeof(*data));
 
-	data.contents = contents;
+	data->trace.fraction = 1.0;
+
+	data->check_count = Cm_NextCheckCount();
+	cm_trace_stats.traces++;
+
+	VectorCopy(start, data->start);
+	VectorCopy(end, data->end);
+
+	VectorCopy(mins, data->mins);
+	VectorCopy(maxs, data->maxs);
+
+	data->contents = contents;
 
 	// check for point special case
 	if (VectorCompare(mins, vec3_origin) && VectorCompare(maxs, vec3_origin)) {
-		data.is_point = true;
+		data->is_point = true;
 	} else {
-		data.is_point = false;
+		data->is_point = false;
 
 		// extents allow planes to be shifted to account for the box size
-		data.extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
-		data.extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
-		data.extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+		data->extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		data->extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		data->extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
 
 		// offsets provide sign bit lookups for fast plane tests
-		data.offsets[0][0] = mins[0];
-		data.offsets[0][1] = mins[1];
-		data.offsets[0][2] = mins[2];
+		data->offsets[0][0] = mins[0];
+		data->offsets[0][1] = mins[1];
+		data->offsets[0][2] = mins[2];
 
-		data.offsets[1][0] = maxs[0];
-		data.offsets[1][1] = mins[1];
-		data.offsets[1][2] = mins[2];
+		data->offsets[1][0] = maxs[0];
+		data->offsets[1][1] = mins[1];
+		data->offsets[1][2] = mins[2];
 
-		data.offsets[2][0] = mins[0];
-		data.offsets[2][1] = maxs[1];
-		data.offsets[2][2] = mins[2];
+		data->offsets[2][0] = mins[0];
+		data->offsets[2][1] = maxs[1];
+		data->offsets[2][2] = mins[2];
 
-		data.offsets[3][0] = maxs[0];
-		data.offsets[3][1] = maxs[1];
-		data.offsets[3][2] = mins[2];
+		data->offsets[3][0] = maxs[0];
+		data->offsets[3][1] = maxs[1];
+		data->offsets[3][2] = mins[2];
 
-		data.offsets[4][0] = mins[0];
-		data.offsets[4][1] = mins[1];
-		data.offsets[4][2] = maxs[2];
+		data->offsets[4][0] = mins[0];
+		data->offsets[4][1] = mins[1];
+		data->offsets[4][2] = maxs[2];
 
-		data.offsets[5][0] = maxs[0];
-		data.offsets[5][1] = mins[1];
-		data.offsets[5][2] = maxs[2];
+		data->offsets[5][0] = maxs[0];
+		data->offsets[5][1] = mins[1];
+		data->offsets[5][2] = maxs[2];
 
-		data.offsets[6][0] = mins[0];
-		data.offsets[6][1] = maxs[1];
-		data.offsets[6][2] = maxs[2];
+		data->offsets[6][0] = mins[0];
+		data->offsets[6][1] = maxs[1];
+		data->offsets[6][2] = maxs[2];
 
-		data.offsets[7][0] = maxs[0];
-		data.offsets[7][1] = maxs[1];
-		data.offsets[7][2] = maxs[2];
+		data->offsets[7][0] = maxs[0];
+		data->offsets[7][1] = maxs[1];
+		data->offsets[7][2] = maxs[2];
 	}
 
 	for (int32_t i = 0; i < 3; i++) {
 		if (start[i] < end[i]) {
-			data.box_mins[i] = start[i] + mins[i] - 1.0;
-			data.box_maxs[i] = end[i] + maxs[i] + 1.0;
+			data->box_mins[i] = start[i] + mins[i] - 1.0;
+			data->box_maxs[i] = end[i] + maxs[i] + 1.0;
 		} else {
-			data.box_mins[i] = end[i] + mins[i] - 1.0;
-			data.box_maxs[i] = start[i] + maxs[i] + 1.0;
+			data->box_mins[i] = end[i] + mins[i] - 1.0;
+			data->box_maxs[i] = start[i] + maxs[i] + 1.0;
+		}
+	}
+}
+
+/**
+ * @brief Resolves the end point of the trace from its fraction.
+ */
+static void Cm_FinishTraceData(cm_trace_data_t *data) {
+
+	if (data->trace.fraction == 0.0) {
+		VectorCopy(data->start, data->trace.end);
+	} else if (data->trace.fraction == 1.0) {
+		VectorCopy(data->end, data->trace.end);
+	} else {
+		VectorLerp(data->start, data->end, data->trace.fraction, data->trace.end);
+	}
+}
+
+/**
+ * @brief Primary collision detection entry point. This function recurses down
+ * the BSP tree from the specified head node, clipping the desired movement to
+ * brushes that match the specified contents mask.
+ *
+ * @param start The starting point.
+ * @param end The desired end point.
+ * @param mins The bounding box mins, in model space.
+ * @param maxs The bounding box maxs, in model space.
+ * @param head_node The BSP head node to recurse down.
+ * @param contents The contents mask to clip to.
+ *
+ * @return The trace.
+ */
+cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+		const int32_t head_node, const int32_t contents) {
+
+	static __thread cm_trace_data_t data;
+
+	if (!cm_bsp.num_nodes) { // map not loaded
+		memset(&data.trace, 0, sizeof(data.trace));
+		data.trace.fraction = 1.0;
+		return data.trace;
+	}
+
+	Cm_InitTraceData(&data, start, end, mins, maxs, contents);
+
+	// check for box hull special case, which is clipped to directly
+	const cm_bsp_brush_t *box = Cm_BoxHullBrush(head_node);
+	if (box) {
+		if (box->contents & contents) {
+			if (VectorCompare(start, end)) {
+				Cm_TestBoxInBrush(&data, box);
+			} else {
+				Cm_TraceToBrush(&data, box);
+			}
 		}
+
+		Cm_FinishTraceData(&data);
+		return data.trace;
+	}
+
+	// check for models that are clipped to with a BVH rather than the BSP
+	if (head_node >= 0 && cm_bsp.nodes[head_node].bvh) {
+		Cm_TraceToBvh(&data, cm_bsp.nodes[head_node].bvh);
+		Cm_FinishTraceData(&data);
+		return data.trace;
 	}
 
 	// check for position test special case
@@ -423,15 +852,230 @@ cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
 
 	Cm_TraceToNode(&data, head_node, 0.0, 1.0, start, end);
 
-	if (data.trace.fraction == 0.0) {
-		VectorCopy(start, data.trace.end);
-	} else if (data.trace.fraction == 1.0) {
-		VectorCopy(end, data.trace.end);
+	Cm_FinishTraceData(&data);
+
+	return data.trace;
+}
+
+/**
+ * @brief Batch traces are resolved in packets of this many lanes, so that the
+ * active lanes at each node fit in a single bit mask.
+ */
+#define TRACE_PACKET_SIZE 64
+
+/**
+ * @brief A packet of traces sharing a box, head node and contents mask. The
+ * end points are kept in structure-of-arrays form so that the plane distance
+ * tests at each node vectorize across the packet.
+ */
+typedef struct {
+	vec_t start[3][TRACE_PACKET_SIZE] __attribute__((aligned(32)));
+	vec_t end[3][TRACE_PACKET_SIZE] __attribute__((aligned(32)));
+
+	vec3_t extents;
+	_Bool is_point;
+
+	cm_trace_data_t data[TRACE_PACKET_SIZE];
+} cm_trace_packet_t;
+
+/**
+ * @brief Clips the active lanes of the packet to the brushes of the given leaf.
+ */
+static void Cm_TracePacketToLeaf(cm_trace_packet_t *packet, int32_t leaf_num, uint64_t lanes) {
+
+	while (lanes) {
+		const int32_t i = __builtin_ctzll(lanes);
+		lanes &= lanes - 1;
+
+		if (packet->data[i].trace.all_solid)
+			continue;
+
+		Cm_TraceToLeaf(&packet->data[i], leaf_num);
+	}
+}
+
+/**
+ * @brief Recurses the active lanes of the packet down the BSP tree. Unlike
+ * Cm_TraceToNode, the lanes are not split at each node. Rather, each child is
+ * visited with every lane whose sweep touches it, and lanes that have already
+ * hit something nearer than the child are culled. Because brush clipping
+ * always uses the whole sweep, the results match those of Cm_BoxTrace.
+ */
+static void Cm_TracePacketToNode(cm_trace_packet_t *packet, int32_t num, uint64_t lanes) {
+
+	if (num < 0) {
+		Cm_TracePacketToLeaf(packet, -1 - num, lanes);
+		return;
+	}
+
+	const cm_bsp_node_t *node = cm_bsp.nodes + num;
+	const cm_bsp_plane_t *plane = node->plane;
+
+	vec_t d1[TRACE_PACKET_SIZE] __attribute__((aligned(32)));
+	vec_t d2[TRACE_PACKET_SIZE] __attribute__((aligned(32)));
+
+	vec_t offset;
+
+	// evaluate the plane for every lane at once, active or not, so that this vectorizes
+	if (AXIAL(plane)) {
+		const vec_t *s = packet->start[plane->type], *e = packet->end[plane->type];
+		const vec_t dist = plane->dist;
+
+		for (int32_t i = 0; i < TRACE_PACKET_SIZE; i++) {
+			d1[i] = s[i] - dist;
+			d2[i] = e[i] - dist;
+		}
+
+		offset = packet->extents[plane->type];
 	} else {
-		VectorLerp(start, end, data.trace.fraction, data.trace.end);
+		const vec_t nx = plane->normal[0], ny = plane->normal[1], nz = plane->normal[2];
+		const vec_t dist = plane->dist;
+
+		for (int32_t i = 0; i < TRACE_PACKET_SIZE; i++) {
+			d1[i] = nx * packet->start[0][i] + ny * packet->start[1][i] + nz * packet->start[2][i] - dist;
+			d2[i] = nx * packet->end[0][i] + ny * packet->end[1][i] + nz * packet->end[2][i] - dist;
+		}
+
+		if (packet->is_point)
+			offset = 0.0;
+		else
+			offset = fabsf(packet->extents[0] * nx)
+					+ fabsf(packet->extents[1] * ny)
+					+ fabsf(packet->extents[2] * nz);
 	}
 
-	return data.trace;
+	// partition the lanes by the sides their sweeps touch, and by the side they start on
+	uint64_t front = 0, back = 0, starts_back = 0;
+
+	for (int32_t i = 0; i < TRACE_PACKET_SIZE; i++) {
+		const uint64_t bit = 1ull << i;
+
+		if (!(d1[i] <= -offset && d2[i] <= -offset))
+			front |= bit;
+		if (!(d1[i] >= offset && d2[i] >= offset))
+			back |= bit;
+		if (d1[i] < d2[i])
+			starts_back |= bit;
+	}
+
+	front &= lanes;
+	back &= lanes;
+
+	// visit the side that most of the lanes start on first
+	const int32_t side = __builtin_popcountll(starts_back & lanes) > __builtin_popcountll(lanes) / 2;
+
+	uint64_t near = side ? back : front;
+	uint64_t far = side ? front : back;
+
+	if (near) {
+		Cm_TracePacketToNode(packet, node->children[side], near);
+	}
+
+	// cull lanes that have already hit something nearer than the far side
+	uint64_t l = near & far;
+	while (l) {
+		const int32_t i = __builtin_ctzll(l);
+		l &= l - 1;
+
+		const cm_trace_t *trace = &packet->data[i].trace;
+
+		if (trace->all_solid) {
+			far &= ~(1ull << i);
+			continue;
+		}
+
+		if (d1[i] == d2[i])
+			continue;
+
+		const vec_t idist = 1.0 / (d1[i] - d2[i]);
+		vec_t frac;
+
+		if (d1[i] < d2[i]) {
+			frac = (d1[i] + offset + DIST_EPSILON) * idist;
+		} else {
+			frac = (d1[i] - offset - DIST_EPSILON) * idist;
+		}
+
+		// only lanes starting on the near side can be culled this way
+		if ((d1[i] < d2[i]) == side && trace->fraction <= Clamp(frac, 0.0, 1.0)) {
+			far &= ~(1ull << i);
+		}
+	}
+
+	if (far) {
+		Cm_TracePacketToNode(packet, node->children[side ^ 1], far);
+	}
+}
+
+/**
+ * @brief Batched collision detection for many sweeps of the same box through
+ * the same head node, e.g. shotgun pellets or light samples. The results are
+ * those of calling Cm_BoxTrace for each sweep, but the BSP is descended
+ * once per node for up to 64 sweeps at a time.
+ *
+ * @param count The number of traces.
+ * @param starts The starting points, as arrays of x, y and z components.
+ * @param ends The desired end points, as arrays of x, y and z components.
+ * @param mins The bounding box mins, in model space.
+ * @param maxs The bounding box maxs, in model space.
+ * @param head_node The BSP head node to recurse down.
+ * @param contents The contents mask to clip to.
+ * @param traces The output traces, of length `count`.
+ */
+void Cm_BoxTraceBatch(const size_t count, const vec_t *const starts[3], const vec_t *const ends[3],
+		const vec3_t mins, const vec3_t maxs, const int32_t head_node, const int32_t contents,
+		cm_trace_t *traces) {
+
+	static __thread cm_trace_packet_t packet;
+
+	const _Bool box = Cm_BoxHullBrush(head_node) != NULL;
+
+	for (size_t i = 0; i < count; i += TRACE_PACKET_SIZE) {
+		const size_t len = MIN(count - i, (size_t) TRACE_PACKET_SIZE);
+
+		uint64_t lanes = 0;
+
+		for (size_t j = 0; j < TRACE_PACKET_SIZE; j++) {
+			const size_t k = i + MIN(j, len - 1); // pad the packet with the last trace
+
+			for (int32_t m = 0; m < 3; m++) {
+				packet.start[m][j] = starts[m][k];
+				packet.end[m][j] = ends[m][k];
+			}
+
+			if (j >= len)
+				continue;
+
+			const vec3_t start = { starts[0][k], starts[1][k], starts[2][k] };
+			const vec3_t end = { ends[0][k], ends[1][k], ends[2][k] };
+
+			if (!cm_bsp.num_nodes || box || VectorCompare(start, end)) { // resolved individually
+				traces[k] = Cm_BoxTrace(start, end, mins, maxs, head_node, contents);
+				continue;
+			}
+
+			Cm_InitTraceData(&packet.data[j], start, end, mins, maxs, contents);
+			lanes |= 1ull << j;
+		}
+
+		if (!lanes)
+			continue;
+
+		const cm_trace_data_t *data = &packet.data[__builtin_ctzll(lanes)];
+
+		VectorCopy(data->extents, packet.extents);
+		packet.is_point = data->is_point;
+
+		Cm_TracePacketToNode(&packet, head_node, lanes);
+
+		while (lanes) {
+			const int32_t j = __builtin_ctzll(lanes);
+			lanes &= lanes - 1;
+
+			Cm_FinishTraceData(&packet.data[j]);
+			traces[i + j] = packet.data[j].trace;
+		}
+	}
 }
 
 /**
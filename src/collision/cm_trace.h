@@ -27,8 +27,15 @@
 cm_trace_t Cm_BoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
 		const int32_t head_node, const int32_t contents);
 
+void Cm_BoxTraceBatch(const size_t count, const vec_t *const starts[3], const vec_t *const ends[3],
+		const vec3_t mins, const vec3_t maxs, const int32_t head_node, const int32_t contents,
+		cm_trace_t *traces);
+
 cm_trace_t Cm_TransformedBoxTrace(const vec3_t start, const vec3_t end, const vec3_t mins,
 		const vec3_t maxs, const int32_t head_node, const int32_t contents,
 		const matrix4x4_t *matrix, const matrix4x4_t *inverse_matrix);
 
+cm_trace_stats_t Cm_TraceStats(void);
+void Cm_ClearTraceStats(void);
+
 #endif /* __CM_TRACE_H__ */
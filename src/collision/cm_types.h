@@ -135,11 +135,66 @@ typedef struct {
 	struct g_entity_s *ent; // not set by Cm_*() functions
 } cm_trace_t;
 
+/**
+ * @brief Brush clipping counters, accumulated per thread by the trace
+ * functions. These measure how effectively traces avoid re-testing brushes
+ * that are referenced by more than one leaf.
+ */
+typedef struct {
+	/**
+	 * @brief The number of traces issued.
+	 */
+	uint64_t traces;
+
+	/**
+	 * @brief The number of brushes clipped to.
+	 */
+	uint64_t brushes_tested;
+
+	/**
+	 * @brief The number of brushes skipped, having been clipped to already by
+	 * the same trace in another leaf.
+	 */
+	uint64_t brushes_skipped;
+} cm_trace_stats_t;
+
+/**
+ * @brief Collision captures record the world queries issued by a server, so
+ * that they may be replayed by `bench_collision`. A capture file is a
+ * cm_capture_header_t followed by any number of cm_capture_t, in the byte
+ * order of the recording host.
+ */
+#define CM_CAPTURE_MAGIC		(('C' << 0) | ('M' << 8) | ('C' << 16) | ('1' << 24))
+
+typedef struct {
+	int32_t magic;
+	char map[MAX_QPATH]; // the BSP the queries were issued against
+} cm_capture_header_t;
+
+typedef enum {
+	CM_CAPTURE_BOX_TRACE,
+	CM_CAPTURE_POINT_CONTENTS,
+	CM_CAPTURE_BOX_LEAFNUMS,
+	CM_CAPTURE_TYPES
+} cm_capture_type_t;
+
+/**
+ * @brief A single captured query. Cm_PointContents records its point in
+ * `start`, and Cm_BoxLeafnums its bounds in `mins` and `maxs`.
+ */
+typedef struct {
+	int32_t type;
+	int32_t contents;
+	vec3_t start, end;
+	vec3_t mins, maxs;
+} cm_capture_t;
+
 #ifdef __CM_LOCAL_H__
 
 typedef struct {
 	cm_bsp_plane_t *plane;
 	int32_t children[2]; // negative numbers are leafs
+	const struct cm_bvh_s *bvh; // for model head nodes, the model's BVH, if any
 } cm_bsp_node_t;
 
 typedef struct {
@@ -155,18 +210,31 @@ typedef struct {
 	uint16_t num_leaf_brushes;
 } cm_bsp_leaf_t;
 
+/**
+ * @brief Brush side planes are packed in groups of this many, so that they may
+ * be evaluated a SIMD register at a time.
+ */
+#define CM_SIMD_WIDTH 4
+
 typedef struct {
 	int32_t contents;
 	int32_t num_sides;
 	int32_t first_brush_side;
+	const cm_bsp_brush_side_t *sides; // resolved from first_brush_side
 	vec3_t mins, maxs;
+
+	/**
+	 * @brief The side plane normals and distances in structure-of-arrays form:
+	 * all x components, then y, z and dist, each padded to CM_SIMD_WIDTH.
+	 * This is `NULL` for the box hull, which is clipped by the scalar path.
+	 */
+	vec_t *side_planes;
+	int32_t num_side_planes;
 } cm_bsp_brush_t;
 
 typedef struct {
 	int32_t num_area_portals;
 	int32_t first_area_portal;
-	int32_t flood_num; // if two areas have equal flood_nums, they are connected
-	int32_t flood_valid;
 } cm_bsp_area_t;
 
 #endif /* __CM_LOCAL_H__ */
@@ -59,6 +59,79 @@ static void Cm_DecompressVis(const byte *in, byte *out) {
 	}
 }
 
+/**
+ * @brief The memory budget, in bytes, for the decompressed PVS and PHS
+ * matrices. If a map's matrices would exceed this, visibility is decompressed
+ * on demand instead.
+ */
+size_t cm_vis_matrix_budget = CM_VIS_MATRIX_BUDGET;
+
+/**
+ * @brief Vis matrix rows are padded and aligned to this many bytes.
+ */
+#define VIS_MATRIX_ALIGN 64
+
+/**
+ * @brief Decompresses the PVS and PHS of every cluster into a pair of
+ * cache-aligned bit matrices, so that visibility queries need not decompress
+ * anything at run time. This is skipped if the matrices would exceed
+ * `cm_vis_matrix_budget`.
+ */
+void Cm_InitVisMatrix(void) {
+
+	const int32_t num_clusters = cm_vis->num_clusters;
+
+	if (num_clusters <= 0)
+		return;
+
+	const size_t len = (num_clusters + 7) >> 3;
+	const size_t row_size = (len + VIS_MATRIX_ALIGN - 1) & ~(VIS_MATRIX_ALIGN - 1);
+	const size_t size = row_size * num_clusters * 2;
+
+	if (size > cm_vis_matrix_budget) {
+		Com_Debug("%zu bytes exceeds budget of %zu bytes\n", size, cm_vis_matrix_budget);
+		return;
+	}
+
+	cm_bsp.vis_matrix = Mem_Malloc(size + VIS_MATRIX_ALIGN);
+
+	const uintptr_t base = (uintptr_t) cm_bsp.vis_matrix + VIS_MATRIX_ALIGN - 1;
+
+	cm_bsp.pvs_matrix = (byte *) (base & ~((uintptr_t) VIS_MATRIX_ALIGN - 1));
+	cm_bsp.phs_matrix = cm_bsp.pvs_matrix + row_size * num_clusters;
+
+	for (int32_t i = 0; i < num_clusters; i++) {
+		const int32_t *ofs = cm_vis->bit_offsets[i];
+
+		Cm_DecompressVis(cm_bsp.visibility + ofs[DVIS_PVS], cm_bsp.pvs_matrix + i * row_size);
+		Cm_DecompressVis(cm_bsp.visibility + ofs[DVIS_PHS], cm_bsp.phs_matrix + i * row_size);
+	}
+
+	cm_bsp.vis_row_size = row_size;
+
+	Com_Debug("%d clusters, %zu bytes\n", num_clusters, size);
+}
+
+/**
+ * @brief Resolves the PVS or PHS row for the specified cluster. If the vis
+ * matrix is resident, a pointer into it is returned. Otherwise, the row is
+ * decompressed into `out`.
+ */
+static const byte *Cm_ClusterVis(const int32_t cluster, const int32_t type, byte *out) {
+	static const byte null_vis[MAX_BSP_LEAFS >> 3];
+
+	if (cluster == -1)
+		return null_vis;
+
+	if (cm_bsp.vis_row_size) {
+		const byte *matrix = type == DVIS_PVS ? cm_bsp.pvs_matrix : cm_bsp.phs_matrix;
+		return matrix + cluster * cm_bsp.vis_row_size;
+	}
+
+	Cm_DecompressVis(cm_bsp.visibility + cm_vis->bit_offsets[cluster][type], out);
+	return out;
+}
+
 /**
  * @brief
  *
@@ -68,10 +141,9 @@ size_t Cm_ClusterPVS(const int32_t cluster, byte *pvs) {
 
 	const size_t len = (cm_vis->num_clusters + 7) >> 3;
 
-	if (cluster == -1)
-		memset(pvs, 0, len);
-	else
-		Cm_DecompressVis(cm_bsp.visibility + cm_vis->bit_offsets[cluster][DVIS_PVS], pvs);
+	const byte *vis = Cm_ClusterVis(cluster, DVIS_PVS, pvs);
+	if (vis != pvs)
+		memcpy(pvs, vis, len);
 
 	return len;
 }
@@ -83,62 +155,184 @@ size_t Cm_ClusterPHS(const int32_t cluster, byte *phs) {
 
 	const size_t len = (cm_vis->num_clusters + 7) >> 3;
 
-	if (cluster == -1)
-		memset(phs, 0, len);
-	else
-		Cm_DecompressVis(cm_bsp.visibility + cm_vis->bit_offsets[cluster][DVIS_PHS], phs);
+	const byte *vis = Cm_ClusterVis(cluster, DVIS_PHS, phs);
+	if (vis != phs)
+		memcpy(phs, vis, len);
 
 	return len;
 }
 
 /**
- * @brief Recurse over the area portals, marking adjacent ones as flooded.
+ * @return The PVS for the specified cluster, without copying it. The returned
+ * bits are valid until the next map load, or, if the vis matrix is not
+ * resident, until the next call from the same thread. They must not be
+ * modified.
  */
-static void Cm_FloodArea(cm_bsp_area_t *area, int32_t flood_num) {
+const byte *Cm_ClusterPVSBits(const int32_t cluster) {
+	static __thread byte pvs[MAX_BSP_LEAFS >> 3];
 
-	if (area->flood_valid == cm_bsp.flood_valid) {
-		if (area->flood_num == flood_num)
-			return;
+	return Cm_ClusterVis(cluster, DVIS_PVS, pvs);
+}
 
-		Com_Error(ERR_DROP, "Re-flooded\n");
-	}
+/**
+ * @return The PHS for the specified cluster, without copying it.
+ *
+ * @see Cm_ClusterPVSBits
+ */
+const byte *Cm_ClusterPHSBits(const int32_t cluster) {
+	static __thread byte phs[MAX_BSP_LEAFS >> 3];
 
-	area->flood_num = flood_num;
-	area->flood_valid = cm_bsp.flood_valid;
+	return Cm_ClusterVis(cluster, DVIS_PHS, phs);
+}
 
-	const d_bsp_area_portal_t *p = &cm_bsp.area_portals[area->first_area_portal];
+/**
+ * @brief The size of one row of the area connectivity matrix, in bytes.
+ */
+#define AREA_BYTES (MAX_BSP_AREAS >> 3)
 
-	for (int32_t i = 0; i < area->num_area_portals; i++, p++) {
-		if (cm_bsp.portal_open[p->portal_num]) {
-			Cm_FloodArea(&cm_bsp.areas[p->other_area], flood_num);
+/**
+ * @return True if the given area is set in the specified bit vector.
+ */
+static inline _Bool Cm_AreaBit(const byte *bits, const int32_t area) {
+	return bits[area >> 3] & (1 << (area & 7));
+}
+
+/**
+ * @brief Floods out from the specified area through open portals, writing the
+ * areas reached to the given bit vector.
+ */
+static void Cm_FloodArea(const int32_t area_num, byte *bits) {
+	int32_t stack[MAX_BSP_AREAS];
+	int32_t depth = 0;
+
+	memset(bits, 0, AREA_BYTES);
+
+	bits[area_num >> 3] |= 1 << (area_num & 7);
+	stack[depth++] = area_num;
+
+	while (depth) {
+		const cm_bsp_area_t *area = &cm_bsp.areas[stack[--depth]];
+		const d_bsp_area_portal_t *p = &cm_bsp.area_portals[area->first_area_portal];
+
+		for (int32_t i = 0; i < area->num_area_portals; i++, p++) {
+
+			if (!cm_bsp.portal_open[p->portal_num])
+				continue;
+
+			if (Cm_AreaBit(bits, p->other_area))
+				continue;
+
+			bits[p->other_area >> 3] |= 1 << (p->other_area & 7);
+			stack[depth++] = p->other_area;
 		}
 	}
 }
 
 /**
- * @brief
+ * @brief Assigns the given connected component to every area within it.
+ */
+static void Cm_SetAreaComponent(const byte *bits) {
+
+	for (int32_t i = 0; i < cm_bsp.num_areas; i++) {
+		if (Cm_AreaBit(bits, i)) {
+			memcpy(cm_bsp.area_bits[i], bits, AREA_BYTES);
+		}
+	}
+}
+
+/**
+ * @brief Resolves the areas joined by each portal, and floods all areas to
+ * build the area connectivity matrix from scratch. Portals which are not
+ * referenced by any area are left joining area 0 to itself, so that toggling
+ * them has no effect.
  */
 void Cm_FloodAreas(void) {
-	int32_t flood_num;
 
-	// all current floods are now invalid
-	cm_bsp.flood_valid++;
+	// readers retry while the sequence is odd, see Cm_AreaFloodsBegin
+	__atomic_add_fetch(&cm_bsp.flood_seq, 1, __ATOMIC_ACQ_REL);
+
+	memset(cm_bsp.portal_areas, 0, sizeof(cm_bsp.portal_areas));
+	memset(cm_bsp.area_bits, 0, sizeof(cm_bsp.area_bits));
+
+	for (int32_t i = 0; i < cm_bsp.num_areas; i++) {
+		const cm_bsp_area_t *area = &cm_bsp.areas[i];
+
+		if (area->first_area_portal < 0 || area->num_area_portals < 0 ||
+				area->first_area_portal + area->num_area_portals > cm_bsp.num_area_portals) {
+			Com_Error(ERR_DROP, "Area %d has invalid portals\n", i);
+		}
+
+		const d_bsp_area_portal_t *p = &cm_bsp.area_portals[area->first_area_portal];
+
+		for (int32_t j = 0; j < area->num_area_portals; j++, p++) {
+
+			if (p->portal_num < 0 || p->portal_num >= MAX_BSP_AREA_PORTALS) {
+				Com_Error(ERR_DROP, "Area %d has invalid portal %d\n", i, p->portal_num);
+			}
+
+			if (p->other_area < 0 || p->other_area >= cm_bsp.num_areas) {
+				Com_Error(ERR_DROP, "Area %d has invalid neighbor %d\n", i, p->other_area);
+			}
+
+			cm_bsp.portal_areas[p->portal_num][0] = i;
+			cm_bsp.portal_areas[p->portal_num][1] = p->other_area;
+		}
+	}
 
 	// area 0 is not used
-	for (int32_t i = flood_num = 1; i < cm_bsp.num_areas; i++) {
-		cm_bsp_area_t *area = &cm_bsp.areas[i];
+	for (int32_t i = 1; i < cm_bsp.num_areas; i++) {
 
-		if (area->flood_valid == cm_bsp.flood_valid)
+		if (Cm_AreaBit(cm_bsp.area_bits[i], i))
 			continue; // already flooded into
 
-		Cm_FloodArea(area, flood_num++);
+		byte bits[AREA_BYTES];
+
+		Cm_FloodArea(i, bits);
+		Cm_SetAreaComponent(bits);
+	}
+
+	if (cm_bsp.num_areas && !Cm_AreaBit(cm_bsp.area_bits[0], 0)) {
+		cm_bsp.area_bits[0][0] = 1;
+	}
+
+	__atomic_add_fetch(&cm_bsp.flood_seq, 1, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Begins a read of the area floods, which may be refreshed by
+ * Cm_SetAreaPortalState on another thread.
+ *
+ * @return The flood sequence to pass to Cm_AreaFloodsEnd.
+ */
+static int32_t Cm_AreaFloodsBegin(void) {
+	int32_t seq;
+
+	while ((seq = __atomic_load_n(&cm_bsp.flood_seq, __ATOMIC_ACQUIRE)) & 1) {
+		;
 	}
+
+	return seq;
+}
+
+/**
+ * @return True if the area floods were not changed since Cm_AreaFloodsBegin,
+ * false if the read must be retried.
+ */
+static _Bool Cm_AreaFloodsEnd(const int32_t seq) {
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&cm_bsp.flood_seq, __ATOMIC_RELAXED) == seq;
 }
 
 /**
- * @brief Sets the state of the specified area portal and re-floods all area
- * connections, updating their flood counts such that Cm_WriteAreaBits
- * will return the correct information.
+ * @brief Sets the state of the specified area portal and updates the area
+ * connectivity matrix incrementally, such that Cm_AreasConnected and
+ * Cm_WriteAreaBits will return the correct information. Opening a portal
+ * merges the components on either side of it. Closing one floods only the
+ * component it belonged to, which splits in two if no other path remains.
+ * Concurrent area queries on other threads are safe, but only one thread may
+ * change portal states at a time.
  */
 void Cm_SetAreaPortalState(const int32_t portal_num, const _Bool open) {
 
@@ -146,8 +340,43 @@ void Cm_SetAreaPortalState(const int32_t portal_num, const _Bool open) {
 		Com_Error(ERR_DROP, "Portal %d > num_area_portals", portal_num);
 	}
 
+	if (cm_bsp.portal_open[portal_num] == open)
+		return;
+
+	const int32_t a = cm_bsp.portal_areas[portal_num][0];
+	const int32_t b = cm_bsp.portal_areas[portal_num][1];
+
+	// readers retry while the sequence is odd, see Cm_AreaFloodsBegin
+	__atomic_add_fetch(&cm_bsp.flood_seq, 1, __ATOMIC_ACQ_REL);
+
 	cm_bsp.portal_open[portal_num] = open;
-	Cm_FloodAreas();
+
+	const _Bool connected = Cm_AreaBit(cm_bsp.area_bits[a], b);
+	byte bits[AREA_BYTES];
+
+	if (open) {
+		if (!connected) {
+			for (size_t i = 0; i < AREA_BYTES; i++) {
+				bits[i] = cm_bsp.area_bits[a][i] | cm_bsp.area_bits[b][i];
+			}
+			Cm_SetAreaComponent(bits);
+		}
+	} else if (connected) {
+		Cm_FloodArea(a, bits);
+
+		if (!Cm_AreaBit(bits, b)) {
+			byte rest[AREA_BYTES];
+
+			for (size_t i = 0; i < AREA_BYTES; i++) {
+				rest[i] = cm_bsp.area_bits[a][i] & ~bits[i];
+			}
+
+			Cm_SetAreaComponent(bits);
+			Cm_SetAreaComponent(rest);
+		}
+	}
+
+	__atomic_add_fetch(&cm_bsp.flood_seq, 1, __ATOMIC_ACQ_REL);
 }
 
 /**
@@ -162,14 +391,19 @@ _Bool Cm_AreasConnected(int32_t area1, int32_t area2) {
 		Com_Error(ERR_DROP, "Area %d > cm.num_areas\n", area1 > area2 ? area1 : area2);
 	}
 
-	if (cm_bsp.areas[area1].flood_num == cm_bsp.areas[area2].flood_num)
-		return true;
+	_Bool connected;
+	int32_t seq;
+
+	do {
+		seq = Cm_AreaFloodsBegin();
+		connected = Cm_AreaBit(cm_bsp.area_bits[area1], area2);
+	} while (!Cm_AreaFloodsEnd(seq));
 
-	return false;
+	return connected;
 }
 
 /**
- * @brief Writes a bit vector of all the areas that are in the same flood as the
+ * @brief Writes a bit vector of all the areas that are connected to the
  * specified area. Returns the length of the bit vector in bytes.
  *
  * This is used by the client view to cull visibility.
@@ -180,15 +414,19 @@ int32_t Cm_WriteAreaBits(const int32_t area, byte *out) {
 
 	if (cm_no_areas) { // for debugging, send everything
 		memset(out, 0xff, bytes);
-	} else {
-		const int32_t flood_num = cm_bsp.areas[area].flood_num;
+	} else if (!area) {
 		memset(out, 0, bytes);
 
 		for (int32_t i = 0; i < cm_bsp.num_areas; i++) {
-			if (cm_bsp.areas[i].flood_num == flood_num || !area) {
-				out[i >> 3] |= 1 << (i & 7);
-			}
+			out[i >> 3] |= 1 << (i & 7);
 		}
+	} else {
+		int32_t seq;
+
+		do {
+			seq = Cm_AreaFloodsBegin();
+			memcpy(out, cm_bsp.area_bits[area], bytes);
+		} while (!Cm_AreaFloodsEnd(seq));
 	}
 
 	return bytes;
@@ -24,8 +24,16 @@
 
 #include "cm_types.h"
 
+/**
+ * @brief The default memory budget, in bytes, for the decompressed PVS and PHS
+ * matrices built at map load.
+ */
+#define CM_VIS_MATRIX_BUDGET (4 * 1024 * 1024)
+
 size_t Cm_ClusterPVS(const int32_t cluster, byte *pvs);
 size_t Cm_ClusterPHS(const int32_t cluster, byte *phs);
+const byte *Cm_ClusterPVSBits(const int32_t cluster);
+const byte *Cm_ClusterPHSBits(const int32_t cluster);
 
 void Cm_SetAreaPortalState(const int32_t portal_num, const _Bool open);
 _Bool Cm_AreasConnected(const int32_t area1, const int32_t area2);
@@ -34,6 +42,7 @@ int32_t Cm_WriteAreaBits(const int32_t area, byte *out);
 _Bool Cm_HeadnodeVisible(const int32_t head_node, const byte *vis);
 
 #ifdef __CM_LOCAL_H__
+void Cm_InitVisMatrix(void);
 void Cm_FloodAreas(void);
 #endif /* __CM_LOCAL_H__ */
 
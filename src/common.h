@@ -41,7 +41,7 @@
  * of core net messages or serialized data types change. The game and client
  * game maintain PROTOCOL_MINOR as well.
  */
-#define PROTOCOL_MAJOR		1014
+#define PROTOCOL_MAJOR		1020
 
 /**
  * @brief The IP address of the master server, where the authoritative list of
@@ -93,6 +93,19 @@
 		!*f || *f == '/' || strstr(f, "..") || strchr(f, ' ') \
 	)
 
+/*
+ * Resumed downloads are verified by the checksum of this many bytes, at most,
+ * preceding the offset at which they resume.
+ */
+#define DOWNLOAD_RESUME_CHECK	0x10000
+
+/*
+ * In place of a download chunk's size, the server indicates that it has
+ * refused the download, or resume, or that the download has failed.
+ */
+#define DOWNLOAD_REFUSED		-1
+#define DOWNLOAD_FAILED			-2
+
 typedef enum {
 	ERR_PRINT = 1,
 	ERR_WARN,
@@ -227,6 +227,13 @@ int64_t Fs_Tell(file_t *file) {
 	return PHYSFS_tell((PHYSFS_File *) file);
 }
 
+/**
+ * @return The length of the file, or -1 if it can not be determined.
+ */
+int64_t Fs_Length(file_t *file) {
+	return PHYSFS_fileLength((PHYSFS_File *) file);
+}
+
 /**
  * @brief Writes to the specified file.
  *
@@ -308,6 +315,30 @@ int64_t Fs_Load(const char *filename, void **buffer) {
 	return len;
 }
 
+/**
+ * @brief Computes the SHA1 checksum of the specified range of the file, without
+ * loading the whole of it.
+ *
+ * @return The checksum, which must be freed with g_free, or NULL on error.
+ */
+char *Fs_Checksum(const char *filename, int64_t offset, int64_t len) {
+	char *checksum = NULL;
+
+	file_t *file;
+	if ((file = Fs_OpenRead(filename))) {
+		byte *buffer = Mem_Malloc(MAX(len, 1));
+
+		if (Fs_Seek(file, offset) && Fs_Read(file, buffer, 1, len) == len) {
+			checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA1, buffer, len);
+		}
+
+		Mem_Free(buffer);
+		Fs_Close(file);
+	}
+
+	return checksum;
+}
+
 /**
  * @brief Frees the specified buffer allocated by Fs_LoadFile.
  */
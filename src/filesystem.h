@@ -47,8 +47,10 @@ int64_t Fs_Read(file_t *file, void *buffer, size_t size, size_t count);
 _Bool Fs_ReadLine(file_t *file, char *buffer, size_t len);
 _Bool Fs_Seek(file_t *file, size_t offset);
 int64_t Fs_Tell(file_t *file);
+int64_t Fs_Length(file_t *file);
 int64_t Fs_Write(file_t *file, const void *buffer, size_t size, size_t count);
 int64_t Fs_Load(const char *filename, void **buffer);
+char *Fs_Checksum(const char *filename, int64_t offset, int64_t len);
 void Fs_Free(void *buffer);
 _Bool Fs_Rename(const char *source, const char *dest);
 _Bool Fs_Unlink(const char *filename);
@@ -327,7 +327,7 @@ typedef struct {
 	void (*WriteString)(const char *s);
 	void (*WriteVector)(const vec_t v);
 	void (*WritePosition)(const vec3_t pos);
-	void (*WriteDir)(const vec3_t pos); // single byte encoded, very coarse
+	void (*WriteDir)(const vec3_t pos); // octahedral encoded, two bytes
 	void (*WriteAngle)(const vec_t v);
 	void (*WriteAngles)(const vec3_t angles);
 
@@ -138,10 +138,6 @@ static void Init(void) {
 		Cvar_ForceSet("dedicated", "1");
 	}
 
-	if (dedicated->value) {
-		Cvar_ForceSet("threads", "0");
-	}
-
 	game = Cvar_Get("game", DEFAULT_GAME, CVAR_LATCH | CVAR_SERVER_INFO, "The game module name");
 	game->modified = g_strcmp0(game->string, DEFAULT_GAME);
 
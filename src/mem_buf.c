@@ -40,6 +40,7 @@ void Mem_InitBuffer(mem_buf_t *buf, byte *data, size_t len) {
 void Mem_ClearBuffer(mem_buf_t *buf) {
 
 	buf->size = 0;
+	buf->write_bits = 0;
 	buf->overflowed = false;
 }
 
@@ -70,6 +71,9 @@ void *Mem_AllocBuffer(mem_buf_t *buf, size_t len) {
 	data = buf->data + buf->size;
 	buf->size += len;
 
+	// subsequent bit-level writes begin a new byte
+	buf->write_bits = 0;
+
 	return data;
 }
 
@@ -34,6 +34,8 @@ typedef struct {
 	size_t max_size; // maximum size before overflow
 	size_t size; // current size
 	size_t read;
+	uint8_t write_bits; // bits written to the last byte by Net_WriteBits, or 0
+	uint8_t read_bits; // bits read from the last byte by Net_ReadBits, or 0
 } mem_buf_t;
 
 void Mem_InitBuffer(mem_buf_t *buf, byte *data, size_t len);
@@ -27,34 +27,34 @@
  * packet header
  * -------------
  * 31	sequence
- * 1	does this message contain a reliable payload
+ * 1	does this packet contain reliable fragments
  * 31	acknowledge sequence
- * 1	acknowledge receipt of even/odd message
+ * 1	does this packet contain an acknowledgement of reliable fragments
  * 8	qport
  *
- * The remote connection never knows if it missed a reliable message, the
- * local side detects that it has been dropped by seeing a sequence acknowledge
- * higher than the last reliable sequence, but without the correct even/odd
- * bit for the reliable set.
- *
- * If the sender notices that a reliable message has been dropped, it will be
- * retransmitted. It will not be retransmitted again until a message after
- * the retransmit has been acknowledged and the reliable still failed to get theve.
- *
  * if the sequence number is -1, the packet should be handled without a netcon
  *
  * The reliable message can be added to at any time by doing
  * Net_Write*(&netchan->message, <data>).
  *
- * If the message buffer is overflowed, either by a single message, or by
- * multiple frames worth piling up while the last reliable transmit goes
- * unacknowledged, the netchan signals a fatal error.
+ * When the channel next transmits, the reliable message is divided into
+ * fragments of at most NETCHAN_FRAGMENT_SIZE and queued. Up to NETCHAN_WINDOW
+ * fragments may be in flight at once. Those that are due are sent in packets
+ * of at most NETCHAN_MTU, the last of which carries the unreliable payload,
+ * if it fits. If the message buffer is overflowed
+ * while the queue is full, the netchan signals a fatal error.
  *
- * Reliable messages are always placed first in a packet, then the unreliable
- * message is included if there is sufficient room.
+ * The receiver acknowledges the id below which it has received every fragment,
+ * and a mask of the fragments it has received beyond that. A fragment that is
+ * still unacknowledged when a later packet has been acknowledged was lost, and
+ * is retransmitted.
  *
- * To the receiver, there is no distinction between the reliable and unreliable
- * parts of the message, they are just processed out as a single larger message.
+ * The receiver reassembles the fragments in order, and delivers only whole
+ * reliable messages, ahead of the unreliable payload. To the receiver, there
+ * is no distinction between the reliable and unreliable parts of the message,
+ * they are just processed out as a single larger message. Should the whole
+ * messages not fit, the remainder are delivered with the next packet, and the
+ * unreliable payload is dropped to preserve their order.
  *
  * Illogical packet sequence numbers cause the packet to be dropped, but do
  * not kill the connection. This, combined with the tight window of valid
@@ -70,9 +70,41 @@
  *
  * If there is no information that needs to be transfered on a given frame,
  * such as during the connection stage while waiting for the client to load,
- * then a packet only needs to be delivered if there is something in the
- * unacknowledged reliable
+ * then a packet only needs to be delivered if Netchan_Pending.
+ *
+ * If compression was negotiated at connect, packets from the server carry a
+ * byte after the header which indicates whether the payload is raw, or Huffman
+ * coded and preceded by its raw length. The receiver restores the raw payload
+ * in place, so that it immediately follows the header.
+ */
+
+/**
+ * @brief Once a fragment is received, this many packets carry the
+ * acknowledgement, so that the loss of some of them is tolerated.
+ */
+#define NETCHAN_ACK_PACKETS	8
+
+/**
+ * @brief Fragments unacknowledged for this many milliseconds are retransmitted,
+ * even if no later packet has been acknowledged.
+ */
+#define NETCHAN_RESEND_TIME	1000
+
+/**
+ * @brief The fragment length flag marking the final fragment of a message.
+ */
+#define NETCHAN_LAST		0x8000
+
+/**
+ * @brief The most that the packet header, compression flag, acknowledgement
+ * and fragment count may add to a datagram.
  */
+#define NETCHAN_HEADER_SIZE	32
+
+#define NETCHAN_RAW			0
+#define NETCHAN_HUFFMAN		1
+
+cvar_t *net_compress;
 
 static cvar_t *net_show_packets;
 static cvar_t *net_show_drop;
@@ -114,14 +146,35 @@ void Netchan_OutOfBandPrint(int32_t sock, const net_addr_t *addr, const char *fo
 	Netchan_OutOfBand(sock, addr, (const void *) string, strlen(string));
 }
 
+/**
+ * @brief Frees the reliable fragments of a channel which is no longer used.
+ */
+void Netchan_Release(net_chan_t *chan) {
+
+	if (chan->reliable_queue) {
+		Mem_Free(chan->reliable_queue);
+		chan->reliable_queue = NULL;
+	}
+
+	if (chan->reliable_window) {
+		Mem_Free(chan->reliable_window);
+		chan->reliable_window = NULL;
+	}
+}
+
 /**
  * @brief Called to open a channel to a remote system. If greater than zero,
  * the specified qport will be used. Otherwise, one is determined at random.
  */
 void Netchan_Setup(net_src_t source, net_chan_t *chan, net_addr_t *addr, uint8_t qport) {
 
+	Netchan_Release(chan);
+
 	memset(chan, 0, sizeof(*chan));
 
+	chan->reliable_queue = Mem_Malloc(NETCHAN_QUEUE * sizeof(net_chan_fragment_t));
+	chan->reliable_window = Mem_Malloc(NETCHAN_WINDOW * sizeof(net_chan_fragment_t));
+
 	chan->source = source;
 	chan->remote_address = *addr;
 
@@ -142,54 +195,382 @@ void Netchan_Setup(net_src_t source, net_chan_t *chan, net_addr_t *addr, uint8_t
 }
 
 /**
- * @return True if reliable data must be transmitted this frame, false
- * otherwise.
+ * @return True if the fragment should be sent: it has not been sent, a later
+ * packet has been acknowledged without it, or it has simply been too long.
  */
-static _Bool Netchan_CheckRetransmit(net_chan_t *chan) {
+static _Bool Netchan_FragmentDue(const net_chan_t *chan, const net_chan_fragment_t *frag) {
 
-	// if the remote side dropped the last reliable message, re-send it
-	if (chan->incoming_acknowledged > chan->reliable_outgoing && chan->reliable_acknowledged
-			!= chan->reliable_sequence) {
+	if (frag->acknowledged)
+		return false;
+
+	if (frag->sent_sequence == 0)
 		return true;
+
+	if (frag->sent_sequence <= chan->incoming_acknowledged)
+		return true;
+
+	return quetoo.time - frag->sent_time > NETCHAN_RESEND_TIME;
+}
+
+/**
+ * @brief Divides the pending reliable message into fragments at the tail of
+ * the queue.
+ *
+ * @return True if the message was queued, or there was none, false if the
+ * queue can not yet accommodate it.
+ */
+_Bool Netchan_Queue(net_chan_t *chan) {
+
+	if (!chan->message.size)
+		return true;
+
+	if (chan->message.overflowed)
+		return false;
+
+	const uint32_t count = (chan->message.size + NETCHAN_FRAGMENT_SIZE - 1) / NETCHAN_FRAGMENT_SIZE;
+
+	if (chan->reliable_tail - chan->reliable_head + count > NETCHAN_QUEUE)
+		return false;
+
+	for (size_t offset = 0; offset < chan->message.size; offset += NETCHAN_FRAGMENT_SIZE) {
+		net_chan_fragment_t *frag = &chan->reliable_queue[chan->reliable_tail % NETCHAN_QUEUE];
+
+		frag->id = chan->reliable_tail++;
+		frag->len = MIN(chan->message.size - offset, (size_t) NETCHAN_FRAGMENT_SIZE);
+		frag->last = offset + frag->len == chan->message.size;
+		frag->acknowledged = false;
+		frag->sent_sequence = 0;
+
+		memcpy(frag->data, chan->message.data + offset, frag->len);
+	}
+
+	Mem_ClearBuffer(&chan->message);
+	return true;
+}
+
+/**
+ * @return True if the channel has reliable data or acknowledgements to send.
+ */
+_Bool Netchan_Pending(const net_chan_t *chan) {
+
+	if (chan->message.size || chan->reliable_ack_packets)
+		return true;
+
+	for (uint32_t id = chan->reliable_head; id != chan->reliable_tail; id++) {
+
+		if (id - chan->reliable_head == NETCHAN_WINDOW)
+			break;
+
+		if (Netchan_FragmentDue(chan, &chan->reliable_queue[id % NETCHAN_QUEUE]))
+			return true;
 	}
 
 	return false;
 }
 
 /**
- * @brief Tries to send an unreliable message to a connection, and handles the
- * transmission / retransmission of the reliable messages.
+ * @return The number of reliable bytes which have yet to be sent at all.
+ */
+size_t Netchan_Unsent(const net_chan_t *chan) {
+
+	size_t len = chan->message.size;
+
+	for (uint32_t id = chan->reliable_head; id != chan->reliable_tail; id++) {
+		const net_chan_fragment_t *frag = &chan->reliable_queue[id % NETCHAN_QUEUE];
+
+		if (frag->sent_sequence == 0)
+			len += frag->len;
+	}
+
+	return len;
+}
+
+/**
+ * @brief Writes the acknowledgement of the fragments we have received: the id
+ * below which all have been received, and a mask of those received beyond it.
+ */
+static void Netchan_WriteAcknowledgement(net_chan_t *chan, mem_buf_t *msg) {
+
+	uint32_t cumulative = chan->reliable_base, mask = 0;
+
+	while (cumulative - chan->reliable_base < NETCHAN_WINDOW) {
+		const net_chan_fragment_t *frag = &chan->reliable_window[cumulative % NETCHAN_WINDOW];
+
+		if (!frag->acknowledged || frag->id != cumulative)
+			break;
+
+		cumulative++;
+	}
+
+	for (uint32_t i = 0; i < 32; i++) {
+		const uint32_t id = cumulative + 1 + i;
+
+		if (id - chan->reliable_base >= NETCHAN_WINDOW)
+			break;
+
+		const net_chan_fragment_t *frag = &chan->reliable_window[id % NETCHAN_WINDOW];
+
+		if (frag->acknowledged && frag->id == id)
+			mask |= 1u << i;
+	}
+
+	Net_WriteLong(msg, cumulative);
+	Net_WriteLong(msg, mask);
+}
+
+/**
+ * @brief Marks the fragments the remote side has received, and releases those
+ * at the head of the queue.
+ */
+static void Netchan_ReadAcknowledgement(net_chan_t *chan, mem_buf_t *msg) {
+
+	const uint32_t cumulative = Net_ReadLong(msg);
+	const uint32_t mask = Net_ReadLong(msg);
+
+	// ignore acknowledgements of fragments we have not sent
+	if (cumulative - chan->reliable_head > chan->reliable_tail - chan->reliable_head)
+		return;
+
+	for (uint32_t id = chan->reliable_head; id != chan->reliable_tail; id++) {
+		net_chan_fragment_t *frag = &chan->reliable_queue[id % NETCHAN_QUEUE];
+
+		if ((int32_t) (id - cumulative) < 0) {
+			frag->acknowledged = true;
+		} else if (id != cumulative && id - cumulative - 1 < 32) {
+			if (mask & (1u << (id - cumulative - 1)))
+				frag->acknowledged = true;
+		}
+	}
+
+	while (chan->reliable_head != chan->reliable_tail) {
+		if (!chan->reliable_queue[chan->reliable_head % NETCHAN_QUEUE].acknowledged)
+			break;
+		chan->reliable_head++;
+	}
+}
+
+/**
+ * @brief Reads the fragments of the packet into the reassembly window.
  *
- * A 0 size will still generate a packet and deal with the reliable messages.
+ * @return False if the packet is corrupt.
  */
-void Netchan_Transmit(net_chan_t *chan, byte *data, size_t len) {
-	mem_buf_t send;
-	byte send_buffer[MAX_MSG_SIZE];
+static _Bool Netchan_ReadFragments(net_chan_t *chan, mem_buf_t *msg) {
 
-	// check for message overflow
-	if (chan->message.overflowed) {
-		Com_Error(ERR_DROP, "%s: Overflow\n", Net_NetaddrToString(&chan->remote_address));
+	const int32_t count = Net_ReadByte(msg);
+
+	for (int32_t i = 0; i < count; i++) {
+		const uint32_t id = Net_ReadLong(msg);
+		const uint16_t bits = Net_ReadShort(msg);
+
+		const uint16_t len = bits & ~NETCHAN_LAST;
+
+		if (len > NETCHAN_FRAGMENT_SIZE || msg->read + len > msg->size)
+			return false;
+
+		// acknowledge even duplicates, as our acknowledgement may have been lost
+		chan->reliable_ack_packets = NETCHAN_ACK_PACKETS;
+
+		if (id - chan->reliable_base < NETCHAN_WINDOW) {
+			net_chan_fragment_t *frag = &chan->reliable_window[id % NETCHAN_WINDOW];
+
+			if (!frag->acknowledged || frag->id != id) {
+				frag->id = id;
+				frag->len = len;
+				frag->last = !!(bits & NETCHAN_LAST);
+				frag->acknowledged = true;
+
+				memcpy(frag->data, msg->data + msg->read, len);
+			}
+		}
+
+		msg->read += len;
 	}
 
-	// check for re-transmission of reliable message
-	_Bool send_reliable = Netchan_CheckRetransmit(chan);
+	return msg->read <= msg->size;
+}
+
+/**
+ * @brief Rewrites the packet so that the whole reliable messages reassembled
+ * in the window, followed by the unreliable payload, begin at the given offset.
+ */
+static void Netchan_Deliver(net_chan_t *chan, mem_buf_t *msg, size_t offset) {
+	byte buffer[MAX_MSG_SIZE];
+	mem_buf_t out;
+
+	Mem_InitBuffer(&out, buffer, MIN(sizeof(buffer), msg->max_size - offset));
+
+	_Bool pending = false;
+
+	while (true) {
+		size_t len = 0;
+		uint32_t count = 0;
+		_Bool whole = false;
+
+		// find a whole message at the front of the window
+		while (count < NETCHAN_WINDOW) {
+			const uint32_t id = chan->reliable_base + count;
+			const net_chan_fragment_t *frag = &chan->reliable_window[id % NETCHAN_WINDOW];
 
-	// or for transmission of a new one
-	if (!chan->reliable_size && chan->message.size) {
-		memcpy(chan->reliable_buffer, chan->message_buffer, chan->message.size);
-		chan->reliable_size = chan->message.size;
-		chan->message.size = 0;
-		chan->reliable_sequence ^= 1;
-		send_reliable = true;
+			if (!frag->acknowledged || frag->id != id)
+				break;
+
+			len += frag->len;
+			count++;
+
+			if (frag->last) {
+				whole = true;
+				break;
+			}
+		}
+
+		if (!whole)
+			break;
+
+		if (out.size + len > out.max_size) {
+			pending = true;
+			break;
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+			net_chan_fragment_t *frag = &chan->reliable_window[(chan->reliable_base + i) % NETCHAN_WINDOW];
+
+			Mem_WriteBuffer(&out, frag->data, frag->len);
+			frag->acknowledged = false;
+		}
+
+		chan->reliable_base += count;
+	}
+
+	const size_t len = msg->size - msg->read;
+
+	if (pending || out.size + len > out.max_size) {
+		Com_Debug("%s: Dropped unreliable\n", Net_NetaddrToString(&chan->remote_address));
+	} else {
+		Mem_WriteBuffer(&out, msg->data + msg->read, len);
+	}
+
+	memcpy(msg->data + offset, out.data, out.size);
+
+	msg->size = offset + out.size;
+	msg->read = offset;
+}
+
+/**
+ * @brief Huffman codes the payload following the compression byte at the
+ * given offset, if doing so makes the packet smaller.
+ */
+static void Netchan_Compress(mem_buf_t *send, size_t offset) {
+	byte buffer[MAX_MSG_SIZE];
+
+	const byte *payload = send->data + offset + 1;
+	const size_t len = send->size - offset - 1;
+
+	if (len < 4)
+		return;
+
+	// the encoding must save more than the length it is preceded by
+	const size_t size = Net_HuffmanEncode(payload, len, buffer, len - 3);
+	if (size) {
+		send->size = offset;
+
+		Net_WriteByte(send, NETCHAN_HUFFMAN);
+		Net_WriteShort(send, len);
+		Mem_WriteBuffer(send, buffer, size);
 	}
+}
+
+/**
+ * @brief Restores the raw payload following the compression byte at the
+ * current read offset, so that it begins at that offset.
+ *
+ * @return True if the payload was restored, false if the packet is corrupt.
+ */
+static _Bool Netchan_Decompress(mem_buf_t *msg) {
+
+	const size_t offset = msg->read;
+	const int32_t type = Net_ReadByte(msg);
+
+	if (type == NETCHAN_HUFFMAN) {
+		byte buffer[MAX_MSG_SIZE];
+
+		const size_t len = (uint16_t) Net_ReadShort(msg);
+
+		if (msg->read > msg->size || len > msg->max_size - offset) {
+			return false;
+		}
+
+		if (!Net_HuffmanDecode(msg->data + msg->read, msg->size - msg->read, buffer, len)) {
+			return false;
+		}
+
+		memcpy(msg->data + offset, buffer, len);
+		msg->size = offset + len;
+	} else if (type == NETCHAN_RAW) {
+		memmove(msg->data + offset, msg->data + offset + 1, msg->size - offset - 1);
+		msg->size--;
+	} else {
+		return false;
+	}
+
+	msg->read = offset;
+	return true;
+}
+
+/**
+ * @brief Gathers the fragments in the window that are due, up to as many as fit
+ * in one datagram.
+ *
+ * @return The number of fragments gathered.
+ */
+static size_t Netchan_DueFragments(net_chan_t *chan, net_chan_fragment_t **frags, size_t *size) {
+	size_t num_frags = 0;
+
+	*size = 0;
+
+	for (uint32_t id = chan->reliable_head; id != chan->reliable_tail; id++) {
+
+		if (id - chan->reliable_head == NETCHAN_WINDOW)
+			break;
+
+		net_chan_fragment_t *frag = &chan->reliable_queue[id % NETCHAN_QUEUE];
+
+		if (!Netchan_FragmentDue(chan, frag))
+			continue;
+
+		const size_t frag_size = 6 + frag->len;
+
+		if (num_frags && *size + frag_size > NETCHAN_MTU - NETCHAN_HEADER_SIZE)
+			break;
+
+		frags[num_frags++] = frag;
+		*size += frag_size;
+	}
+
+	return num_frags;
+}
+
+/**
+ * @brief Sends one datagram carrying the given fragments, any pending
+ * acknowledgement, and the unreliable payload.
+ *
+ * @return The size of the datagram.
+ */
+static size_t Netchan_TransmitDatagram(net_chan_t *chan, net_chan_fragment_t **frags, size_t num_frags,
+		const byte *data, size_t len) {
+
+	mem_buf_t send;
+	byte send_buffer[MAX_MSG_SIZE];
+
+	const _Bool send_ack = chan->reliable_ack_packets > 0;
 
 	// write the packet header
 	Mem_InitBuffer(&send, send_buffer, sizeof(send_buffer));
 
-	const uint32_t w1 = (chan->outgoing_sequence & ~(1 << 31)) | (send_reliable << 31);
-	const uint32_t w2 = (chan->incoming_sequence & ~(1 << 31)) | (chan->reliable_incoming << 31);
+	const uint32_t sequence = chan->outgoing_sequence++;
+
+	const uint32_t w1 = (sequence & ~(1u << 31)) | ((uint32_t) (num_frags > 0) << 31);
+	const uint32_t w2 = (chan->incoming_sequence & ~(1u << 31)) | ((uint32_t) send_ack << 31);
 
-	chan->outgoing_sequence++;
 	chan->last_sent = quetoo.time;
 
 	Net_WriteLong(&send, w1);
@@ -199,30 +580,102 @@ void Netchan_Transmit(net_chan_t *chan, byte *data, size_t len) {
 	if (chan->source == NS_UDP_CLIENT)
 		Net_WriteByte(&send, chan->qport);
 
-	// copy the reliable message to the packet first
-	if (send_reliable) {
-		Mem_WriteBuffer(&send, chan->reliable_buffer, chan->reliable_size);
-		chan->reliable_outgoing = chan->outgoing_sequence;
+	// reserve the compression byte if we are a server that may compress
+	const _Bool compress = chan->compress && chan->source == NS_UDP_SERVER;
+	const size_t offset = send.size;
+
+	if (compress)
+		Net_WriteByte(&send, NETCHAN_RAW);
+
+	// acknowledge the fragments we have received
+	if (send_ack) {
+		Netchan_WriteAcknowledgement(chan, &send);
+		chan->reliable_ack_packets--;
+	}
+
+	// copy the reliable fragments to the packet first
+	if (num_frags) {
+		Net_WriteByte(&send, num_frags);
+
+		for (size_t i = 0; i < num_frags; i++) {
+			net_chan_fragment_t *frag = frags[i];
+
+			Net_WriteLong(&send, frag->id);
+			Net_WriteShort(&send, frag->len | (frag->last ? NETCHAN_LAST : 0));
+			Mem_WriteBuffer(&send, frag->data, frag->len);
+
+			frag->sent_sequence = sequence;
+			frag->sent_time = quetoo.time;
+		}
 	}
 
 	// add the unreliable part if space is available
-	if (send.max_size - send.size >= len)
-		Mem_WriteBuffer(&send, data, len);
-	else
-		Com_Warn("Netchan_Transmit: dumped unreliable\n");
+	if (len) {
+		if (send.max_size - send.size >= len)
+			Mem_WriteBuffer(&send, data, len);
+		else
+			Com_Warn("Netchan_Transmit: dumped unreliable\n");
+	}
+
+	if (compress)
+		Netchan_Compress(&send, offset);
 
 	// send the datagram
 	Net_SendDatagram(chan->source, &chan->remote_address, send.data, send.size);
 
 	if (net_show_packets->value) {
-		if (send_reliable)
-			Com_Print("Send %u bytes: s=%i reliable=%i ack=%i rack=%i\n", (uint32_t) send.size,
-					chan->outgoing_sequence - 1, chan->reliable_sequence, chan->incoming_sequence,
-					chan->reliable_incoming);
+		if (num_frags)
+			Com_Print("Send %u bytes: s=%u fragments=%u-%u ack=%u\n", (uint32_t) send.size,
+					sequence, frags[0]->id, frags[num_frags - 1]->id, chan->incoming_sequence);
 		else
-			Com_Print("Send %u bytes : s=%i ack=%i rack=%i\n", (uint32_t) send.size,
-					chan->outgoing_sequence - 1, chan->incoming_sequence, chan->reliable_incoming);
+			Com_Print("Send %u bytes : s=%u ack=%u\n", (uint32_t) send.size, sequence,
+					chan->incoming_sequence);
+	}
+
+	return send.size;
+}
+
+/**
+ * @brief Tries to send an unreliable message to a connection, and handles the
+ * transmission / retransmission of the reliable messages.
+ *
+ * A 0 size will still generate a packet and deal with the reliable messages.
+ * Reliable fragments are sent in datagrams of at most NETCHAN_MTU, so that
+ * several may be sent, with the unreliable message in the last that fits it.
+ *
+ * @return The size of the datagrams that were sent.
+ */
+size_t Netchan_Transmit(net_chan_t *chan, byte *data, size_t len) {
+
+	// queue the reliable message, if there is room for it
+	if (!Netchan_Queue(chan) && chan->message.overflowed) {
+		Com_Error(ERR_DROP, "%s: Overflow\n", Net_NetaddrToString(&chan->remote_address));
 	}
+
+	size_t size = 0;
+	_Bool unreliable = true;
+
+	while (true) {
+		net_chan_fragment_t *frags[NETCHAN_WINDOW];
+		size_t frags_size;
+
+		const size_t num_frags = Netchan_DueFragments(chan, frags, &frags_size);
+
+		if (unreliable) {
+			// send the unreliable message with the fragments, if they fit together
+			if (!num_frags || frags_size + len <= NETCHAN_MTU - NETCHAN_HEADER_SIZE) {
+				size += Netchan_TransmitDatagram(chan, frags, num_frags, data, len);
+				unreliable = false;
+				continue;
+			}
+		} else if (!num_frags) {
+			break;
+		}
+
+		size += Netchan_TransmitDatagram(chan, frags, num_frags, NULL, 0);
+	}
+
+	return size;
 }
 
 /**
@@ -230,32 +683,26 @@ void Netchan_Transmit(net_chan_t *chan, byte *data, size_t len) {
  * modifies net_message so that it points to the packet payload
  */
 _Bool Netchan_Process(net_chan_t *chan, mem_buf_t *msg) {
-	uint32_t sequence, sequence_ack;
-	uint32_t reliable_ack, reliable_message;
 
 	// get sequence numbers
 	Net_BeginReading(msg);
 
-	sequence = Net_ReadLong(msg);
-	sequence_ack = Net_ReadLong(msg);
+	uint32_t sequence = Net_ReadLong(msg);
+	uint32_t sequence_ack = Net_ReadLong(msg);
 
 	// read the qport if we are a server
 	if (chan->source == NS_UDP_SERVER)
 		Net_ReadByte(msg);
 
-	reliable_message = sequence >> 31;
-	reliable_ack = sequence_ack >> 31;
+	const _Bool fragments = sequence >> 31;
+	const _Bool ack = sequence_ack >> 31;
 
-	sequence &= ~(1 << 31);
-	sequence_ack &= ~(1 << 31);
+	sequence &= ~(1u << 31);
+	sequence_ack &= ~(1u << 31);
 
 	if (net_show_packets->value) {
-		if (reliable_message)
-			Com_Print("Recv %u bytes: s=%i reliable=%i ack=%i rack=%i\n", (uint32_t) msg->size,
-					sequence, chan->reliable_incoming ^ 1, sequence_ack, reliable_ack);
-		else
-			Com_Print("Recv %u bytes : s=%i ack=%i rack=%i\n", (uint32_t) msg->size, sequence,
-					sequence_ack, reliable_ack);
+		Com_Print("Recv %u bytes: s=%u%s ack=%u%s\n", (uint32_t) msg->size, sequence,
+				fragments ? " fragments" : "", sequence_ack, ack ? " reliable" : "");
 	}
 
 	// discard stale or duplicated packets
@@ -266,6 +713,36 @@ _Bool Netchan_Process(net_chan_t *chan, mem_buf_t *msg) {
 		return false;
 	}
 
+	// restore the raw payload if we are a client that may have received compressed data
+	if (chan->compress && chan->source == NS_UDP_CLIENT) {
+		if (!Netchan_Decompress(msg)) {
+			Com_Warn("%s: Corrupt compressed packet %i\n", Net_NetaddrToString(&chan->remote_address),
+					sequence);
+			return false;
+		}
+	}
+
+	const size_t offset = msg->read;
+
+	// release the fragments the remote side has received
+	if (ack) {
+		Netchan_ReadAcknowledgement(chan, msg);
+	}
+
+	// and gather the fragments it has sent
+	if (fragments) {
+		if (!Netchan_ReadFragments(chan, msg)) {
+			Com_Warn("%s: Corrupt fragments in packet %i\n", Net_NetaddrToString(&chan->remote_address),
+					sequence);
+			return false;
+		}
+	}
+
+	if (msg->read > msg->size) {
+		Com_Warn("%s: Truncated packet %i\n", Net_NetaddrToString(&chan->remote_address), sequence);
+		return false;
+	}
+
 	// dropped packets don't keep the message from being used
 	chan->dropped = sequence - (chan->incoming_sequence + 1);
 	if (chan->dropped > 0) {
@@ -274,18 +751,11 @@ _Bool Netchan_Process(net_chan_t *chan, mem_buf_t *msg) {
 					chan->dropped, sequence);
 	}
 
-	// if the current outgoing reliable message has been acknowledged
-	// clear the buffer to make way for the next
-	if (reliable_ack == chan->reliable_sequence)
-		chan->reliable_size = 0; // it has been received
-
-	// if this message contains a reliable message, bump reliable_incoming
 	chan->incoming_sequence = sequence;
 	chan->incoming_acknowledged = sequence_ack;
-	chan->reliable_acknowledged = reliable_ack;
-	if (reliable_message) {
-		chan->reliable_incoming ^= 1;
-	}
+
+	// deliver whole reliable messages ahead of the unreliable payload
+	Netchan_Deliver(chan, msg, offset);
 
 	// the message can now be read from the current message pointer
 	chan->last_received = quetoo.time;
@@ -300,10 +770,14 @@ void Netchan_Init(void) {
 
 	Net_Init();
 
+	net_compress = Cvar_Get("net_compress", "1", CVAR_ARCHIVE,
+			"Compress server to client packets when both sides support it");
 	net_show_packets = Cvar_Get("net_show_packets", "0", 0, NULL);
 	net_show_drop = Cvar_Get("net_show_drop", "0", 0, NULL);
 
 	Mem_InitBuffer(&net_message, net_message_buffer, sizeof(net_message_buffer));
+
+	Net_InitHuffman();
 }
 
 /**
@@ -22,14 +22,22 @@
 #ifndef __NET_CHAN_H__
 #define __NET_CHAN_H__
 
+#include "cvar.h"
 #include "net_udp.h"
 #include "net_message.h"
+#include "net_huffman.h"
+
+extern cvar_t *net_compress;
 
 extern net_addr_t net_from;
 extern mem_buf_t net_message;
 
 void Netchan_Setup(net_src_t source, net_chan_t *chan, net_addr_t *addr, uint8_t qport);
-void Netchan_Transmit(net_chan_t *chan, byte *data, size_t len);
+void Netchan_Release(net_chan_t *chan);
+_Bool Netchan_Queue(net_chan_t *chan);
+_Bool Netchan_Pending(const net_chan_t *chan);
+size_t Netchan_Unsent(const net_chan_t *chan);
+size_t Netchan_Transmit(net_chan_t *chan, byte *data, size_t len);
 void Netchan_OutOfBand(int32_t sock, const net_addr_t *addr, const void *data, size_t len);
 void Netchan_OutOfBandPrint(int32_t sock, const net_addr_t *addr, const char *format, ...) __attribute__((format(printf, 3, 4)));
 _Bool Netchan_Process(net_chan_t *chan, mem_buf_t *msg);
@@ -0,0 +1,256 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+
+#include "net_huffman.h"
+
+/**
+ * @brief The byte frequencies of server to client packet payloads, from which
+ * the static Huffman model is built. The distribution is dominated by the
+ * zero bytes of delta compressed states, small integers, and the ASCII text
+ * of config strings and prints. This initial model is an estimate of that
+ * distribution; replace it with the output of `bench_net -train` over a corpus
+ * of recorded demos, and increment NET_HUFFMAN_MODEL when doing so.
+ */
+static const uint32_t net_huffman_freqs[256] = {
+	24000, 4000, 2000, 1333, 1000, 800, 666, 571, 500, 444, 400, 363, 333, 307, 285, 266,
+	160, 160, 160, 160, 160, 160, 160, 160, 160, 160, 160, 160, 160, 160, 160, 160,
+	140, 90, 90, 90, 90, 90, 90, 90, 90, 90, 90, 90, 90, 90, 140, 140,
+	140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 90, 90, 90, 90, 90, 90,
+	90, 140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 140,
+	140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 140, 90, 90, 90, 90, 140,
+	90, 240, 240, 240, 240, 240, 240, 240, 240, 240, 240, 240, 240, 240, 240, 240,
+	240, 240, 240, 240, 240, 240, 240, 240, 240, 240, 240, 90, 90, 90, 90, 80,
+	80, 79, 79, 78, 78, 77, 77, 76, 76, 75, 75, 74, 74, 73, 73, 72,
+	72, 71, 71, 70, 70, 69, 69, 68, 68, 67, 67, 66, 66, 65, 65, 64,
+	64, 63, 63, 62, 62, 61, 61, 60, 60, 59, 59, 58, 58, 57, 57, 56,
+	56, 55, 55, 54, 54, 53, 53, 52, 52, 51, 51, 50, 50, 49, 49, 48,
+	48, 47, 47, 46, 46, 45, 45, 44, 44, 43, 43, 42, 42, 41, 41, 40,
+	40, 39, 39, 38, 38, 37, 37, 36, 36, 35, 35, 34, 34, 33, 33, 32,
+	32, 31, 31, 30, 30, 29, 29, 28, 28, 27, 27, 26, 26, 25, 25, 24,
+	60, 66, 72, 78, 84, 90, 96, 102, 108, 114, 120, 126, 132, 138, 144, 2000,
+};
+
+/**
+ * @brief A Huffman code, bit-reversed so that it may be written least
+ * significant bit first.
+ */
+typedef struct {
+	uint16_t code;
+	uint8_t len;
+} net_huffman_code_t;
+
+/**
+ * @brief A decoding table entry, indexed by the next NET_HUFFMAN_MAX_BITS of
+ * input.
+ */
+typedef struct {
+	uint8_t symbol;
+	uint8_t len;
+} net_huffman_entry_t;
+
+static struct {
+	net_huffman_code_t codes[256];
+	net_huffman_entry_t table[1 << NET_HUFFMAN_MAX_BITS];
+} net_huffman;
+
+/**
+ * @brief Resolves the Huffman code length of each symbol for the given
+ * frequencies.
+ *
+ * @return The longest code length.
+ */
+static int32_t Net_HuffmanLengths(const uint32_t *freqs, uint8_t *lengths) {
+	uint32_t weights[512];
+	int32_t parents[512];
+
+	for (int32_t i = 0; i < 256; i++) {
+		weights[i] = MAX(freqs[i], 1u);
+		parents[i] = -1;
+	}
+
+	// repeatedly join the two lightest orphans under a new parent
+	for (int32_t node = 256; node < 511; node++) {
+		int32_t a = -1, b = -1;
+
+		for (int32_t i = 0; i < node; i++) {
+			if (parents[i] != -1)
+				continue;
+
+			if (a == -1 || weights[i] < weights[a]) {
+				b = a;
+				a = i;
+			} else if (b == -1 || weights[i] < weights[b]) {
+				b = i;
+			}
+		}
+
+		weights[node] = weights[a] + weights[b];
+		parents[node] = -1;
+
+		parents[a] = parents[b] = node;
+	}
+
+	int32_t max_len = 0;
+
+	for (int32_t i = 0; i < 256; i++) {
+		int32_t len = 0;
+
+		for (int32_t n = i; parents[n] != -1; n = parents[n]) {
+			len++;
+		}
+
+		lengths[i] = len;
+		max_len = MAX(max_len, len);
+	}
+
+	return max_len;
+}
+
+/**
+ * @brief Builds the canonical Huffman codes and the decoding table from the
+ * given byte frequencies. Frequencies are flattened until no code exceeds
+ * NET_HUFFMAN_MAX_BITS, so that every symbol is decoded with one lookup.
+ */
+void Net_InitHuffmanModel(const uint32_t *model) {
+	uint32_t freqs[256];
+	uint8_t lengths[256];
+
+	memcpy(freqs, model, sizeof(freqs));
+
+	while (Net_HuffmanLengths(freqs, lengths) > NET_HUFFMAN_MAX_BITS) {
+		for (int32_t i = 0; i < 256; i++) {
+			freqs[i] = (freqs[i] >> 1) | 1;
+		}
+	}
+
+	// assign the canonical codes, shortest first
+	uint32_t counts[NET_HUFFMAN_MAX_BITS + 1], next[NET_HUFFMAN_MAX_BITS + 1];
+	memset(counts, 0, sizeof(counts));
+
+	for (int32_t i = 0; i < 256; i++) {
+		counts[lengths[i]]++;
+	}
+
+	counts[0] = 0;
+
+	uint32_t code = 0;
+	for (int32_t len = 1; len <= NET_HUFFMAN_MAX_BITS; len++) {
+		code = (code + counts[len - 1]) << 1;
+		next[len] = code;
+	}
+
+	for (int32_t i = 0; i < 256; i++) {
+		const uint8_t len = lengths[i];
+		const uint32_t c = next[len]++;
+
+		uint16_t reversed = 0;
+		for (int32_t j = 0; j < len; j++) {
+			reversed |= ((c >> j) & 1) << (len - 1 - j);
+		}
+
+		net_huffman.codes[i].code = reversed;
+		net_huffman.codes[i].len = len;
+
+		// every index whose low bits are this code decodes to this symbol
+		for (uint32_t j = reversed; j < lengthof(net_huffman.table); j += 1 << len) {
+			net_huffman.table[j].symbol = i;
+			net_huffman.table[j].len = len;
+		}
+	}
+}
+
+/**
+ * @brief Builds the static Huffman model, NET_HUFFMAN_MODEL.
+ */
+void Net_InitHuffman(void) {
+	Net_InitHuffmanModel(net_huffman_freqs);
+}
+
+/**
+ * @brief Encodes the input with the static Huffman model.
+ *
+ * @return The encoded length, or 0 if it would exceed `max_len`.
+ */
+size_t Net_HuffmanEncode(const byte *in, size_t len, byte *out, size_t max_len) {
+	uint64_t bits = 0;
+	int32_t num_bits = 0;
+	size_t size = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		const net_huffman_code_t *code = &net_huffman.codes[in[i]];
+
+		bits |= (uint64_t) code->code << num_bits;
+		num_bits += code->len;
+
+		while (num_bits >= 8) {
+			if (size == max_len) {
+				return 0;
+			}
+
+			out[size++] = bits;
+			bits >>= 8;
+			num_bits -= 8;
+		}
+	}
+
+	if (num_bits) {
+		if (size == max_len) {
+			return 0;
+		}
+
+		out[size++] = bits;
+	}
+
+	return size;
+}
+
+/**
+ * @brief Decodes exactly `out_len` bytes from the input.
+ *
+ * @return True on success, false if the input is exhausted first.
+ */
+_Bool Net_HuffmanDecode(const byte *in, size_t len, byte *out, size_t out_len) {
+	uint64_t bits = 0;
+	int32_t num_bits = 0;
+	size_t read = 0;
+
+	for (size_t i = 0; i < out_len; i++) {
+
+		while (num_bits <= 56 && read < len) {
+			bits |= (uint64_t) in[read++] << num_bits;
+			num_bits += 8;
+		}
+
+		const net_huffman_entry_t *entry = &net_huffman.table[bits & (lengthof(net_huffman.table) - 1)];
+
+		if (entry->len > num_bits) {
+			return false;
+		}
+
+		out[i] = entry->symbol;
+
+		bits >>= entry->len;
+		num_bits -= entry->len;
+	}
+
+	return true;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+
+#ifndef __NET_HUFFMAN_H__
+#define __NET_HUFFMAN_H__
+
+#include "net_types.h"
+
+/**
+ * @brief The longest Huffman code, which bounds the decoding table.
+ */
+#define NET_HUFFMAN_MAX_BITS	12
+
+/**
+ * @brief The version of the static Huffman model, which is negotiated at
+ * connect. Increment this whenever the model is retrained, so that peers with
+ * differing models simply do not compress, rather than requiring a protocol
+ * change.
+ */
+#define NET_HUFFMAN_MODEL		1
+
+void Net_InitHuffmanModel(const uint32_t *freqs);
+void Net_InitHuffman(void);
+size_t Net_HuffmanEncode(const byte *in, size_t len, byte *out, size_t max_len);
+_Bool Net_HuffmanDecode(const byte *in, size_t len, byte *out, size_t out_len);
+
+#endif /* __NET_HUFFMAN_H__ */
@@ -26,6 +26,77 @@ typedef union {
 	vec_t v;
 } net_vec_t;
 
+/**
+ * @brief The bounds of the current map, within which positions are quantized.
+ * These are set by the server when a map is loaded, and by the client from the
+ * server data message.
+ */
+static struct {
+	vec3_t mins, maxs;
+} net_bounds;
+
+/**
+ * @brief The bounds within which velocities are quantized.
+ */
+static const vec3_t net_velocity_mins = { -NET_MAX_VELOCITY, -NET_MAX_VELOCITY, -NET_MAX_VELOCITY };
+static const vec3_t net_velocity_maxs = { NET_MAX_VELOCITY, NET_MAX_VELOCITY, NET_MAX_VELOCITY };
+
+/**
+ * @brief Sets the bounds of the current map, for quantized positions.
+ */
+void Net_SetBounds(const vec3_t mins, const vec3_t maxs) {
+
+	VectorCopy(mins, net_bounds.mins);
+	VectorCopy(maxs, net_bounds.maxs);
+}
+
+/**
+ * @brief Copies the bounds of the current map, for quantized positions.
+ */
+void Net_GetBounds(vec3_t mins, vec3_t maxs) {
+
+	VectorCopy(net_bounds.mins, mins);
+	VectorCopy(net_bounds.maxs, maxs);
+}
+
+/**
+ * @return The number of bits required to quantize the given extent to the
+ * given precision, or 0 if it can not be quantized.
+ */
+static int32_t Net_QuantizedBits(const vec_t extent, const int32_t precision) {
+
+	if (!(extent > 0.0 && extent < (1 << (31 - precision))))
+		return 0;
+
+	const uint32_t range = ceilf(extent * (1 << precision));
+
+	return 32 - __builtin_clz(MAX(range, 1u));
+}
+
+/**
+ * @brief Writes the least significant bits of the given value to the message.
+ * Consecutive bit-level writes are packed together. Byte-level writes that
+ * follow begin on the next whole byte.
+ */
+void Net_WriteBits(mem_buf_t *msg, uint32_t value, int32_t bits) {
+
+	while (bits > 0) {
+
+		if (msg->write_bits == 0) {
+			byte *buf = Mem_AllocBuffer(msg, sizeof(byte));
+			buf[0] = 0;
+		}
+
+		const int32_t n = MIN(8 - msg->write_bits, bits);
+
+		msg->data[msg->size - 1] |= (value & ((1 << n) - 1)) << msg->write_bits;
+		msg->write_bits = (msg->write_bits + n) & 7;
+
+		value >>= n;
+		bits -= n;
+	}
+}
+
 /**
  * @brief
  */
@@ -125,21 +196,80 @@ void Net_WriteAngles(mem_buf_t *msg, const vec3_t angles) {
 }
 
 /**
- * @brief
+ * @brief Writes the direction with the octahedral encoding: the unit vector is
+ * projected onto the octahedron, whose lower half is folded over the upper,
+ * and the resulting square is quantized.
  */
 void Net_WriteDir(mem_buf_t *msg, const vec3_t dir) {
-	int32_t i, best = 0;
-	vec_t best_d = 0.0;
-
-	for (i = 0; i < NUM_APPROXIMATE_NORMALS; i++) {
-		const vec_t d = DotProduct(dir, approximate_normals[i]);
-		if (d > best_d) {
-			best_d = d;
-			best = i;
+	vec_t x = 0.0, y = 0.0;
+
+	const vec_t l1 = fabsf(dir[0]) + fabsf(dir[1]) + fabsf(dir[2]);
+	if (l1 > 0.0) {
+		x = dir[0] / l1;
+		y = dir[1] / l1;
+
+		if (dir[2] < 0.0) {
+			const vec_t ox = x;
+			x = (1.0 - fabsf(y)) * (ox >= 0.0 ? 1.0 : -1.0);
+			y = (1.0 - fabsf(ox)) * (y >= 0.0 ? 1.0 : -1.0);
+		}
+	}
+
+	const vec_t max = (1 << NET_DIR_BITS) - 2; // an even range, so that 0 is exact
+
+	Net_WriteBits(msg, (uint32_t) ((x * 0.5 + 0.5) * max + 0.5), NET_DIR_BITS);
+	Net_WriteBits(msg, (uint32_t) ((y * 0.5 + 0.5) * max + 0.5), NET_DIR_BITS);
+}
+
+/**
+ * @brief Writes the vector quantized to fixed point within the given bounds,
+ * or in full if it falls outside of them.
+ */
+static void Net_WriteQuantized(mem_buf_t *msg, const vec3_t v, const vec3_t mins,
+		const vec3_t maxs, const int32_t precision) {
+
+	uint32_t quantized[3];
+	int32_t bits[3];
+
+	_Bool inside = true;
+
+	for (int32_t i = 0; i < 3; i++) {
+		bits[i] = Net_QuantizedBits(maxs[i] - mins[i], precision);
+
+		if (!bits[i] || !(v[i] >= mins[i] && v[i] <= maxs[i])) {
+			inside = false;
+			break;
+		}
+
+		quantized[i] = (uint32_t) ((v[i] - mins[i]) * (1 << precision) + 0.5);
+	}
+
+	Net_WriteBits(msg, inside, 1);
+
+	for (int32_t i = 0; i < 3; i++) {
+		if (inside) {
+			Net_WriteBits(msg, quantized[i], bits[i]);
+		} else {
+			const net_vec_t vec = {
+				.v = v[i]
+			};
+			Net_WriteBits(msg, vec.i, 32);
 		}
 	}
+}
+
+/**
+ * @brief Writes the position quantized within the bounds of the current map.
+ */
+void Net_WriteQuantizedPosition(mem_buf_t *msg, const vec3_t pos) {
+	Net_WriteQuantized(msg, pos, net_bounds.mins, net_bounds.maxs, NET_POSITION_PRECISION);
+}
 
-	Net_WriteByte(msg, best);
+/**
+ * @brief Writes the velocity quantized within NET_MAX_VELOCITY.
+ */
+void Net_WriteQuantizedVelocity(mem_buf_t *msg, const vec3_t vel) {
+	Net_WriteQuantized(msg, vel, net_velocity_mins, net_velocity_maxs, NET_VELOCITY_PRECISION);
 }
 
 /**
@@ -231,10 +361,10 @@ void Net_WriteDeltaPlayerState(mem_buf_t *msg, const player_state_t *from, const
 		Net_WriteByte(msg, to->pm_state.type);
 
 	if (bits & PS_PM_ORIGIN)
-		Net_WritePosition(msg, to->pm_state.origin);
+		Net_WriteQuantizedPosition(msg, to->pm_state.origin);
 
 	if (bits & PS_PM_VELOCITY)
-		Net_WritePosition(msg, to->pm_state.velocity);
+		Net_WriteQuantizedVelocity(msg, to->pm_state.velocity);
 
 	if (bits & PS_PM_FLAGS)
 		Net_WriteShort(msg, to->pm_state.flags);
@@ -349,10 +479,10 @@ void Net_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from, const enti
 	Net_WriteShort(msg, bits);
 
 	if (bits & U_ORIGIN)
-		Net_WritePosition(msg, to->origin);
+		Net_WriteQuantizedPosition(msg, to->origin);
 
 	if (bits & U_TERMINATION)
-		Net_WritePosition(msg, to->termination);
+		Net_WriteQuantizedPosition(msg, to->termination);
 
 	if (bits & U_ANGLES)
 		Net_WriteAngles(msg, to->angles);
@@ -396,6 +526,31 @@ void Net_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from, const enti
  */
 void Net_BeginReading(mem_buf_t *msg) {
 	msg->read = 0;
+	msg->read_bits = 0;
+}
+
+/**
+ * @brief Reads the specified number of bits, written by Net_WriteBits.
+ */
+uint32_t Net_ReadBits(mem_buf_t *msg, int32_t bits) {
+	uint32_t value = 0;
+
+	for (int32_t shift = 0; shift < bits;) {
+
+		if (msg->read_bits == 0) {
+			msg->read++;
+		}
+
+		const uint32_t c = msg->read > msg->size ? 0 : msg->data[msg->read - 1];
+		const int32_t n = MIN(8 - msg->read_bits, bits - shift);
+
+		value |= ((c >> msg->read_bits) & ((1 << n) - 1)) << shift;
+		msg->read_bits = (msg->read_bits + n) & 7;
+
+		shift += n;
+	}
+
+	return value;
 }
 
 /**
@@ -421,6 +576,8 @@ int32_t Net_ReadChar(mem_buf_t *msg) {
 		c = (signed char) msg->data[msg->read];
 	msg->read++;
 
+	msg->read_bits = 0;
+
 	return c;
 }
 
@@ -436,6 +593,8 @@ int32_t Net_ReadByte(mem_buf_t *msg) {
 		c = (byte) msg->data[msg->read];
 	msg->read++;
 
+	msg->read_bits = 0;
+
 	return c;
 }
 
@@ -452,6 +611,8 @@ int32_t Net_ReadShort(mem_buf_t *msg) {
 
 	msg->read += 2;
 
+	msg->read_bits = 0;
+
 	return c;
 }
 
@@ -469,6 +630,8 @@ int32_t Net_ReadLong(mem_buf_t *msg) {
 
 	msg->read += 4;
 
+	msg->read_bits = 0;
+
 	return c;
 }
 
@@ -550,17 +713,62 @@ void Net_ReadAngles(mem_buf_t *msg, vec3_t angles) {
 }
 
 /**
- * @brief
+ * @brief Reads an octahedral encoded direction, written by Net_WriteDir.
  */
 void Net_ReadDir(mem_buf_t *msg, vec3_t dir) {
 
-	const int32_t b = Net_ReadByte(msg);
+	const vec_t max = (1 << NET_DIR_BITS) - 2; // an even range, so that 0 is exact
+
+	vec_t x = Net_ReadBits(msg, NET_DIR_BITS) / max * 2.0 - 1.0;
+	vec_t y = Net_ReadBits(msg, NET_DIR_BITS) / max * 2.0 - 1.0;
+
+	dir[2] = 1.0 - fabsf(x) - fabsf(y);
+
+	if (dir[2] < 0.0) {
+		const vec_t ox = x;
+		x = (1.0 - fabsf(y)) * (ox >= 0.0 ? 1.0 : -1.0);
+		y = (1.0 - fabsf(ox)) * (y >= 0.0 ? 1.0 : -1.0);
+	}
+
+	dir[0] = x;
+	dir[1] = y;
 
-	if (b >= NUM_APPROXIMATE_NORMALS) {
-		Com_Error(ERR_DROP, "%d out of range\n", b);
+	VectorNormalize(dir);
+}
+
+/**
+ * @brief Reads a vector written by Net_WriteQuantized.
+ */
+static void Net_ReadQuantized(mem_buf_t *msg, vec3_t v, const vec3_t mins, const vec3_t maxs,
+		const int32_t precision) {
+
+	const _Bool inside = Net_ReadBits(msg, 1);
+
+	for (int32_t i = 0; i < 3; i++) {
+		if (inside) {
+			const int32_t bits = Net_QuantizedBits(maxs[i] - mins[i], precision);
+			v[i] = mins[i] + Net_ReadBits(msg, bits) / (vec_t) (1 << precision);
+		} else {
+			const net_vec_t vec = {
+				.i = Net_ReadBits(msg, 32)
+			};
+			v[i] = vec.v;
+		}
 	}
+}
 
-	VectorCopy(approximate_normals[b], dir);
+/**
+ * @brief Reads a position quantized within the bounds of the current map.
+ */
+void Net_ReadQuantizedPosition(mem_buf_t *msg, vec3_t pos) {
+	Net_ReadQuantized(msg, pos, net_bounds.mins, net_bounds.maxs, NET_POSITION_PRECISION);
+}
+
+/**
+ * @brief Reads a velocity quantized within NET_MAX_VELOCITY.
+ */
+void Net_ReadQuantizedVelocity(mem_buf_t *msg, vec3_t vel) {
+	Net_ReadQuantized(msg, vel, net_velocity_mins, net_velocity_maxs, NET_VELOCITY_PRECISION);
 }
 
 /**
@@ -605,10 +813,10 @@ void Net_ReadDeltaPlayerState(mem_buf_t *msg, const player_state_t *from, player
 		to->pm_state.type = Net_ReadByte(msg);
 
 	if (bits & PS_PM_ORIGIN)
-		Net_ReadPosition(msg, to->pm_state.origin);
+		Net_ReadQuantizedPosition(msg, to->pm_state.origin);
 
 	if (bits & PS_PM_VELOCITY)
-		Net_ReadPosition(msg, to->pm_state.velocity);
+		Net_ReadQuantizedVelocity(msg, to->pm_state.velocity);
 
 	if (bits & PS_PM_FLAGS)
 		to->pm_state.flags = Net_ReadShort(msg);
@@ -662,10 +870,10 @@ void Net_ReadDeltaEntity(mem_buf_t *msg, const entity_state_t *from, entity_stat
 	to->number = number;
 
 	if (bits & U_ORIGIN)
-		Net_ReadPosition(msg, to->origin);
+		Net_ReadQuantizedPosition(msg, to->origin);
 
 	if (bits & U_TERMINATION)
-		Net_ReadPosition(msg, to->termination);
+		Net_ReadQuantizedPosition(msg, to->termination);
 
 	if (bits & U_ANGLES)
 		Net_ReadAngles(msg, to->angles);
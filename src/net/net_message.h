@@ -74,9 +74,32 @@
 #define S_ORIGIN				0x2
 #define S_ENTITY				0x4
 
+/**
+ * @brief Positions in entity and player state deltas are quantized to this
+ * many fractional bits, within the bounds of the current map. The resolution
+ * is finer than the collision epsilon, so that a quantized origin never rests
+ * within a surface it was resting on.
+ */
+#define NET_POSITION_PRECISION	6
+
+/**
+ * @brief Velocities are quantized to this many fractional bits, within
+ * NET_MAX_VELOCITY on each axis.
+ */
+#define NET_VELOCITY_PRECISION	3
+#define NET_MAX_VELOCITY		4096.0
+
+/**
+ * @brief Each axis of an octahedral direction is encoded in this many bits.
+ */
+#define NET_DIR_BITS			8
+
 /**
  * @brief Message writing and reading facilities.
  */
+void Net_SetBounds(const vec3_t mins, const vec3_t maxs);
+void Net_GetBounds(vec3_t mins, vec3_t maxs);
+void Net_WriteBits(mem_buf_t *msg, uint32_t value, int32_t bits);
 void Net_WriteData(mem_buf_t *msg, const void *data, size_t len);
 void Net_WriteChar(mem_buf_t *msg, const int32_t c);
 void Net_WriteByte(mem_buf_t *msg, const int32_t c);
@@ -88,11 +111,14 @@ void Net_WritePosition(mem_buf_t *msg, const vec3_t pos);
 void Net_WriteAngle(mem_buf_t *msg, const vec_t f);
 void Net_WriteAngles(mem_buf_t *msg, const vec3_t angles);
 void Net_WriteDir(mem_buf_t *msg, const vec3_t dir);
+void Net_WriteQuantizedPosition(mem_buf_t *msg, const vec3_t pos);
+void Net_WriteQuantizedVelocity(mem_buf_t *msg, const vec3_t vel);
 void Net_WriteDeltaMoveCmd(mem_buf_t *msg, const pm_cmd_t *from, const pm_cmd_t *to);
 void Net_WriteDeltaPlayerState(mem_buf_t *msg, const player_state_t *from, const player_state_t *to);
 void Net_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from, const entity_state_t *to, _Bool force);
 
 void Net_BeginReading(mem_buf_t *msg);
+uint32_t Net_ReadBits(mem_buf_t *msg, int32_t bits);
 void Net_ReadData(mem_buf_t *msg, void *data, size_t len);
 int32_t Net_ReadChar(mem_buf_t *msg);
 int32_t Net_ReadByte(mem_buf_t *msg);
@@ -105,6 +131,8 @@ void Net_ReadPosition(mem_buf_t *msg, vec3_t pos);
 vec_t Net_ReadAngle(mem_buf_t *msg);
 void Net_ReadAngles(mem_buf_t *msg, vec3_t angles);
 void Net_ReadDir(mem_buf_t *msg, vec3_t vector);
+void Net_ReadQuantizedPosition(mem_buf_t *msg, vec3_t pos);
+void Net_ReadQuantizedVelocity(mem_buf_t *msg, vec3_t vel);
 void Net_ReadDeltaMoveCmd(mem_buf_t *msg, const pm_cmd_t *from, pm_cmd_t *to);
 void Net_ReadDeltaPlayerState(mem_buf_t *msg, const player_state_t *from, player_state_t *to);
 void Net_ReadDeltaEntity(mem_buf_t *msg, const entity_state_t *from, entity_state_t *to,
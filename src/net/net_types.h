@@ -73,6 +73,42 @@ typedef enum {
 	NS_UDP_SERVER
 } net_src_t;
 
+/**
+ * @brief Reliable messages are divided into fragments of at most this size.
+ */
+#define NETCHAN_FRAGMENT_SIZE 1024
+
+/**
+ * @brief Datagrams carrying reliable fragments are limited to this size, so
+ * that they are not fragmented again by IP: losing one IP fragment would lose
+ * every reliable fragment in the datagram.
+ */
+#define NETCHAN_MTU 1400
+
+/**
+ * @brief The number of fragments that may be outstanding, awaiting selective
+ * acknowledgement, at once. This is also the receiver's reassembly window.
+ */
+#define NETCHAN_WINDOW 32
+
+/**
+ * @brief The number of fragments that may be queued for sending.
+ */
+#define NETCHAN_QUEUE 64
+
+/**
+ * @brief A fragment of a reliable message.
+ */
+typedef struct {
+	uint32_t id; // the fragment's position in the reliable stream
+	_Bool last; // the final fragment of a reliable message
+	_Bool acknowledged; // or received, for the receiver
+	uint32_t sent_sequence; // the outgoing sequence it was last sent in, or 0
+	uint32_t sent_time;
+	uint16_t len;
+	byte data[NETCHAN_FRAGMENT_SIZE];
+} net_chan_fragment_t;
+
 /**
  * @brief The network channel provides a conduit for packet sequencing and
  * optional reliable message delivery. The client and server speak explicitly
@@ -90,23 +126,26 @@ typedef struct {
 
 	uint8_t qport; // to differentiate multiple clients behind NAT
 
+	_Bool compress; // negotiated Huffman compression of server to client packets
+
 	// sequencing variables
 	uint32_t incoming_sequence;
 	uint32_t incoming_acknowledged;
 	uint32_t outgoing_sequence;
 
-	uint32_t reliable_sequence; // single bit
-	uint32_t reliable_acknowledged; // single bit
-	uint32_t reliable_incoming; // single bit
-	uint32_t reliable_outgoing; // outgoing sequence number of last reliable
-
-	// reliable staging and holding areas
+	// reliable staging area
 	mem_buf_t message; // writing buffer to send to server
 	byte message_buffer[MAX_MSG_SIZE - 16]; // leave space for header
 
-	// message is copied to this buffer when it is first transfered
-	size_t reliable_size;
-	byte reliable_buffer[MAX_MSG_SIZE - 16]; // un-acked reliable message
+	// the message is fragmented into this ring of NETCHAN_QUEUE when it is first transfered
+	net_chan_fragment_t *reliable_queue;
+	uint32_t reliable_head; // the id of the oldest unacknowledged fragment
+	uint32_t reliable_tail; // the id of the next fragment to queue
+
+	// received fragments are reassembled in this ring of NETCHAN_WINDOW
+	net_chan_fragment_t *reliable_window;
+	uint32_t reliable_base; // the id of the next fragment to deliver
+	uint32_t reliable_ack_packets; // packets which must yet carry our acknowledgement
 } net_chan_t;
 
 #endif /* __NET_TYPES_H__ */
@@ -19,16 +19,48 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+#include "config.h" // for _GNU_SOURCE, before any system header
+
 #include <sys/time.h>
 
+#if !defined(_WIN32)
+ #include <fcntl.h>
+ #include <sys/socket.h>
+ #include <unistd.h>
+#endif
+
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
+
 #include "cvar.h"
 #include "net_udp.h"
 
-#define MAX_NET_UDP_LOOPS 4
+/**
+ * @brief Loopback datagrams are queued in a ring of this many, which must
+ * accommodate the datagrams of several Netchan_Transmit calls.
+ */
+#define MAX_NET_UDP_LOOPS 64
+
+/**
+ * @brief On Linux, datagrams are received, and optionally sent, in batches of
+ * up to this many per system call.
+ */
+#if defined(__linux__)
+ #define NET_UDP_MMSG 1
+ #define NET_UDP_BATCH 32
+#endif
+
+/**
+ * @brief Where select accepts pipes, network threads are woken through one
+ * to send their queued datagrams. Elsewhere, they poll every wait.
+ */
+#if !defined(_WIN32)
+ #define NET_UDP_WAKE 1
+#endif
 
 typedef struct {
-	byte data[MAX_MSG_SIZE];
-	size_t size;
+	byte *data; // grown to the largest datagram queued in this slot
+	size_t size, max_size;
 } net_udp_loop_message_t;
 
 typedef struct {
@@ -36,9 +68,82 @@ typedef struct {
 	int32_t send, recv;
 } net_udp_loop_t;
 
+#if defined(NET_UDP_MMSG)
+
+/**
+ * @brief A batch of datagrams for recvmmsg or sendmmsg. Received datagrams are
+ * consumed from `index` to `count`; datagrams to send are appended at `count`.
+ * The datagram buffers are allocated only while the socket is open.
+ */
+typedef struct {
+	byte (*data)[MAX_MSG_SIZE];
+	struct sockaddr_in addrs[NET_UDP_BATCH];
+	struct iovec iovecs[NET_UDP_BATCH];
+	struct mmsghdr headers[NET_UDP_BATCH];
+	int32_t index, count;
+} net_udp_batch_t;
+
+#endif
+
+/**
+ * @brief The number of datagrams each network thread queue may hold.
+ */
+#define NET_UDP_QUEUE 128
+
+/**
+ * @brief How long the network thread waits for the socket to become readable,
+ * or to be woken for datagrams to send, in microseconds. Threads which can not
+ * be woken must service their send queue promptly.
+ */
+#if defined(NET_UDP_WAKE)
+ #define NET_UDP_THREAD_WAIT 10000
+#else
+ #define NET_UDP_THREAD_WAIT 500
+#endif
+
+/**
+ * @brief A datagram passed between a network thread and the main thread.
+ */
+typedef struct {
+	net_addr_t addr; // the sender or recipient
+	uint64_t time; // the arrival time, in microseconds
+	size_t size;
+	byte data[MAX_MSG_SIZE];
+} net_udp_packet_t;
+
+/**
+ * @brief A single-producer, single-consumer ring of datagrams. Only the
+ * producer advances `write`, and only the consumer advances `read`.
+ */
+typedef struct {
+	net_udp_packet_t *packets;
+	uint32_t write, read;
+} net_udp_queue_t;
+
+/**
+ * @brief A network thread, which owns a socket's I/O while it runs. It drains
+ * received datagrams into `recv` and transmits those queued in `send`.
+ */
+typedef struct {
+	SDL_Thread *thread;
+	SDL_sem *received; // posted when datagrams are queued in `recv`
+#if defined(NET_UDP_WAKE)
+	int32_t wake[2]; // a pipe, written to wake the thread to transmit `send`
+#endif
+	_Bool running;
+	_Bool batching; // see Net_BeginDatagrams
+	net_udp_queue_t recv, send;
+} net_udp_thread_t;
+
 typedef struct {
 	net_udp_loop_t loops[2];
 	int32_t sockets[2];
+	net_udp_thread_t threads[2];
+	uint64_t receive_time[2]; // see Net_ReceiveTime
+#if defined(NET_UDP_MMSG)
+	net_udp_batch_t recv[2], send[2];
+	_Bool batch_send[2]; // see Net_BeginDatagrams
+#endif
 } net_udp_state_t;
 
 static net_udp_state_t net_udp_state;
@@ -68,19 +173,115 @@ static _Bool Net_ReceiveDatagram_Loop(net_src_t source, net_addr_t *from, mem_bu
 	return true;
 }
 
+#if defined(NET_UDP_MMSG)
+
 /**
- * @brief Receive a datagram on the specified socket, populating the from
- * address with the sender.
+ * @brief Prepares the message header at the given index of the batch to
+ * address the corresponding buffer.
  */
-_Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
+static void Net_PrepareBatch(net_udp_batch_t *batch, int32_t i, size_t len) {
 
-	buf->read = buf->size = 0;
+	struct mmsghdr *header = &batch->headers[i];
 
-	memset(from, 0, sizeof(*from));
-	from->type = NA_DATAGRAM;
+	memset(header, 0, sizeof(*header));
 
-	if (Net_ReceiveDatagram_Loop(source, from, buf))
-		return true;
+	batch->iovecs[i].iov_base = batch->data[i];
+	batch->iovecs[i].iov_len = len;
+
+	header->msg_hdr.msg_name = &batch->addrs[i];
+	header->msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+	header->msg_hdr.msg_iov = &batch->iovecs[i];
+	header->msg_hdr.msg_iovlen = 1;
+}
+
+/**
+ * @brief Receives the next datagram on the socket from the source's batch,
+ * refilling the batch with a single recvmmsg when it is exhausted.
+ *
+ * @return The size of the datagram, or -1 on error, as recvfrom would.
+ */
+static ssize_t Net_ReceiveDatagram_Batch(net_src_t source, int32_t sock, struct sockaddr_in *addr,
+		mem_buf_t *buf) {
+
+	net_udp_batch_t *batch = &net_udp_state.recv[source];
+
+	if (batch->index == batch->count) {
+
+		for (int32_t i = 0; i < NET_UDP_BATCH; i++) {
+			Net_PrepareBatch(batch, i, MAX_MSG_SIZE);
+		}
+
+		batch->index = batch->count = 0;
+
+		const int32_t count = recvmmsg(sock, batch->headers, NET_UDP_BATCH, 0, NULL);
+		if (count == -1)
+			return -1;
+
+		batch->count = count;
+
+		if (count == 0) {
+			errno = EWOULDBLOCK;
+			return -1;
+		}
+	}
+
+	const int32_t i = batch->index++;
+	const struct mmsghdr *header = &batch->headers[i];
+
+	*addr = batch->addrs[i];
+
+	// report truncated datagrams as filling the buffer, so that they are rejected
+	size_t len = header->msg_len;
+	if ((header->msg_hdr.msg_flags & MSG_TRUNC) || len > buf->max_size) {
+		len = buf->max_size;
+	}
+
+	memcpy(buf->data, batch->data[i], len);
+	return len;
+}
+
+/**
+ * @brief Sends the datagrams pending in the source's batch with sendmmsg.
+ */
+static void Net_SendDatagrams_Batch(net_src_t source) {
+
+	net_udp_batch_t *batch = &net_udp_state.send[source];
+	const int32_t sock = net_udp_state.sockets[source];
+
+	int32_t i = 0;
+	while (sock && i < batch->count) {
+
+		const int32_t sent = sendmmsg(sock, batch->headers + i, batch->count - i, 0);
+		if (sent == -1) {
+			net_addr_t to = {
+				.type = NA_DATAGRAM,
+				.addr = batch->addrs[i].sin_addr.s_addr,
+				.port = batch->addrs[i].sin_port
+			};
+
+			Com_Warn("%s to %s\n", Net_GetErrorString(), Net_NetaddrToString(&to));
+			i++; // skip the offending datagram
+		} else {
+			i += sent;
+		}
+	}
+
+	batch->count = 0;
+}
+
+#endif
+
+/**
+ * @return The current time, in microseconds.
+ */
+static uint64_t Net_Microseconds(void) {
+	return SDL_GetPerformanceCounter() * 1000000.0 / SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Receive a datagram from the specified socket itself.
+ */
+static _Bool Net_ReceiveDatagram_Socket(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
 
 	const int32_t sock = net_udp_state.sockets[source];
 
@@ -88,10 +289,15 @@ _Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
 		return false;
 
 	struct sockaddr_in addr;
+
+#if defined(NET_UDP_MMSG)
+	const ssize_t received = Net_ReceiveDatagram_Batch(source, sock, &addr, buf);
+#else
 	socklen_t addr_len = sizeof(addr);
 
 	const ssize_t received = recvfrom(sock, (void *) buf->data, buf->max_size, 0,
 			(struct sockaddr *) &addr, &addr_len);
+#endif
 
 	from->addr = addr.sin_addr.s_addr;
 	from->port = addr.sin_port;
@@ -119,23 +325,199 @@ _Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
 	return true;
 }
 
+/**
+ * @return The next free packet of the queue, or NULL if it is full.
+ */
+static net_udp_packet_t *Net_QueueWrite(net_udp_queue_t *queue) {
+
+	const uint32_t read = __atomic_load_n(&queue->read, __ATOMIC_ACQUIRE);
+
+	if (queue->write - read == NET_UDP_QUEUE)
+		return NULL;
+
+	return &queue->packets[queue->write & (NET_UDP_QUEUE - 1)];
+}
+
+/**
+ * @brief Publishes the packet returned by Net_QueueWrite to the consumer.
+ */
+static void Net_QueuePush(net_udp_queue_t *queue) {
+	__atomic_store_n(&queue->write, queue->write + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @return The next packet of the queue, or NULL if it is empty.
+ */
+static const net_udp_packet_t *Net_QueueRead(net_udp_queue_t *queue) {
+
+	const uint32_t write = __atomic_load_n(&queue->write, __ATOMIC_ACQUIRE);
+
+	if (queue->read == write)
+		return NULL;
+
+	return &queue->packets[queue->read & (NET_UDP_QUEUE - 1)];
+}
+
+/**
+ * @brief Releases the packet returned by Net_QueueRead to the producer.
+ */
+static void Net_QueuePop(net_udp_queue_t *queue) {
+	__atomic_store_n(&queue->read, queue->read + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @return The number of packets in the queue, as seen by the producer.
+ */
+static uint32_t Net_QueueCount(net_udp_queue_t *queue) {
+	return queue->write - __atomic_load_n(&queue->read, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Wakes the network thread from Net_WaitSocket to transmit its send
+ * queue. A full pipe already holds a pending wake, so that is not an error.
+ */
+static void Net_WakeThread(net_udp_thread_t *thread) {
+#if defined(NET_UDP_WAKE)
+	const byte b = 0;
+
+	if (write(thread->wake[1], &b, sizeof(b)) == -1 && errno != EAGAIN) {
+		Com_Debug("%s\n", strerror(errno));
+	}
+#endif
+}
+
+/**
+ * @brief Receive a datagram on the specified socket, populating the from
+ * address with the sender. If the socket has a network thread, the datagram is
+ * taken from its queue.
+ */
+_Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf) {
+
+	buf->read = buf->size = 0;
+
+	memset(from, 0, sizeof(*from));
+	from->type = NA_DATAGRAM;
+
+	net_udp_state.receive_time[source] = Net_Microseconds();
+
+	if (Net_ReceiveDatagram_Loop(source, from, buf))
+		return true;
+
+	net_udp_thread_t *thread = &net_udp_state.threads[source];
+
+	if (thread->thread) {
+		const net_udp_packet_t *packet = Net_QueueRead(&thread->recv);
+		if (!packet)
+			return false;
+
+		*from = packet->addr;
+
+		if (packet->size > buf->max_size) {
+			Com_Warn("Oversized packet from %s\n", Net_NetaddrToString(from));
+			Net_QueuePop(&thread->recv);
+			return false;
+		}
+
+		memcpy(buf->data, packet->data, packet->size);
+		buf->size = packet->size;
+
+		net_udp_state.receive_time[source] = packet->time;
+
+		Net_QueuePop(&thread->recv);
+		return true;
+	}
+
+	return Net_ReceiveDatagram_Socket(source, from, buf);
+}
+
+/**
+ * @return The time, in microseconds, at which the datagram most recently
+ * returned by Net_ReceiveDatagram arrived. Without a network thread, this is
+ * the time at which it was read.
+ */
+uint64_t Net_ReceiveTime(net_src_t source) {
+	return net_udp_state.receive_time[source];
+}
+
 /**
  * @brief
  */
 static _Bool Net_SendDatagram_Loop(net_src_t source, const void *data, size_t len) {
 	net_udp_loop_t *loop = &net_udp_state.loops[source ^ 1];
 
-	const uint32_t i = loop->send & (MAX_NET_UDP_LOOPS - 1);
+	net_udp_loop_message_t *message = &loop->messages[loop->send & (MAX_NET_UDP_LOOPS - 1)];
 	loop->send++;
 
-	memcpy(loop->messages[i].data, data, len);
-	loop->messages[i].size = len;
+	if (len > message->max_size) {
+		if (message->data) {
+			Mem_Free(message->data);
+		}
+
+		message->max_size = MAX(len, (size_t) NETCHAN_MTU);
+		message->data = Mem_Malloc(message->max_size);
+	}
+
+	message->size = len;
+
+	memcpy(message->data, data, len);
+
+	return true;
+}
+
+/**
+ * @brief Sends a single datagram with the specified socket, bypassing any batch.
+ */
+static _Bool Net_SendTo(int32_t sock, const net_addr_t *to, const void *data, size_t len) {
+
+	struct sockaddr_in to_addr;
+	Net_NetAddrToSockaddr(to, &to_addr);
+
+	ssize_t sent = sendto(sock, data, len, 0, (const struct sockaddr *) &to_addr, sizeof(to_addr));
+
+	if (sent == -1) {
+		Com_Warn("%s to %s\n", Net_GetErrorString(), Net_NetaddrToString(to));
+		return false;
+	}
 
 	return true;
 }
 
 /**
- * @brief Send a datagram to the specified address.
+ * @brief Send a datagram to the specified address with the socket itself.
+ */
+static _Bool Net_SendDatagram_Socket(net_src_t source, const net_addr_t *to, const void *data,
+		size_t len) {
+
+	const int32_t sock = net_udp_state.sockets[source];
+	if (!sock)
+		return false;
+
+#if defined(NET_UDP_MMSG)
+	if (net_udp_state.batch_send[source]) {
+		net_udp_batch_t *batch = &net_udp_state.send[source];
+
+		if (batch->count == NET_UDP_BATCH) {
+			Net_SendDatagrams_Batch(source);
+		}
+
+		const int32_t i = batch->count++;
+
+		Net_PrepareBatch(batch, i, len);
+
+		memcpy(batch->data[i], data, len);
+		Net_NetAddrToSockaddr(to, &batch->addrs[i]);
+
+		return true;
+	}
+#endif
+
+	return Net_SendTo(sock, to, data, len);
+}
+
+/**
+ * @brief Send a datagram to the specified address. If the socket has a network
+ * thread, the datagram is queued for it to send. Should the thread fall behind
+ * and its queue fill, the datagram is sent directly rather than waiting on it.
  */
 _Bool Net_SendDatagram(net_src_t source, const net_addr_t *to, const void *data, size_t len) {
 
@@ -143,25 +525,242 @@ _Bool Net_SendDatagram(net_src_t source, const net_addr_t *to, const void *data,
 		return Net_SendDatagram_Loop(source, data, len);
 	}
 
-	int32_t sock;
-	if (to->type == NA_BROADCAST || to->type == NA_DATAGRAM) {
-		if (!(sock = net_udp_state.sockets[source]))
-			return false;
-	} else {
+	if (to->type != NA_BROADCAST && to->type != NA_DATAGRAM) {
 		Com_Error(ERR_DROP, "Bad address type\n");
 	}
 
-	struct sockaddr_in to_addr;
-	Net_NetAddrToSockaddr(to, &to_addr);
+	net_udp_thread_t *thread = &net_udp_state.threads[source];
 
-	ssize_t sent = sendto(sock, data, len, 0, (const struct sockaddr *) &to_addr, sizeof(to_addr));
+	if (thread->thread) {
+		net_udp_packet_t *packet = Net_QueueWrite(&thread->send);
 
-	if (sent == -1) {
-		Com_Warn("%s to %s\n", Net_GetErrorString(), Net_NetaddrToString(to));
-		return false;
+		if (packet == NULL) {
+			Net_WakeThread(thread);
+			return Net_SendTo(net_udp_state.sockets[source], to, data, len);
+		}
+
+		packet->addr = *to;
+		packet->size = len;
+		memcpy(packet->data, data, len);
+
+		Net_QueuePush(&thread->send);
+
+		// while batching, wake the thread only once the queue is half full
+		if (!thread->batching || Net_QueueCount(&thread->send) >= NET_UDP_QUEUE / 2) {
+			Net_WakeThread(thread);
+		}
+
+		return true;
 	}
 
-	return true;
+	return Net_SendDatagram_Socket(source, to, data, len);
+}
+
+/**
+ * @brief Begins batching the datagrams sent on the specified socket, so that
+ * they may be sent together by Net_FlushDatagrams. Without a network thread,
+ * this is only effective where sendmmsg is available.
+ */
+void Net_BeginDatagrams(net_src_t source) {
+
+	net_udp_thread_t *thread = &net_udp_state.threads[source];
+
+	if (thread->thread) {
+		thread->batching = true;
+		return;
+	}
+
+#if defined(NET_UDP_MMSG)
+	net_udp_state.batch_send[source] = true;
+#endif
+}
+
+/**
+ * @brief Sends any datagrams batched since Net_BeginDatagrams, and ends
+ * batching.
+ */
+void Net_FlushDatagrams(net_src_t source) {
+
+	net_udp_thread_t *thread = &net_udp_state.threads[source];
+
+	if (thread->thread) {
+		thread->batching = false;
+		Net_WakeThread(thread);
+		return;
+	}
+
+#if defined(NET_UDP_MMSG)
+	Net_SendDatagrams_Batch(source);
+	net_udp_state.batch_send[source] = false;
+#endif
+}
+
+/**
+ * @brief Waits up to the specified number of microseconds for the socket to
+ * become readable, or for the thread to be woken by Net_WakeThread.
+ */
+static void Net_WaitSocket(net_udp_thread_t *thread, int32_t sock, uint32_t usec) {
+	struct timeval timeout;
+	fd_set fdset;
+
+	FD_ZERO(&fdset);
+	FD_SET(sock, &fdset);
+
+	timeout.tv_sec = usec / 1000000;
+	timeout.tv_usec = usec % 1000000;
+
+#if defined(NET_UDP_WAKE)
+	FD_SET(thread->wake[0], &fdset);
+
+	select(MAX(sock, thread->wake[0]) + 1, &fdset, NULL, NULL, &timeout);
+
+	if (FD_ISSET(thread->wake[0], &fdset)) {
+		byte b[64];
+		while (read(thread->wake[0], b, sizeof(b)) > 0) ;
+	}
+#else
+	select(sock + 1, &fdset, NULL, NULL, &timeout);
+#endif
+}
+
+/**
+ * @brief The network thread. It continuously drains the socket into the
+ * receive queue, timestamping each datagram, and transmits the send queue.
+ */
+static int32_t Net_Thread(void *data) {
+
+	const net_src_t source = (net_src_t) (intptr_t) data;
+	net_udp_thread_t *thread = &net_udp_state.threads[source];
+
+	while (__atomic_load_n(&thread->running, __ATOMIC_ACQUIRE)) {
+		net_udp_packet_t *packet;
+		_Bool received = false;
+
+		while ((packet = Net_QueueWrite(&thread->recv))) {
+			mem_buf_t buf;
+
+			Mem_InitBuffer(&buf, packet->data, sizeof(packet->data));
+			memset(&packet->addr, 0, sizeof(packet->addr));
+			packet->addr.type = NA_DATAGRAM;
+
+			if (!Net_ReceiveDatagram_Socket(source, &packet->addr, &buf))
+				break;
+
+			packet->time = Net_Microseconds();
+			packet->size = buf.size;
+
+			Net_QueuePush(&thread->recv);
+			received = true;
+		}
+
+		if (received) {
+			SDL_SemPost(thread->received);
+		}
+
+		const net_udp_packet_t *out;
+
+#if defined(NET_UDP_MMSG)
+		net_udp_state.batch_send[source] = true;
+#endif
+
+		while ((out = Net_QueueRead(&thread->send))) {
+			Net_SendDatagram_Socket(source, &out->addr, out->data, out->size);
+			Net_QueuePop(&thread->send);
+		}
+
+#if defined(NET_UDP_MMSG)
+		Net_SendDatagrams_Batch(source);
+		net_udp_state.batch_send[source] = false;
+#endif
+
+		Net_WaitSocket(thread, net_udp_state.sockets[source], NET_UDP_THREAD_WAIT);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Starts a network thread for the specified socket, which must be up.
+ * The thread receives and sends all of the socket's datagrams until stopped,
+ * so that datagrams are read as they arrive, rather than once per frame.
+ */
+void Net_StartThread(net_src_t source) {
+
+	net_udp_thread_t *thread = &net_udp_state.threads[source];
+
+	if (thread->thread || !net_udp_state.sockets[source])
+		return;
+
+#if defined(NET_UDP_WAKE)
+	if (pipe(thread->wake) == -1) {
+		Com_Warn("Failed to create network thread pipe: %s\n", strerror(errno));
+		return;
+	}
+
+	for (size_t i = 0; i < lengthof(thread->wake); i++) {
+		fcntl(thread->wake[i], F_SETFL, fcntl(thread->wake[i], F_GETFL) | O_NONBLOCK);
+	}
+#endif
+
+	thread->recv.packets = Mem_Malloc(NET_UDP_QUEUE * sizeof(net_udp_packet_t));
+	thread->send.packets = Mem_Malloc(NET_UDP_QUEUE * sizeof(net_udp_packet_t));
+
+	thread->recv.read = thread->recv.write = 0;
+	thread->send.read = thread->send.write = 0;
+
+	thread->received = SDL_CreateSemaphore(0);
+	thread->running = true;
+
+	thread->thread = SDL_CreateThread(Net_Thread, __func__, (void *) (intptr_t) source);
+	if (!thread->thread) {
+		Com_Warn("Failed to create network thread: %s\n", SDL_GetError());
+		thread->running = false;
+
+		SDL_DestroySemaphore(thread->received);
+		Mem_Free(thread->recv.packets);
+		Mem_Free(thread->send.packets);
+
+#if defined(NET_UDP_WAKE)
+		close(thread->wake[0]);
+		close(thread->wake[1]);
+#endif
+
+		memset(thread, 0, sizeof(*thread));
+	}
+}
+
+/**
+ * @brief Stops the network thread of the specified socket, if any. Datagrams
+ * still queued for sending are sent first.
+ */
+void Net_StopThread(net_src_t source) {
+
+	net_udp_thread_t *thread = &net_udp_state.threads[source];
+
+	if (!thread->thread)
+		return;
+
+	Net_WakeThread(thread);
+
+	while (Net_QueueRead(&thread->send)) {
+		SDL_Delay(1);
+	}
+
+	__atomic_store_n(&thread->running, false, __ATOMIC_RELEASE);
+	Net_WakeThread(thread);
+
+	SDL_WaitThread(thread->thread, NULL);
+
+	SDL_DestroySemaphore(thread->received);
+	Mem_Free(thread->recv.packets);
+	Mem_Free(thread->send.packets);
+
+#if defined(NET_UDP_WAKE)
+	close(thread->wake[0]);
+	close(thread->wake[1]);
+#endif
+
+	memset(thread, 0, sizeof(*thread));
 }
 
 /**
@@ -176,6 +775,13 @@ void Net_Sleep(uint32_t msec) {
 	if (!sock || !dedicated->value)
 		return; // we're not a server, simply return
 
+	net_udp_thread_t *thread = &net_udp_state.threads[NS_UDP_SERVER];
+
+	if (thread->thread) { // wait to be woken by the network thread
+		SDL_SemWaitTimeout(thread->received, msec);
+		return;
+	}
+
 
 	FD_ZERO(&fdset);
 	FD_SET(sock, &fdset); // server socket
@@ -204,12 +810,32 @@ void Net_Config(net_src_t source, _Bool up) {
 			const in_port_t port = source == NS_UDP_SERVER ? net_port->integer : 0;
 
 			*sock = Net_Socket(NA_DATAGRAM, iface, port);
+
+#if defined(NET_UDP_MMSG)
+			if (*sock) {
+				net_udp_state.recv[source].data = Mem_Malloc(NET_UDP_BATCH * MAX_MSG_SIZE);
+				net_udp_state.send[source].data = Mem_Malloc(NET_UDP_BATCH * MAX_MSG_SIZE);
+			}
+#endif
 		}
 	} else {
+		Net_StopThread(source);
+
 		if (*sock != 0) {
 			Net_CloseSocket(*sock);
 			*sock = 0;
 		}
+#if defined(NET_UDP_MMSG)
+		for (int32_t i = 0; i < 2; i++) {
+			net_udp_batch_t *batch = i ? &net_udp_state.send[source] : &net_udp_state.recv[source];
+
+			if (batch->data) {
+				Mem_Free(batch->data);
+			}
+
+			memset(batch, 0, sizeof(*batch));
+		}
+#endif
 	}
 }
 
@@ -25,9 +25,14 @@
 #include "net.h"
 
 _Bool Net_ReceiveDatagram(net_src_t source, net_addr_t *from, mem_buf_t *buf);
+uint64_t Net_ReceiveTime(net_src_t source);
 _Bool Net_SendDatagram(net_src_t source, const net_addr_t *to, const void *data, size_t len);
+void Net_BeginDatagrams(net_src_t source);
+void Net_FlushDatagrams(net_src_t source);
 
 void Net_Config(net_src_t source, _Bool up);
+void Net_StartThread(net_src_t source);
+void Net_StopThread(net_src_t source);
 void Net_Sleep(uint32_t msec);
 
 #endif /* __NET_UDP_H__ */
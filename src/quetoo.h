@@ -213,6 +213,7 @@ typedef enum {
 	SV_CMD_RECONNECT,
 	SV_CMD_SERVER_DATA, // [long] protocol ...
 	SV_CMD_SOUND,
+	SV_CMD_BUNDLE, // [short] size [size bytes] of the connection bundle
 	SV_CMD_CGAME, // the game may extend from here
 } sv_packet_cmd_t;
 
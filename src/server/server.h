@@ -32,8 +32,10 @@
 #include "sv_admin.h"
 #include "sv_console.h"
 #include "sv_client.h"
+#include "sv_download.h"
 #include "sv_entity.h"
 #include "sv_game.h"
+#include "sv_grid.h"
 #include "sv_init.h"
 #include "sv_main.h"
 #include "sv_master.h"
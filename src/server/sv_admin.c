@@ -182,8 +182,8 @@ static void Sv_Status_f(void) {
 	}
 
 	Com_Print("map: %s\n", sv.name);
-	Com_Print("num ping name            lastmsg address               qport \n");
-	Com_Print("--- ---- --------------- ------- --------------------- ------\n");
+	Com_Print("num ping name            lastmsg address               qport  jitter\n");
+	Com_Print("--- ---- --------------- ------- --------------------- ------ ------\n");
 	for (i = 0, cl = svs.clients; i < sv_max_clients->integer; i++, cl++) {
 
 		if (cl->state == SV_CLIENT_FREE)
@@ -211,10 +211,18 @@ static void Sv_Status_f(void) {
 		for (j = 0; j < l; j++)
 			Com_Print(" ");
 
-		Com_Print("%5i", (int32_t) cl->net_chan.qport);
+		Com_Print("%5i  ", (int32_t) cl->net_chan.qport);
+
+		Com_Print("%6.1f", cl->jitter / 1000.0);
 
 		Com_Print("\n");
 	}
+
+	const uint32_t hits = sv.delta_entity_hits, misses = sv.delta_entity_misses;
+	if (hits + misses) {
+		Com_Print("entity deltas: %u encoded, %u reused (%.1f%%)\n", misses, hits,
+				100.0 * hits / (hits + misses));
+	}
 }
 
 /**
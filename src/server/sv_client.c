@@ -21,6 +21,11 @@
 
 #include "sv_local.h"
 
+/**
+ * @brief The largest piece of the connection bundle written per command.
+ */
+#define BUNDLE_CHUNK_SIZE (MAX_MSG_SIZE / 4)
+
 /**
  * @brief Sends the first message from the server to a connected client.
  * This will be sent on the initial connection and upon each server load.
@@ -54,67 +59,54 @@ static void Sv_New_f(void) {
 	// send full level name
 	Net_WriteString(&sv_client->net_chan.message, sv.config_strings[CS_NAME]);
 
-	// begin fetching config_strings
-	Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CBUF_TEXT);
-	Net_WriteString(&sv_client->net_chan.message, va("config_strings %i 0\n", svs.spawn_count));
+	// and the bounds within which positions are quantized
+	Net_WritePosition(&sv_client->net_chan.message, sv.cm_models[0]->mins);
+	Net_WritePosition(&sv_client->net_chan.message, sv.cm_models[0]->maxs);
+
+	// and the collision structure, so that prediction matches our traces
+	Net_WriteByte(&sv_client->net_chan.message, sv_collision_bvh->integer);
+
+	// and the connection bundle, which the client may already have
+	Net_WriteString(&sv_client->net_chan.message, sv.name);
+	Net_WriteString(&sv_client->net_chan.message, sv.bundle.hash);
+	Net_WriteLong(&sv_client->net_chan.message, (int32_t) sv.bundle.size);
 }
 
 /**
- * @brief
+ * @brief Sends the config strings which are not in the connection bundle, and
+ * then has the client precache.
+ *
+ * @return False if the reliable queue could not accommodate them.
  */
-static void Sv_ConfigStrings_f(void) {
-	uint32_t start;
+static _Bool Sv_SendUnbundled(void) {
 
-	Com_Debug("%s\n", Sv_NetaddrToString(sv_client));
+	for (uint16_t i = 0; i < MAX_CONFIG_STRINGS; i++) {
 
-	if (sv_client->state != SV_CLIENT_CONNECTED) {
-		Com_Warn("%s already spawned\n", Sv_NetaddrToString(sv_client));
-		return;
-	}
-
-	// handle the case of a level changing while a client was connecting
-	if (strtoul(Cmd_Argv(1), NULL, 0) != svs.spawn_count) {
-		Com_Debug("Stale spawn count from %s\n", Sv_NetaddrToString(sv_client));
-		Sv_New_f();
-		return;
-	}
+		if (!sv.bundle.unbundled[i] || !sv.config_strings[i][0])
+			continue;
 
-	start = strtoul(Cmd_Argv(2), NULL, 0);
+		if (sv_client->net_chan.message.size >= MAX_MSG_SIZE / 2) {
+			if (!Netchan_Queue(&sv_client->net_chan))
+				return false;
+		}
 
-	if (start >= MAX_CONFIG_STRINGS) { // catch bad offsets
-		Com_Warn("Bad offset from %s\n", Sv_NetaddrToString(sv_client));
-		Sv_KickClient(sv_client, NULL);
-		return;
+		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CONFIG_STRING);
+		Net_WriteShort(&sv_client->net_chan.message, i);
+		Net_WriteString(&sv_client->net_chan.message, sv.config_strings[i]);
 	}
 
-	// write a packet full of data
-	while (sv_client->net_chan.message.size < MAX_MSG_SIZE / 2 && start < MAX_CONFIG_STRINGS) {
-		if (sv.config_strings[start][0]) {
-			Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CONFIG_STRING);
-			Net_WriteShort(&sv_client->net_chan.message, start);
-			Net_WriteString(&sv_client->net_chan.message, sv.config_strings[start]);
-		}
-		start++;
-	}
+	Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CBUF_TEXT);
+	Net_WriteString(&sv_client->net_chan.message, va("precache %i\n", svs.spawn_count));
 
-	// send next command
-	if (start == MAX_CONFIG_STRINGS) {
-		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CBUF_TEXT);
-		Net_WriteString(&sv_client->net_chan.message, va("baselines %i 0\n", svs.spawn_count));
-	} else {
-		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CBUF_TEXT);
-		Net_WriteString(&sv_client->net_chan.message,
-				va("config_strings %i %i\n", svs.spawn_count, start));
-	}
+	return true;
 }
 
 /**
- * @brief
+ * @brief Sends the connection bundle from the requested offset, writing as much
+ * of it as the reliable queue will take, followed by the config strings that
+ * are not in it. A client with the bundle cached requests it from its end.
  */
-static void Sv_Baselines_f(void) {
-	uint32_t start;
-	entity_state_t null_state;
-	entity_state_t *base;
+static void Sv_Bundle_f(void) {
 
 	Com_Debug("%s\n", Sv_NetaddrToString(sv_client));
 
@@ -123,36 +115,44 @@ static void Sv_Baselines_f(void) {
 		return;
 	}
 
+	const sv_bundle_t *bundle = &sv.bundle;
+
 	// handle the case of a level changing while a client was connecting
-	if (strtoul(Cmd_Argv(1), NULL, 0) != svs.spawn_count) {
-		Com_Debug("Stale spawn count from %s\n", Sv_NetaddrToString(sv_client));
+	if (strtoul(Cmd_Argv(1), NULL, 0) != svs.spawn_count || g_strcmp0(Cmd_Argv(2), bundle->hash)) {
+		Com_Debug("Stale bundle from %s\n", Sv_NetaddrToString(sv_client));
 		Sv_New_f();
 		return;
 	}
 
-	start = strtoul(Cmd_Argv(2), NULL, 0);
+	size_t offset = strtoul(Cmd_Argv(3), NULL, 0);
 
-	memset(&null_state, 0, sizeof(null_state));
+	if (offset > bundle->size) { // catch bad offsets
+		Com_Warn("Bad offset from %s\n", Sv_NetaddrToString(sv_client));
+		Sv_KickClient(sv_client, NULL);
+		return;
+	}
 
-	// write a packet full of data
-	while (sv_client->net_chan.message.size < (MAX_MSG_SIZE >> 1) && start < MAX_ENTITIES) {
-		base = &sv.baselines[start];
-		if (base->model1 || base->sound || base->effects) {
-			Net_WriteByte(&sv_client->net_chan.message, SV_CMD_BASELINE);
-			Net_WriteDeltaEntity(&sv_client->net_chan.message, &null_state, base, true);
+	while (offset < bundle->size) {
+		if (sv_client->net_chan.message.size >= MAX_MSG_SIZE / 2) {
+			if (!Netchan_Queue(&sv_client->net_chan))
+				break;
 		}
-		start++;
-	}
 
-	// send next command
-	if (start == MAX_ENTITIES) {
-		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CBUF_TEXT);
-		Net_WriteString(&sv_client->net_chan.message, va("precache %i\n", svs.spawn_count));
-	} else {
-		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CBUF_TEXT);
-		Net_WriteString(&sv_client->net_chan.message,
-				va("baselines %i %i\n", svs.spawn_count, start));
+		const size_t len = MIN(bundle->size - offset, (size_t) BUNDLE_CHUNK_SIZE);
+
+		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_BUNDLE);
+		Net_WriteShort(&sv_client->net_chan.message, len);
+		Net_WriteData(&sv_client->net_chan.message, bundle->data + offset, len);
+
+		offset += len;
 	}
+
+	if (offset == bundle->size && Sv_SendUnbundled())
+		return;
+
+	// have the client ask for the rest once the queue has drained
+	Net_WriteByte(&sv_client->net_chan.message, SV_CMD_CBUF_TEXT);
+	Net_WriteString(&sv_client->net_chan.message, "bundle\n");
 }
 
 /**
@@ -180,6 +180,9 @@ static void Sv_Begin_f(void) {
 
 	sv_client->state = SV_CLIENT_ACTIVE;
 
+	// forgive the debt of the connection's reliable traffic
+	sv_client->rate_tokens = MAX(sv_client->rate_tokens, 0.0);
+
 	// call the game begin function
 	svs.game->ClientBegin(sv_client->entity);
 
@@ -187,42 +190,66 @@ static void Sv_Begin_f(void) {
 }
 
 /**
- * @brief
+ * @brief Informs the client that its download was refused, or has failed.
  */
-static void Sv_NextDownload_f(void) {
-	byte buf[MAX_MSG_SIZE];
-	mem_buf_t msg;
+static void Sv_RefuseDownload(sv_client_t *cl, int32_t error) {
 
-	sv_client_download_t *download = &sv_client->download;
+	Net_WriteByte(&cl->net_chan.message, SV_CMD_DOWNLOAD);
+	Net_WriteShort(&cl->net_chan.message, error);
+	Net_WriteByte(&cl->net_chan.message, 0);
+}
 
-	if (!download->buffer)
-		return;
+/**
+ * @brief Streams the client's download from the file into its reliable queue,
+ * within its rate and however much of the queue it leaves free. The netchan
+ * then keeps a window of these chunks in flight, so that the download proceeds
+ * without a round trip per chunk.
+ */
+void Sv_NextDownload(sv_client_t *cl) {
+	byte buffer[DOWNLOAD_CHUNK_SIZE];
 
-	Mem_InitBuffer(&msg, buf, sizeof(buf));
+	sv_client_download_t *download = &cl->download;
 
-	int32_t len = Clamp(download->size - download->count, 0, 1024);
+	while (download->file) {
 
-	Net_WriteByte(&msg, SV_CMD_DOWNLOAD);
-	Net_WriteShort(&msg, len);
+		size_t len = DOWNLOAD_CHUNK_SIZE;
 
-	int32_t percent = download->count * 100 / (Clamp(download->size, 1, download->size));
-	Net_WriteByte(&msg, percent);
+		// spend only the bandwidth that has not already been claimed
+		if (Sv_RateLimited(cl)) {
+			if (!(len = Sv_DownloadBudget(cl->rate_tokens - (vec_t) Netchan_Unsent(&cl->net_chan))))
+				break;
+		}
+
+		if (cl->net_chan.message.size >= MAX_MSG_SIZE / 2) {
+			if (!Netchan_Queue(&cl->net_chan))
+				break;
+		}
 
-	Mem_WriteBuffer(&msg, download->buffer + download->count, len);
-	Mem_WriteBuffer(&sv_client->net_chan.message, msg.data, msg.size);
+		const int64_t read = Sv_ReadDownload(download, buffer, len);
 
-	download->count += len;
+		if (read == -1) {
+			Com_Warn("Failed to read download for %s\n", Sv_NetaddrToString(cl));
+			Sv_RefuseDownload(cl, DOWNLOAD_FAILED);
+			break;
+		}
 
-	if (download->count == download->size) {
-		Com_Debug("Finished download to %s\n", Sv_NetaddrToString(sv_client));
+		const int32_t percent = download->size ? download->count * 100 / download->size : 100;
 
-		Fs_Free(download->buffer);
-		download->buffer = NULL;
+		Net_WriteByte(&cl->net_chan.message, SV_CMD_DOWNLOAD);
+		Net_WriteShort(&cl->net_chan.message, (int32_t) read);
+		Net_WriteByte(&cl->net_chan.message, percent);
+		Net_WriteData(&cl->net_chan.message, buffer, read);
+
+		if (!download->file) {
+			Com_Debug("Finished download to %s\n", Sv_NetaddrToString(cl));
+		}
 	}
 }
 
 /**
- * @brief
+ * @brief Begins or resumes a download. Resumed downloads carry the offset and
+ * the checksum of the bytes preceding it, so that a partial file which does not
+ * match ours is restarted rather than corrupted.
  */
 static void Sv_Download_f(void) {
 	const char *allowed_patterns[] = {
@@ -257,42 +284,20 @@ static void Sv_Download_f(void) {
 	}
 
 	if (!sv_udp_download->value) { // ensure server wishes to allow
-		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_DOWNLOAD);
-		Net_WriteShort(&sv_client->net_chan.message, -1);
-		Net_WriteByte(&sv_client->net_chan.message, 0);
+		Sv_RefuseDownload(sv_client, DOWNLOAD_REFUSED);
 		return;
 	}
 
-	sv_client_download_t *download = &sv_client->download;
-
-	if (download->buffer) { // free last download
-		Fs_Free(download->buffer);
-	}
-
-	memset(download, 0, sizeof(*download));
+	const int64_t offset = Cmd_Argc() > 2 ? strtoll(Cmd_Argv(2), NULL, 0) : 0;
 
-	// try to load the file
-	download->size = (int32_t) Fs_Load(filename, (void *) &download->buffer);
-
-	if (download->size == -1) {
-		Com_Warn("Couldn't download %s to %s\n", filename, Sv_NetaddrToString(sv_client));
-		Net_WriteByte(&sv_client->net_chan.message, SV_CMD_DOWNLOAD);
-		Net_WriteShort(&sv_client->net_chan.message, -1);
-		Net_WriteByte(&sv_client->net_chan.message, 0);
+	if (!Sv_OpenDownload(&sv_client->download, filename, offset, Cmd_Argv(3))) {
+		Com_Debug("Refused %s to %s\n", filename, Sv_NetaddrToString(sv_client));
+		Sv_RefuseDownload(sv_client, DOWNLOAD_REFUSED);
 		return;
 	}
 
-	if (Cmd_Argc() > 2) {
-		download->count = strtol(Cmd_Argv(2), NULL, 0);
-		if (download->count < 0 || download->count > download->size) {
-			Com_Warn("Invalid offset (%d) from %s\n", download->count,
-					Sv_NetaddrToString(sv_client));
-			download->count = download->size;
-		}
-	}
-
-	Sv_NextDownload_f();
 	Com_Debug("Downloading %s to %s\n", filename, sv_client->name);
+	Sv_NextDownload(sv_client);
 }
 
 /**
@@ -333,13 +338,11 @@ typedef struct sv_user_string_cmd_s {
 
 sv_user_string_cmd_t sv_user_string_cmds[] = { // mapping command names to their functions
 	{ "new", Sv_New_f },
-	{ "config_strings", Sv_ConfigStrings_f },
-	{ "baselines", Sv_Baselines_f },
+	{ "bundle", Sv_Bundle_f },
 	{ "begin", Sv_Begin_f },
 	{ "disconnect", Sv_Disconnect_f },
 	{ "info", Sv_Info_f },
 	{ "download", Sv_Download_f },
-	{ "next_download", Sv_NextDownload_f },
 	{ NULL, NULL }
 };
 
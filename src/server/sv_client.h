@@ -25,6 +25,7 @@
 #include "sv_types.h"
 
 #ifdef __SV_LOCAL_H__
+void Sv_NextDownload(sv_client_t *cl);
 void Sv_ParseClientMessage(sv_client_t *cl);
 #endif /* __SV_LOCAL_H__ */
 
@@ -0,0 +1,128 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "sv_local.h"
+
+/**
+ * @brief Opens the specified file for download, resuming it from `offset` if
+ * that is non-zero. Resumed downloads carry the checksum of the bytes preceding
+ * the offset, so that a partial file which does not match ours is refused, and
+ * restarted by the client, rather than corrupted.
+ *
+ * @return True if the download may proceed, false if it must be refused.
+ */
+_Bool Sv_OpenDownload(sv_client_download_t *download, const char *filename, int64_t offset,
+		const char *checksum) {
+
+	Sv_CloseDownload(download);
+
+	memset(download, 0, sizeof(*download));
+
+	if (!(download->file = Fs_OpenRead(filename))) {
+		Com_Debug("Couldn't open %s\n", filename);
+		return false;
+	}
+
+	download->size = Fs_Length(download->file);
+
+	if (download->size < 0) {
+		Com_Warn("Couldn't determine the length of %s\n", filename);
+
+		Sv_CloseDownload(download);
+		return false;
+	}
+
+	if (offset) {
+		_Bool valid = offset > 0 && offset <= download->size;
+		if (valid) {
+			const int64_t len = MIN(offset, DOWNLOAD_RESUME_CHECK);
+			char *sum = Fs_Checksum(filename, offset - len, len);
+
+			valid = sum && !g_strcmp0(sum, checksum) && Fs_Seek(download->file, offset);
+			g_free(sum);
+		}
+
+		if (!valid) {
+			Com_Debug("Can't resume %s at %" PRId64 "\n", filename, offset);
+
+			Sv_CloseDownload(download);
+			return false;
+		}
+
+		download->count = offset;
+	}
+
+	return true;
+}
+
+/**
+ * @return The most that a download may send with the specified rate tokens, or
+ * 0 if it must wait for them to refill. The chunk is sized to the tokens, rather
+ * than waiting for a whole chunk's worth, because the tokens of the lowest rates
+ * never accumulate to that. A small debt is permitted so that chunks are not
+ * needlessly tiny.
+ */
+size_t Sv_DownloadBudget(vec_t tokens) {
+
+	if (tokens <= 0.0)
+		return 0;
+
+	return Clamp((size_t) tokens, (size_t) DOWNLOAD_CHUNK_MIN, (size_t) DOWNLOAD_CHUNK_SIZE);
+}
+
+/**
+ * @brief Reads the next chunk of at most `len` bytes of the download, closing
+ * it once it is complete.
+ *
+ * @return The number of bytes read, or -1 on failure, in which case the
+ * download is closed.
+ */
+int64_t Sv_ReadDownload(sv_client_download_t *download, byte *buffer, size_t len) {
+
+	if (!download->file)
+		return -1;
+
+	len = MIN(len, (size_t) (download->size - download->count));
+
+	if (Fs_Read(download->file, buffer, 1, len) != (int64_t) len) {
+		Sv_CloseDownload(download);
+		return -1;
+	}
+
+	download->count += len;
+
+	if (download->count == download->size) {
+		Sv_CloseDownload(download);
+	}
+
+	return (int64_t) len;
+}
+
+/**
+ * @brief Closes the download, if any, retaining its size and progress.
+ */
+void Sv_CloseDownload(sv_client_download_t *download) {
+
+	if (download->file) {
+		Fs_Close(download->file);
+		download->file = NULL;
+	}
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __SV_DOWNLOAD_H__
+#define __SV_DOWNLOAD_H__
+
+#include "sv_types.h"
+
+#ifdef __SV_LOCAL_H__
+_Bool Sv_OpenDownload(sv_client_download_t *download, const char *filename, int64_t offset,
+		const char *checksum);
+size_t Sv_DownloadBudget(vec_t tokens);
+int64_t Sv_ReadDownload(sv_client_download_t *download, byte *buffer, size_t len);
+void Sv_CloseDownload(sv_client_download_t *download);
+#endif /* __SV_LOCAL_H__ */
+
+#endif /* __SV_DOWNLOAD_H__ */
@@ -22,59 +22,305 @@
 #include "sv_local.h"
 
 /**
- * @brief Writes a delta update of an entity_state_t list to the message.
+ * @return The snapshot taken at the given server frame.
  */
-static void Sv_WriteEntities(sv_frame_t *from, sv_frame_t *to, mem_buf_t *msg) {
-	entity_state_t *old_state = NULL, *new_state = NULL;
-	uint32_t old_index, new_index;
-	uint16_t old_num, new_num;
-	uint16_t from_num_entities;
-
-	if (!from)
-		from_num_entities = 0;
-	else
-		from_num_entities = from->num_entities;
-
-	new_index = 0;
-	old_index = 0;
-	while (new_index < to->num_entities || old_index < from_num_entities) {
-		if (new_index >= to->num_entities)
-			new_num = 0xffff;
-		else {
-			new_state = &svs.entity_states[(to->entity_state + new_index) % svs.num_entity_states];
-			new_num = new_state->number;
+static const sv_snapshot_t *Sv_Snapshot(const int32_t frame_num) {
+	return &svs.snapshots[frame_num & PACKET_MASK];
+}
+
+/**
+ * @return The state of the given entity, as included in the client frame.
+ * The snapshot state is shared by all clients, so it is copied to `state` only
+ * if the frame modifies it.
+ */
+static const entity_state_t *Sv_FrameEntityState(const sv_frame_t *frame,
+		const sv_snapshot_t *snapshot, const uint16_t e, entity_state_t *state) {
+
+	if (frame->not_solid[e >> 3] & (1 << (e & 7))) {
+		*state = snapshot->states[e];
+		state->solid = SOLID_NOT;
+		return state;
+	}
+
+	return &snapshot->states[e];
+}
+
+/**
+ * @brief Writes the delta between the given entity states to the message,
+ * reusing the encoding from the delta cache when another client has already
+ * written the same delta.
+ *
+ * @param from_frame The frame number of the `from` state, or -1 for the baseline.
+ */
+static void Sv_WriteDeltaEntity(mem_buf_t *msg, const entity_state_t *from,
+		const entity_state_t *to, int32_t from_frame) {
+
+	const size_t slot = from_frame == -1 ? 0 : 1 + (from_frame % DELTA_ENTITY_FRAMES);
+	sv_delta_entity_t *delta = &sv.delta_entities[to->number][slot];
+
+	byte data[MAX_DELTA_ENTITY_SIZE];
+
+	uint32_t seq = __atomic_load_n(&delta->seq, __ATOMIC_ACQUIRE);
+	if ((seq & 1) == 0 && delta->from_frame == from_frame &&
+			!memcmp(&delta->to, to, sizeof(*to)) && !memcmp(&delta->from, from, sizeof(*from))) {
+
+		const size_t size = delta->size;
+		memcpy(data, delta->data, size);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		if (__atomic_load_n(&delta->seq, __ATOMIC_RELAXED) == seq) {
+			__atomic_add_fetch(&sv.delta_entity_hits, 1, __ATOMIC_RELAXED);
+			Net_WriteData(msg, data, size);
+			return;
 		}
+	}
+
+	__atomic_add_fetch(&sv.delta_entity_misses, 1, __ATOMIC_RELAXED);
+
+	mem_buf_t buf;
+	Mem_InitBuffer(&buf, data, sizeof(data));
+
+	Net_WriteDeltaEntity(&buf, from, to, from_frame == -1);
+	Net_WriteData(msg, buf.data, buf.size);
+
+	// publish the encoding, unless another client is already doing so
+	if ((seq & 1) == 0 && __atomic_compare_exchange_n(&delta->seq, &seq, seq + 1, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+
+		delta->from_frame = from_frame;
+		delta->from = *from;
+		delta->to = *to;
+
+		memcpy(delta->data, buf.data, buf.size);
+		delta->size = buf.size;
+
+		__atomic_store_n(&delta->seq, seq + 2, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * @brief Entities whose updates have been deferred for this many frames are
+ * sent regardless of the client's rate.
+ */
+#define MAX_ENTITY_DEFER 8
+
+/**
+ * @brief Entities farther than this from the client's view are of
+ * progressively lower priority when its rate is exhausted.
+ */
+#define ENTITY_PRIORITY_DISTANCE 512.0
+
+/**
+ * @return The frame whose snapshot holds the client's state for the given
+ * entity in the given frame. This is the frame itself, unless the entity's
+ * update was deferred, in which case the client retains its state from the
+ * frame that was delta'd from.
+ */
+static int32_t Sv_EntityStateFrame(const sv_client_t *client, int32_t frame_num, const uint16_t e) {
+
+	for (int32_t i = 0; i < PACKET_BACKUP; i++) {
+		const sv_frame_t *frame = &client->frames[frame_num & PACKET_MASK];
+
+		if (!(frame->deferred[e >> 3] & (1 << (e & 7))))
+			break;
+
+		frame_num = frame->delta_frame;
+	}
+
+	return frame_num;
+}
+
+/**
+ * @return The state of the given entity which the client holds for the given
+ * frame, following deferred updates back to the frame that was last sent.
+ */
+static const entity_state_t *Sv_ClientEntityState(const sv_client_t *client, const int32_t frame_num,
+		const uint16_t e, entity_state_t *state, int32_t *source) {
+
+	*source = Sv_EntityStateFrame(client, frame_num, e);
+
+	const sv_frame_t *frame = &client->frames[*source & PACKET_MASK];
+	return Sv_FrameEntityState(frame, Sv_Snapshot(*source), e, state);
+}
 
-		if (old_index >= from_num_entities)
-			old_num = 0xffff;
-		else {
-			old_state
-					= &svs.entity_states[(from->entity_state + old_index) % svs.num_entity_states];
-			old_num = old_state->number;
+/**
+ * @brief An entity competing for the client's bandwidth.
+ */
+typedef struct {
+	uint16_t number;
+	size_t size;
+	vec_t priority;
+} sv_entity_priority_t;
+
+/**
+ * @brief Sort comparator for entity priorities, highest first.
+ */
+static int32_t Sv_EntityPriorityCmp(const void *a, const void *b) {
+	const vec_t pa = ((const sv_entity_priority_t *) a)->priority;
+	const vec_t pb = ((const sv_entity_priority_t *) b)->priority;
+
+	return pa < pb ? 1 : pa > pb ? -1 : 0;
+}
+
+/**
+ * @brief Selects the entities of the frame to update within the given budget.
+ * The client's own entity, entities with events, removals and updates that
+ * have been deferred for MAX_ENTITY_DEFER frames are always sent. The rest
+ * are sent in order of staleness and proximity to the client's view, until
+ * the budget is spent.
+ */
+static void Sv_PrioritizeEntities(const sv_client_t *client, const sv_frame_t *from, int32_t from_frame,
+		const sv_frame_t *to, size_t budget, byte *send) {
+
+	static __thread sv_entity_priority_t candidates[MAX_ENTITIES];
+	size_t num_candidates = 0, size = 0;
+
+	const sv_snapshot_t *new_snapshot = Sv_Snapshot(sv.frame_num);
+	const uint16_t c = NUM_FOR_ENTITY(client->entity);
+
+	memset(send, 0, MAX_ENTITIES >> 3);
+
+	for (uint16_t e = 1; e < MAX_ENTITIES; e++) {
+		const byte old_bits = from ? from->entities[e >> 3] : 0;
+		const byte new_bits = to->entities[e >> 3];
+
+		if (!(old_bits | new_bits)) { // skip to the next byte
+			e |= 7;
+			continue;
 		}
 
-		if (new_num == old_num) { // delta update from old position
-			Net_WriteDeltaEntity(msg, old_state, new_state, false);
-			old_index++;
-			new_index++;
+		const byte bit = 1 << (e & 7);
+
+		if (!(new_bits & bit)) {
+			if (old_bits & bit) { // removals are always sent
+				size += 4;
+			}
 			continue;
 		}
 
-		if (new_num < old_num) { // this is a new entity, send it from the baseline
-			Net_WriteDeltaEntity(msg, &sv.baselines[new_num], new_state, true);
-			new_index++;
+		entity_state_t old_state, new_state;
+
+		const entity_state_t *n = Sv_FrameEntityState(to, new_snapshot, e, &new_state);
+		const entity_state_t *o = &sv.baselines[e];
+
+		int32_t age = 0, source = -1;
+
+		if (old_bits & bit) {
+			o = Sv_ClientEntityState(client, from_frame, e, &old_state, &source);
+			age = sv.frame_num - source;
+		}
+
+		// measure the update through the delta cache, so that writing it is a hit
+		byte data[MAX_DELTA_ENTITY_SIZE];
+		mem_buf_t buf;
+
+		Mem_InitBuffer(&buf, data, sizeof(data));
+		Sv_WriteDeltaEntity(&buf, o, n, source);
+
+		if (buf.size == 0 || e == c || n->event || age >= MAX_ENTITY_DEFER) {
+			send[e >> 3] |= bit;
+			size += buf.size;
 			continue;
 		}
 
-		if (new_num > old_num) { // the old entity isn't present in the new message
-			const int16_t bits = U_REMOVE;
+		vec3_t delta;
+		VectorSubtract(n->origin, client->view.origin, delta);
 
-			Net_WriteShort(msg, old_num);
-			Net_WriteShort(msg, bits);
+		vec_t priority = (1.0 + age) / (1.0 + VectorLength(delta) / ENTITY_PRIORITY_DISTANCE);
+
+		switch (n->solid) {
+			case SOLID_BOX:
+			case SOLID_BSP:
+				priority *= 4.0;
+				break;
+			case SOLID_PROJECTILE:
+				priority *= 2.0;
+				break;
+			default:
+				break;
+		}
+
+		candidates[num_candidates++] = (sv_entity_priority_t) {
+			.number = e,
+			.size = buf.size,
+			.priority = priority
+		};
+	}
+
+	qsort(candidates, num_candidates, sizeof(sv_entity_priority_t), Sv_EntityPriorityCmp);
+
+	for (size_t i = 0; i < num_candidates; i++) {
+		const sv_entity_priority_t *p = &candidates[i];
+
+		if (size + p->size <= budget) {
+			send[p->number >> 3] |= 1 << (p->number & 7);
+			size += p->size;
+		}
+	}
+}
+
+/**
+ * @brief Writes a delta update of an entity_state_t list to the message. When
+ * the budget does not afford every update, the remainder are deferred: those
+ * the client already has retain their previous state, and new entities are
+ * dropped from the frame, to be sent in a later one.
+ */
+static void Sv_WriteEntities(sv_client_t *client, const sv_frame_t *from, int32_t from_frame,
+		sv_frame_t *to, size_t budget, mem_buf_t *msg) {
+
+	const sv_snapshot_t *new_snapshot = Sv_Snapshot(sv.frame_num);
+
+	byte send[MAX_ENTITIES >> 3];
+
+	if (budget == SIZE_MAX) {
+		memset(send, 0xff, sizeof(send));
+	} else {
+		Sv_PrioritizeEntities(client, from, from_frame, to, budget, send);
+	}
+
+	to->delta_frame = from ? from_frame : -1;
+	to->oldest_frame = sv.frame_num;
 
-			old_index++;
+	for (uint16_t e = 1; e < MAX_ENTITIES; e++) {
+		const byte old_bits = from ? from->entities[e >> 3] : 0;
+		const byte new_bits = to->entities[e >> 3];
+
+		if (!(old_bits | new_bits)) { // skip to the next byte
+			e |= 7;
 			continue;
 		}
+
+		const byte bit = 1 << (e & 7);
+		entity_state_t old_state, new_state;
+
+		if (new_bits & bit) {
+
+			if (!(send[e >> 3] & bit)) {
+				if (old_bits & bit) { // the client retains its previous state
+					to->deferred[e >> 3] |= bit;
+					to->oldest_frame = MIN(to->oldest_frame, Sv_EntityStateFrame(client, from_frame, e));
+				} else { // or doesn't see the entity yet
+					to->entities[e >> 3] &= ~bit;
+				}
+				continue;
+			}
+
+			const entity_state_t *n = Sv_FrameEntityState(to, new_snapshot, e, &new_state);
+
+			if (old_bits & bit) { // delta update from old position
+				int32_t source;
+				const entity_state_t *o = Sv_ClientEntityState(client, from_frame, e, &old_state, &source);
+				Sv_WriteDeltaEntity(msg, o, n, source);
+			} else { // this is a new entity, send it from the baseline
+				Sv_WriteDeltaEntity(msg, &sv.baselines[e], n, -1);
+			}
+		} else if (old_bits & bit) { // the old entity isn't present in the new message
+			const int16_t bits = U_REMOVE;
+
+			Net_WriteShort(msg, e);
+			Net_WriteShort(msg, bits);
+		}
 	}
 
 	Net_WriteShort(msg, 0); // end of entities
@@ -93,7 +339,26 @@ static void Sv_WritePlayerState(sv_frame_t *from, sv_frame_t *to, mem_buf_t *msg
 }
 
 /**
- * @brief
+ * @return The number of bytes of entity updates the client's rate affords this
+ * frame, or SIZE_MAX if the client is not rate limited.
+ */
+static size_t Sv_EntityBudget(const sv_client_t *client, const mem_buf_t *msg) {
+
+	if (!Sv_RateLimited(client))
+		return SIZE_MAX;
+
+	const ssize_t pending = msg->size + client->datagram.buffer.size + Netchan_Unsent(&client->net_chan);
+
+	ssize_t budget = MIN((ssize_t) client->rate_tokens - pending, (ssize_t) (MAX_MSG_SIZE - 16 - msg->size));
+	budget -= 2; // end of entities
+
+	return MAX(budget, 0);
+}
+
+/**
+ * @brief Writes the client's frame, delta compressed against the last frame it
+ * acknowledged. Entity updates which the client's rate does not afford are
+ * deferred to subsequent frames.
  */
 void Sv_WriteClientFrame(sv_client_t *client, mem_buf_t *msg) {
 	sv_frame_t *frame, *delta_frame;
@@ -110,6 +375,14 @@ void Sv_WriteClientFrame(sv_client_t *client, mem_buf_t *msg) {
 		// client hasn't gotten a good message through in a long time
 		delta_frame = NULL;
 		delta_frame_num = -1;
+	} else if (Sv_Snapshot(client->last_frame)->frame_num != client->last_frame) {
+		// the snapshot the frame refers to is gone
+		delta_frame = NULL;
+		delta_frame_num = -1;
+	} else if (sv.frame_num - client->frames[client->last_frame & PACKET_MASK].oldest_frame >= PACKET_BACKUP) {
+		// a deferred entity of the frame refers to a snapshot that is gone
+		delta_frame = NULL;
+		delta_frame_num = -1;
 	} else {
 		// we have a valid message to delta from
 		delta_frame = &client->frames[client->last_frame & PACKET_MASK];
@@ -130,65 +403,106 @@ void Sv_WriteClientFrame(sv_client_t *client, mem_buf_t *msg) {
 	Sv_WritePlayerState(delta_frame, frame, msg);
 
 	// delta encode the entities
-	Sv_WriteEntities(delta_frame, frame, msg);
+	Sv_WriteEntities(client, delta_frame, delta_frame_num, frame, Sv_EntityBudget(client, msg), msg);
 }
 
 /**
- * @brief Resolve the visibility data for the bounding box around the client. The
- * bounding box provides some leniency because the client's actual view origin
- * is likely slightly different than what we think it is.
+ * @brief Resolves the distinct clusters of the bounding box around the view.
+ * The bounding box provides some leniency because the client's actual view
+ * origin is likely slightly different than what we think it is.
  */
-static void Sv_ClientVisibility(const vec3_t org, byte *pvs, byte *phs) {
+static void Sv_ClientViewClusters(sv_client_view_t *view) {
 	int32_t leafs[MAX_ENT_LEAFS];
-	int32_t clusters[MAX_ENT_LEAFS];
 	vec3_t mins, maxs;
 
-	leafs[0] = Cm_PointLeafnum(org, 0);
-	clusters[0] = Cm_LeafCluster(leafs[0]);
-
-	// take the first cluster's visibility and hearability
-	Cm_ClusterPVS(clusters[0], pvs);
-	Cm_ClusterPHS(clusters[0], phs);
+	view->clusters[0] = view->cluster;
+	view->num_clusters = 1;
 
 	// spread the bounds to account for view offset
 	for (int32_t i = 0; i < 3; i++) {
-		mins[i] = org[i] - 16.0;
-		maxs[i] = org[i] + 16.0;
+		mins[i] = view->origin[i] - 16.0;
+		maxs[i] = view->origin[i] + 16.0;
 	}
 
-	const size_t len = Cm_BoxLeafnums(mins, maxs, leafs + 1, sizeof(leafs) - 1, NULL, 0);
+	const size_t len = Cm_BoxLeafnums(mins, maxs, leafs, lengthof(leafs) - 1, NULL, 0);
 	if (len == 0) {
-		Com_Error(ERR_DROP, "Bad leaf count @ %s\n", vtos(org));
+		Com_Error(ERR_DROP, "Bad leaf count @ %s\n", vtos(view->origin));
 	}
 
-	// convert leafs to clusters and combine their visibility data
-	for (size_t i = 1; i <= len; i++) {
-		clusters[i] = Cm_LeafCluster(leafs[i]);
+	for (size_t i = 0; i < len; i++) {
+		const int32_t cluster = Cm_LeafCluster(leafs[i]);
 
 		size_t j;
-		for (j = 0; j < i; j++) {
-			if (clusters[j] == clusters[i])
+		for (j = 0; j < view->num_clusters; j++) {
+			if (view->clusters[j] == cluster)
 				break;
 		}
 
-		if (j < i) // already got it
-			continue;
+		if (j == view->num_clusters) { // not already got it
+			view->clusters[view->num_clusters++] = cluster;
+		}
+	}
+}
+
+/**
+ * @return The client's view, resolving its leaf, cluster, area and clusters if
+ * the view origin has changed since they were last resolved. This writes only
+ * to the given client, and may raise an error, so it is called on the main
+ * thread before frames are built.
+ */
+const sv_client_view_t *Sv_ClientView(sv_client_t *client) {
+	vec3_t org, off;
+
+	const pm_state_t *pm = &client->entity->client->ps.pm_state;
+	UnpackVector(pm->view_offset, off);
+	VectorAdd(pm->origin, off, org);
+
+	sv_client_view_t *view = &client->view;
+
+	if (!view->valid || !VectorCompare(org, view->origin)) {
+		VectorCopy(org, view->origin);
+
+		view->leaf = Cm_PointLeafnum(org, 0);
+		view->cluster = Cm_LeafCluster(view->leaf);
+		view->area = Cm_LeafArea(view->leaf);
+
+		Sv_ClientViewClusters(view);
+
+		view->valid = true;
+	}
+
+	return view;
+}
+
+/**
+ * @brief Resolve the visibility data of the clusters around the client's view.
+ */
+static void Sv_ClientVisibility(const sv_client_view_t *view, byte *pvs, byte *phs) {
+
+	// take the first cluster's visibility and hearability
+	const size_t vis_len = Cm_ClusterPVS(view->clusters[0], pvs);
+	Cm_ClusterPHS(view->clusters[0], phs);
+
+	// and combine those of the rest
+	for (size_t i = 1; i < view->num_clusters; i++) {
 
-		byte cluster_pvs[MAX_BSP_LEAFS >> 3];
-		Cm_ClusterPVS(clusters[i], cluster_pvs);
+		const byte *cluster_pvs = Cm_ClusterPVSBits(view->clusters[i]);
+		const byte *cluster_phs = Cm_ClusterPHSBits(view->clusters[i]);
 
-		for (size_t i = 0; i < sizeof(pvs); i++) {
-			pvs[i] |= cluster_pvs[i];
+		for (size_t j = 0; j < vis_len; j++) {
+			pvs[j] |= cluster_pvs[j];
+			phs[j] |= cluster_phs[j];
 		}
 	}
 }
 
 /**
  * @brief Decides which entities are going to be visible to the client, and
- * copies off the player state and area_bits.
+ * copies off the player state and area_bits. This only writes to the client's
+ * own frame, and reads the current snapshot, so frames for different clients
+ * may be built concurrently.
  */
 void Sv_BuildClientFrame(sv_client_t *client) {
-	vec3_t org, off;
 
 	g_entity_t *cent = client->entity;
 	if (!cent->client)
@@ -202,35 +516,56 @@ void Sv_BuildClientFrame(sv_client_t *client) {
 	frame->ps = cent->client->ps;
 
 	// find the client's PVS
-	const pm_state_t *pm = &cent->client->ps.pm_state;
-	UnpackVector(pm->view_offset, off);
-	VectorAdd(pm->origin, off, org);
-
-	const int32_t leaf = Cm_PointLeafnum(org, 0);
-	const int32_t area = Cm_LeafArea(leaf);
+	const sv_client_view_t *view = Sv_ClientView(client);
+	const int32_t area = view->area;
 
 	// calculate the visible areas
 	frame->area_bytes = Cm_WriteAreaBits(area, frame->area_bits);
 
 	// resolve the visibility data
 	byte pvs[MAX_BSP_LEAFS >> 3], phs[MAX_BSP_LEAFS >> 3];
-	Sv_ClientVisibility(org, pvs, phs);
+	Sv_ClientVisibility(view, pvs, phs);
+
+	// gather the entities in the potentially hearable or visible clusters
+	byte vis[MAX_BSP_LEAFS >> 3], entities[MAX_ENTITIES >> 3];
+
+	const size_t vis_len = (Cm_NumClusters() + 7) >> 3;
+	for (size_t i = 0; i < vis_len; i++) {
+		vis[i] = pvs[i] | phs[i];
+	}
+
+	memset(entities, 0, sizeof(entities));
+	Sv_ClusterEntities(vis, entities);
+
+	const uint16_t c = NUM_FOR_ENTITY(cent);
+	entities[c >> 3] |= 1 << (c & 7);
 
-	// build up the list of relevant entities
-	frame->num_entities = 0;
-	frame->entity_state = svs.next_entity_state;
+	// of which only those in the snapshot are candidates
+	const sv_snapshot_t *snapshot = Sv_Snapshot(sv.frame_num);
+
+	for (size_t i = 0; i < sizeof(entities); i++) {
+		entities[i] &= snapshot->entities[i];
+	}
+
+	// build up the set of relevant entities
+	memset(frame->entities, 0, sizeof(frame->entities));
+	memset(frame->not_solid, 0, sizeof(frame->not_solid));
+	memset(frame->deferred, 0, sizeof(frame->deferred));
 
 	for (uint16_t e = 1; e < svs.game->num_entities; e++) {
-		g_entity_t *ent = ENTITY_FOR_NUM(e);
 
-		// ignore entities that are local to the server
-		if (ent->sv_flags & SVF_NO_CLIENT)
+		if (!entities[e >> 3]) { // skip to the next byte
+			e |= 7;
 			continue;
+		}
 
-		// ignore entities without visible presence unless they have an effect
-		if (!ent->s.event && !ent->s.effects && !ent->s.trail && !ent->s.model1 && !ent->s.sound)
+		const byte bit = 1 << (e & 7);
+
+		if (!(entities[e >> 3] & bit))
 			continue;
 
+		const g_entity_t *ent = ENTITY_FOR_NUM(e);
+
 		// ignore entities not in PVS / PHS
 		if (ent != cent) {
 			const sv_entity_t *sent = &sv.entities[e];
@@ -241,7 +576,8 @@ void Sv_BuildClientFrame(sv_client_t *client) {
 					continue;
 			}
 
-			const byte *vis = ent->s.sound || ent->s.event ? phs : pvs;
+			const entity_state_t *s = &snapshot->states[e];
+			const byte *vis = s->sound || s->event ? phs : pvs;
 
 			if (sent->num_clusters == -1) { // use top_node
 				if (!Cm_HeadnodeVisible(sent->top_node, vis))
@@ -258,19 +594,43 @@ void Sv_BuildClientFrame(sv_client_t *client) {
 			}
 		}
 
-		// copy it to the circular entity_state_t array
-		entity_state_t *s = &svs.entity_states[svs.next_entity_state % svs.num_entity_states];
+		frame->entities[e >> 3] |= bit;
+
+		// don't mark our own missiles as solid for prediction
+		if (ent->owner == client->entity)
+			frame->not_solid[e >> 3] |= bit;
+	}
+}
+
+/**
+ * @brief Takes the snapshot of all entity states for the current frame, from
+ * which the frames of all clients are built. Entities which are local to the
+ * server, or which have no visible presence, are omitted.
+ */
+void Sv_BuildSnapshot(void) {
+
+	sv_snapshot_t *snapshot = &svs.snapshots[sv.frame_num & PACKET_MASK];
+
+	snapshot->frame_num = sv.frame_num;
+	memset(snapshot->entities, 0, sizeof(snapshot->entities));
+
+	for (uint16_t e = 1; e < svs.game->num_entities; e++) {
+		g_entity_t *ent = ENTITY_FOR_NUM(e);
+
+		// ignore entities that are local to the server
+		if (ent->sv_flags & SVF_NO_CLIENT)
+			continue;
+
+		// ignore entities without visible presence unless they have an effect
+		if (!ent->s.event && !ent->s.effects && !ent->s.trail && !ent->s.model1 && !ent->s.sound)
+			continue;
+
 		if (ent->s.number != e) {
 			Com_Warn("Fixing entity number: %d -> %d\n", ent->s.number, e);
 			ent->s.number = e;
 		}
-		*s = ent->s;
-
-		// don't mark our own missiles as solid for prediction
-		if (ent->owner == client->entity)
-			s->solid = SOLID_NOT;
 
-		svs.next_entity_state++;
-		frame->num_entities++;
+		snapshot->states[e] = ent->s;
+		snapshot->entities[e >> 3] |= 1 << (e & 7);
 	}
 }
@@ -25,8 +25,10 @@
 #include "sv_types.h"
 
 #ifdef __SV_LOCAL_H__
+const sv_client_view_t *Sv_ClientView(sv_client_t *client);
 void Sv_WriteClientFrame(sv_client_t *client, mem_buf_t *msg);
 void Sv_BuildClientFrame(sv_client_t *client);
+void Sv_BuildSnapshot(void);
 #endif /* __SV_LOCAL_H__ */
 
 #endif /* __SV_ENTITY_H__ */
@@ -86,6 +86,11 @@ static void Sv_ConfigString(const uint16_t index, const char *val) {
 	// change the string in sv.config_strings
 	g_strlcpy(sv.config_strings[index], val, sizeof(sv.config_strings[0]));
 
+	// the bundle is immutable, so connecting clients must be sent this individually
+	if (sv.bundle.data) {
+		sv.bundle.unbundled[index] = true;
+	}
+
 	if (sv.state != SV_LOADING) { // send the update to everyone
 		Mem_ClearBuffer(&sv.multicast);
 		Net_WriteByte(&sv.multicast, SV_CMD_CONFIG_STRING);
@@ -148,8 +153,6 @@ static void Sv_WriteAngles(const vec3_t angles) {
  * @brief Also checks areas so that doors block sight.
  */
 static _Bool Sv_InPVS(const vec3_t p1, const vec3_t p2) {
-	byte pvs[MAX_BSP_LEAFS >> 3];
-
 	const int32_t leaf1 = Cm_PointLeafnum(p1, 0);
 	const int32_t leaf2 = Cm_PointLeafnum(p2, 0);
 
@@ -162,7 +165,7 @@ static _Bool Sv_InPVS(const vec3_t p1, const vec3_t p2) {
 	const int32_t cluster1 = Cm_LeafCluster(leaf1);
 	const int32_t cluster2 = Cm_LeafCluster(leaf2);
 
-	Cm_ClusterPVS(cluster1, pvs);
+	const byte *pvs = Cm_ClusterPVSBits(cluster1);
 
 	if ((pvs[cluster2 >> 3] & (1 << (cluster2 & 7))) == 0)
 		return false;
@@ -174,8 +177,6 @@ static _Bool Sv_InPVS(const vec3_t p1, const vec3_t p2) {
  * @brief Also checks areas so that doors block sound.
  */
 static _Bool Sv_InPHS(const vec3_t p1, const vec3_t p2) {
-	byte phs[MAX_BSP_LEAFS >> 3];
-
 	const int32_t leaf1 = Cm_PointLeafnum(p1, 0);
 
 	const int32_t leaf2 = Cm_PointLeafnum(p2, 0);
@@ -189,7 +190,7 @@ static _Bool Sv_InPHS(const vec3_t p1, const vec3_t p2) {
 	const int32_t cluster1 = Cm_LeafCluster(leaf1);
 	const int32_t cluster2 = Cm_LeafCluster(leaf2);
 
-	Cm_ClusterPHS(cluster1, phs);
+	const byte *phs = Cm_ClusterPHSBits(cluster1);
 
 	if ((phs[cluster2 >> 3] & (1 << (cluster2 & 7))) == 0)
 		return false;
@@ -0,0 +1,250 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "sv_local.h"
+
+/**
+ * @brief Visiting a cell is roughly this many times cheaper than testing an
+ * item, which decides whether a query walks a level's cells or its items.
+ */
+#define GRID_CELLS_PER_ITEM 8
+
+/**
+ * @brief Initializes the grid over the specified bounds, for items numbered
+ * below num_items. Levels are added, each with cells half the size of the
+ * last, until the cells would be smaller than GRID_MIN_CELL_SIZE. The first
+ * level is a single cell spanning the bounds, which holds any item too large
+ * for the others.
+ */
+void Sv_InitGrid(sv_grid_t *grid, const vec3_t mins, const vec3_t maxs, const int32_t num_items) {
+	vec3_t size;
+
+	memset(grid, 0, sizeof(*grid));
+
+	VectorCopy(mins, grid->origin);
+	VectorSubtract(maxs, mins, size);
+
+	const vec_t max_size = MAX(MAX(MAX(size[0], size[1]), size[2]), GRID_MIN_CELL_SIZE);
+
+	sv_grid_level_t *level = grid->levels;
+	for (vec_t cell_size = max_size; grid->num_levels < GRID_MAX_LEVELS; cell_size *= 0.5, level++) {
+
+		if (grid->num_levels && cell_size < GRID_MIN_CELL_SIZE)
+			break;
+
+		level->cell_size = cell_size;
+		level->first_cell = grid->num_cells;
+		level->items = -1;
+
+		int32_t cells = 1;
+		for (int32_t i = 0; i < 3; i++) {
+			level->dims[i] = MAX((int32_t) ceilf(size[i] / cell_size), 1);
+			cells *= level->dims[i];
+		}
+
+		grid->num_cells += cells;
+		grid->num_levels++;
+	}
+
+	grid->cells = Mem_Malloc(grid->num_cells * sizeof(int32_t));
+	memset(grid->cells, 0xff, grid->num_cells * sizeof(int32_t));
+
+	grid->items = Mem_Malloc(num_items * sizeof(sv_grid_item_t));
+	grid->num_items = num_items;
+
+	for (int32_t i = 0; i < num_items; i++) {
+		grid->items[i].level = grid->items[i].cell = -1;
+	}
+
+	Com_Debug("%d levels, %d cells\n", grid->num_levels, grid->num_cells);
+}
+
+/**
+ * @brief Frees the cells and items of the grid.
+ */
+void Sv_FreeGrid(sv_grid_t *grid) {
+
+	Mem_Free(grid->cells);
+	Mem_Free(grid->items);
+
+	memset(grid, 0, sizeof(*grid));
+}
+
+/**
+ * @return The index of the cell containing the given coordinate along the
+ * specified axis, clamped to the level.
+ */
+static inline int32_t Sv_GridIndex(const sv_grid_t *grid, const sv_grid_level_t *level,
+		const int32_t axis, const vec_t v) {
+
+	const vec_t i = floorf((v - grid->origin[axis]) / level->cell_size);
+
+	return (int32_t) Clamp(i, 0.0, (vec_t) (level->dims[axis] - 1));
+}
+
+/**
+ * @brief Links the item into the grid with the given bounds, unlinking it first
+ * if necessary.
+ */
+void Sv_GridLink(sv_grid_t *grid, const int32_t item, const vec3_t mins, const vec3_t maxs) {
+
+	Sv_GridUnlink(grid, item);
+
+	sv_grid_item_t *it = &grid->items[item];
+
+	VectorCopy(mins, it->mins);
+	VectorCopy(maxs, it->maxs);
+
+	// find the finest level at which the item fits within one loose cell
+	const vec_t size = MAX(MAX(maxs[0] - mins[0], maxs[1] - mins[1]), maxs[2] - mins[2]);
+
+	it->level = 0;
+	while (it->level + 1 < grid->num_levels && grid->levels[it->level + 1].cell_size >= size) {
+		it->level++;
+	}
+
+	sv_grid_level_t *level = &grid->levels[it->level];
+
+	int32_t index[3];
+	for (int32_t i = 0; i < 3; i++) {
+		index[i] = Sv_GridIndex(grid, level, i, 0.5 * (mins[i] + maxs[i]));
+	}
+
+	it->cell = level->first_cell + (index[2] * level->dims[1] + index[1]) * level->dims[0] + index[0];
+
+	// add it to the head of the cell
+	it->prev = -1;
+	it->next = grid->cells[it->cell];
+
+	if (it->next != -1) {
+		grid->items[it->next].prev = item;
+	}
+
+	grid->cells[it->cell] = item;
+
+	// and to the head of the level
+	it->level_prev = -1;
+	it->level_next = level->items;
+
+	if (it->level_next != -1) {
+		grid->items[it->level_next].level_prev = item;
+	}
+
+	level->items = item;
+	level->num_items++;
+}
+
+/**
+ * @brief Unlinks the item from the grid.
+ *
+ * @return True if the item was linked, false otherwise.
+ */
+_Bool Sv_GridUnlink(sv_grid_t *grid, const int32_t item) {
+
+	sv_grid_item_t *it = &grid->items[item];
+
+	if (it->cell == -1)
+		return false;
+
+	if (it->prev == -1) {
+		grid->cells[it->cell] = it->next;
+	} else {
+		grid->items[it->prev].next = it->next;
+	}
+
+	if (it->next != -1) {
+		grid->items[it->next].prev = it->prev;
+	}
+
+	sv_grid_level_t *level = &grid->levels[it->level];
+
+	if (it->level_prev == -1) {
+		level->items = it->level_next;
+	} else {
+		grid->items[it->level_prev].level_next = it->level_next;
+	}
+
+	if (it->level_next != -1) {
+		grid->items[it->level_next].level_prev = it->level_prev;
+	}
+
+	level->num_items--;
+
+	it->level = it->cell = -1;
+	return true;
+}
+
+/**
+ * @brief Calls the given function for each item whose bounds intersect the
+ * specified box, until it returns false. At each level, only the cells whose
+ * loose bounds touch the box are visited, or the level's list of items if
+ * that is cheaper.
+ */
+void Sv_GridQuery(const sv_grid_t *grid, const vec3_t mins, const vec3_t maxs, GridQueryFunc func,
+		void *data) {
+
+	const sv_grid_level_t *level = grid->levels;
+	for (int32_t l = 0; l < grid->num_levels; l++, level++) {
+
+		if (!level->num_items)
+			continue;
+
+		const vec_t loose = 0.5 * level->cell_size;
+		int32_t lo[3], hi[3];
+		int32_t cells = 1;
+
+		for (int32_t i = 0; i < 3; i++) {
+			lo[i] = Sv_GridIndex(grid, level, i, mins[i] - loose);
+			hi[i] = Sv_GridIndex(grid, level, i, maxs[i] + loose);
+			cells *= hi[i] - lo[i] + 1;
+		}
+
+		if (cells > GRID_CELLS_PER_ITEM * level->num_items) { // cheaper to test everything
+			for (int32_t item = level->items; item != -1; item = grid->items[item].level_next) {
+				const sv_grid_item_t *it = &grid->items[item];
+
+				if (BoxIntersect(it->mins, it->maxs, mins, maxs)) {
+					if (!func(item, data))
+						return;
+				}
+			}
+			continue;
+		}
+
+		for (int32_t z = lo[2]; z <= hi[2]; z++) {
+			for (int32_t y = lo[1]; y <= hi[1]; y++) {
+
+				const int32_t row = level->first_cell + (z * level->dims[1] + y) * level->dims[0];
+
+				for (int32_t x = lo[0]; x <= hi[0]; x++) {
+					for (int32_t item = grid->cells[row + x]; item != -1; item = grid->items[item].next) {
+						const sv_grid_item_t *it = &grid->items[item];
+
+						if (BoxIntersect(it->mins, it->maxs, mins, maxs)) {
+							if (!func(item, data))
+								return;
+						}
+					}
+				}
+			}
+		}
+	}
+}
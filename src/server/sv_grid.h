@@ -0,0 +1,93 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __SV_GRID_H__
+#define __SV_GRID_H__
+
+#include "shared.h"
+
+/**
+ * @brief The most levels a grid may have.
+ */
+#define GRID_MAX_LEVELS 8
+
+/**
+ * @brief Grid levels are added until their cells would be smaller than this.
+ */
+#define GRID_MIN_CELL_SIZE 128.0
+
+/**
+ * @brief An item linked into the grid. Each item is linked into exactly one
+ * cell, and into the list of all items at that cell's level. Lists are
+ * intrusive, by item number, and terminated by -1.
+ */
+typedef struct {
+	vec3_t mins, maxs;
+	int32_t level, cell; // -1 if not linked
+	int32_t prev, next; // within the cell
+	int32_t level_prev, level_next; // within the level
+} sv_grid_item_t;
+
+/**
+ * @brief One level of the grid. Each level halves the cell size of the last.
+ */
+typedef struct {
+	vec_t cell_size;
+	int32_t dims[3];
+	int32_t first_cell; // the index of this level's first cell in the grid
+	int32_t num_items;
+	int32_t items; // the first item at this level
+} sv_grid_level_t;
+
+/**
+ * @brief A loose, hierarchical grid over a fixed set of items. An item is
+ * placed at the finest level whose cells are at least as large as it is, in
+ * the cell containing its center. Because the cells are loose by half their
+ * size, no item ever spans more than one cell.
+ */
+typedef struct {
+	vec3_t origin;
+
+	sv_grid_level_t levels[GRID_MAX_LEVELS];
+	int32_t num_levels;
+
+	int32_t *cells; // the first item in each cell
+	int32_t num_cells;
+
+	sv_grid_item_t *items;
+	int32_t num_items;
+} sv_grid_t;
+
+/**
+ * @brief Callback for Sv_GridQuery. Return false to end the query.
+ */
+typedef _Bool (*GridQueryFunc)(int32_t item, void *data);
+
+#ifdef __SV_LOCAL_H__
+void Sv_InitGrid(sv_grid_t *grid, const vec3_t mins, const vec3_t maxs, const int32_t num_items);
+void Sv_FreeGrid(sv_grid_t *grid);
+void Sv_GridLink(sv_grid_t *grid, const int32_t item, const vec3_t mins, const vec3_t maxs);
+_Bool Sv_GridUnlink(sv_grid_t *grid, const int32_t item);
+void Sv_GridQuery(const sv_grid_t *grid, const vec3_t mins, const vec3_t maxs, GridQueryFunc func,
+		void *data);
+#endif /* __SV_LOCAL_H__ */
+
+#endif /* __SV_GRID_H__ */
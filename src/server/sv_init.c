@@ -93,6 +93,75 @@ static void Sv_CreateBaseline(void) {
 	}
 }
 
+/**
+ * @brief Builds the connection bundle of the level's static config strings and
+ * its baselines. The bundle is the raw length, the coded length (or 0 if it is
+ * stored raw), and then the config string and baseline commands. The player
+ * and game config strings, which change during play, are sent individually.
+ */
+static void Sv_CreateBundle(void) {
+	static entity_state_t null_state;
+
+	sv_bundle_t *bundle = &sv.bundle;
+
+	size_t max_size = MAX_ENTITIES * (sizeof(entity_state_t) + 8);
+
+	for (int32_t i = 0; i < CS_CLIENTS; i++) {
+		max_size += strlen(sv.config_strings[i]) + 4;
+	}
+
+	mem_buf_t raw;
+	Mem_InitBuffer(&raw, Mem_Malloc(max_size), max_size);
+
+	for (uint16_t i = 0; i < MAX_CONFIG_STRINGS; i++) {
+
+		if (i >= CS_CLIENTS) {
+			bundle->unbundled[i] = true;
+			continue;
+		}
+
+		if (sv.config_strings[i][0]) {
+			Net_WriteByte(&raw, SV_CMD_CONFIG_STRING);
+			Net_WriteShort(&raw, i);
+			Net_WriteString(&raw, sv.config_strings[i]);
+		}
+	}
+
+	for (int32_t i = 0; i < MAX_ENTITIES; i++) {
+		const entity_state_t *base = &sv.baselines[i];
+		if (base->model1 || base->sound || base->effects) {
+			Net_WriteByte(&raw, SV_CMD_BASELINE);
+			Net_WriteDeltaEntity(&raw, &null_state, base, true);
+		}
+	}
+
+	bundle->data = Mem_Malloc(raw.size + 8);
+
+	mem_buf_t msg;
+	Mem_InitBuffer(&msg, bundle->data, raw.size + 8);
+
+	const size_t len = Net_HuffmanEncode(raw.data, raw.size, bundle->data + 8, raw.size);
+
+	Net_WriteLong(&msg, (int32_t) raw.size);
+	Net_WriteLong(&msg, (int32_t) len);
+
+	if (len) {
+		msg.size += len;
+	} else {
+		Mem_WriteBuffer(&msg, raw.data, raw.size);
+	}
+
+	bundle->size = msg.size;
+
+	char *hash = g_compute_checksum_for_data(G_CHECKSUM_SHA1, bundle->data, bundle->size);
+	g_strlcpy(bundle->hash, hash, sizeof(bundle->hash));
+	g_free(hash);
+
+	Com_Debug("%s: %u bytes, %u raw\n", bundle->hash, (uint32_t) bundle->size, (uint32_t) raw.size);
+
+	Mem_Free(raw.data);
+}
+
 /**
  * @brief Sends the shutdown message message to all connected clients. The message
  * is sent immediately, because the server could completely terminate after
@@ -134,6 +203,14 @@ static void Sv_ClearState() {
 		if (sv.demo_file) {
 			Fs_Close(sv.demo_file);
 		}
+
+		if (sv.collision_capture) {
+			Fs_Close(sv.collision_capture);
+		}
+
+		if (sv.bundle.data) {
+			Mem_Free(sv.bundle.data);
+		}
 	}
 
 	memset(&sv, 0, sizeof(sv));
@@ -147,6 +224,8 @@ static void Sv_ClearState() {
  */
 static void Sv_UpdateLatchedVars(void) {
 	extern _Bool cm_no_areas;
+	extern size_t cm_vis_matrix_budget;
+	extern int32_t cm_bvh_mode;
 
 	Cvar_UpdateLatched();
 
@@ -155,6 +234,10 @@ static void Sv_UpdateLatchedVars(void) {
 	sv_hz->integer = Clamp(sv_hz->integer, SV_HZ_MIN, SV_HZ_MAX);
 
 	cm_no_areas = sv_no_areas->integer;
+
+	cm_vis_matrix_budget = MAX(sv_vis_matrix->integer, 0) * 1024;
+
+	cm_bvh_mode = sv_collision_bvh->integer;
 }
 
 /**
@@ -169,16 +252,16 @@ static void Sv_ShutdownClients(void) {
 
 	for (i = 0, cl = svs.clients; i < sv_max_clients->integer; i++, cl++) {
 
-		if (cl->download.buffer) {
-			Fs_Free(cl->download.buffer);
-		}
+		Sv_CloseDownload(&cl->download);
+
+		Netchan_Release(&cl->net_chan);
 	}
 
 	Mem_Free(svs.clients);
 	svs.clients = NULL;
 
-	Mem_Free(svs.entity_states);
-	svs.entity_states = NULL;
+	Mem_Free(svs.snapshots);
+	svs.snapshots = NULL;
 }
 
 /**
@@ -199,9 +282,8 @@ static void Sv_InitEntities(void) {
 		// initialize the clients array
 		svs.clients = Mem_TagMalloc(sizeof(sv_client_t) * sv_max_clients->integer, MEM_TAG_SERVER);
 
-		// and the entity states array
-		svs.num_entity_states = sv_max_clients->integer * PACKET_BACKUP * MAX_PACKET_ENTITIES;
-		svs.entity_states = Mem_TagMalloc(sizeof(entity_state_t) * svs.num_entity_states, MEM_TAG_SERVER);
+		// and the entity state snapshots
+		svs.snapshots = Mem_TagMalloc(sizeof(sv_snapshot_t) * PACKET_BACKUP, MEM_TAG_SERVER);
 
 		svs.frame_rate = sv_hz->integer;
 
@@ -233,6 +315,7 @@ static void Sv_InitClients(void) {
 
 		// invalidate last frame to force a baseline
 		svs.clients[i].last_frame = -1;
+		svs.clients[i].view.valid = false;
 		svs.clients[i].last_message = quetoo.time;
 	}
 }
@@ -260,6 +343,8 @@ static void Sv_LoadMedia(const char *server, sv_state_t state) {
 
 		sv.cm_models[0] = Cm_LoadBspModel(sv.config_strings[CS_MODELS], &bsp_size);
 
+		Net_SetBounds(sv.cm_models[0]->mins, sv.cm_models[0]->maxs);
+
 		const char *dir = Fs_RealDir(sv.config_strings[CS_MODELS]);
 		if (g_str_has_suffix(dir, ".pk3")) {
 			g_strlcpy(sv.config_strings[CS_ZIP], Basename(dir), MAX_STRING_CHARS);
@@ -277,6 +362,10 @@ static void Sv_LoadMedia(const char *server, sv_state_t state) {
 			sv.cm_models[i] = Cm_Model(s);
 		}
 
+		if (sv_collision_capture->integer) {
+			Sv_CaptureCollision();
+		}
+
 		sv.state = SV_LOADING;
 
 		Sv_InitWorld();
@@ -299,6 +388,10 @@ static void Sv_LoadMedia(const char *server, sv_state_t state) {
 	}
 	g_snprintf(sv.config_strings[CS_BSP_SIZE], MAX_STRING_CHARS, "%" PRId64, bsp_size);
 
+	if (state == SV_ACTIVE_GAME) {
+		Sv_CreateBundle();
+	}
+
 	Cvar_FullSet("map_name", sv.name, CVAR_SERVER_INFO | CVAR_NO_SET);
 }
 
@@ -341,6 +434,12 @@ void Sv_InitServer(const char *server, sv_state_t state) {
 
 	Net_Config(NS_UDP_SERVER, true);
 
+	if (sv_net_thread->integer) {
+		Net_StartThread(NS_UDP_SERVER);
+	} else {
+		Net_StopThread(NS_UDP_SERVER);
+	}
+
 	Mem_InitBuffer(&sv.multicast, sv.multicast_buffer, sizeof(sv.multicast_buffer));
 
 	// initialize entities, reloading the game module if necessary
@@ -27,16 +27,20 @@ sv_server_t sv; // per-level server info
 
 sv_client_t *sv_client; // current client
 
+cvar_t *sv_collision_bvh;
+cvar_t *sv_collision_capture;
 cvar_t *sv_download_url;
 cvar_t *sv_enforce_time;
 cvar_t *sv_hostname;
 cvar_t *sv_hz;
 cvar_t *sv_max_clients;
+cvar_t *sv_net_thread;
 cvar_t *sv_no_areas;
 cvar_t *sv_public;
 cvar_t *sv_rcon_password; // password for remote server commands
 cvar_t *sv_timeout;
 cvar_t *sv_udp_download;
+cvar_t *sv_vis_matrix;
 
 /**
  * @brief Called when the player is totally leaving the server, either willingly
@@ -63,9 +67,9 @@ void Sv_DropClient(sv_client_t *cl) {
 		Netchan_Transmit(&cl->net_chan, cl->net_chan.message.data, cl->net_chan.message.size);
 	}
 
-	if (cl->download.buffer) {
-		Fs_Free(cl->download.buffer);
-	}
+	Sv_CloseDownload(&cl->download);
+
+	Netchan_Release(&cl->net_chan);
 
 	ent = cl->entity;
 
@@ -323,10 +327,16 @@ static void Sv_Connect_f(void) {
 	g_strlcpy(client->user_info, user_info, sizeof(client->user_info));
 	Sv_UserInfoChanged(client);
 
+	// compress packets to remote clients that share our Huffman model
+	const _Bool compress = net_compress->integer &&
+			strtol(Cmd_Argv(5), NULL, 0) == NET_HUFFMAN_MODEL && addr->type != NA_LOOP;
+
 	// send the connect packet to the client
-	Netchan_OutOfBandPrint(NS_UDP_SERVER, addr, "client_connect %s", sv_download_url->string);
+	Netchan_OutOfBandPrint(NS_UDP_SERVER, addr, "client_connect %d %s",
+			compress ? NET_HUFFMAN_MODEL : 0, sv_download_url->string);
 
 	Netchan_Setup(NS_UDP_SERVER, &client->net_chan, addr, qport);
+	client->net_chan.compress = compress;
 
 	Mem_InitBuffer(&client->datagram.buffer, client->datagram.data, sizeof(client->datagram.data));
 	client->datagram.buffer.allow_overflow = true;
@@ -519,6 +529,29 @@ static void Sv_CheckCommandTimes(void) {
 	}
 }
 
+/**
+ * @brief Accumulates the variation in the interval between the client's
+ * packets, smoothed as the interarrival jitter of RFC 3550. With
+ * `sv_net_thread`, arrival times are taken as packets are received rather
+ * than as they are read, so that this reflects the network rather than the
+ * server frame rate.
+ */
+static void Sv_UpdateJitter(sv_client_t *cl, const uint64_t time) {
+
+	if (cl->last_receive_time) {
+		const int64_t interval = time - cl->last_receive_time;
+
+		if (cl->last_receive_interval) {
+			const int64_t delta = llabs(interval - cl->last_receive_interval);
+			cl->jitter += (delta - cl->jitter) / 16.0;
+		}
+
+		cl->last_receive_interval = interval;
+	}
+
+	cl->last_receive_time = time;
+}
+
 /**
  * @brief
  */
@@ -562,6 +595,7 @@ static void Sv_ReadPackets(void) {
 			// this is a valid, sequenced packet, so process it
 			if (Netchan_Process(&cl->net_chan, &net_message)) {
 				cl->last_message = quetoo.time; // nudge timeout
+				Sv_UpdateJitter(cl, Net_ReceiveTime(NS_UDP_SERVER));
 				Sv_ParseClientMessage(cl);
 			}
 
@@ -772,6 +806,11 @@ static void Sv_InitLocal(void) {
 
 	sv_rcon_password = Cvar_Get("rcon_password", "", 0, NULL);
 
+	sv_collision_bvh = Cvar_Get("sv_collision_bvh", va("%d", CM_BVH_NEVER), CVAR_LATCH,
+			"Clip to brushes with a BVH rather than the BSP (0 never, 1 for large open models, 2 always)\n");
+	sv_collision_capture = Cvar_Get("sv_collision_capture", "0", 0,
+			"Record world collision queries to captures/ for bench_collision, from the next map\n");
+
 	sv_download_url = Cvar_Get("sv_download_url", "", CVAR_SERVER_INFO, NULL);
 	sv_enforce_time = Cvar_Get("sv_enforce_time", va("%d", CMD_MSEC_MAX_DRIFT_ERRORS), 0, NULL);
 
@@ -784,9 +823,15 @@ static void Sv_InitLocal(void) {
 
 	sv_max_clients = Cvar_Get("sv_max_clients", "8", CVAR_SERVER_INFO | CVAR_LATCH, NULL);
 
+	sv_net_thread = Cvar_Get("sv_net_thread", "0", CVAR_LATCH,
+			"Receive and send datagrams on a dedicated network thread, from the next map\n");
+
 	sv_timeout = Cvar_Get("sv_timeout", va("%d", SV_TIMEOUT), 0, NULL);
 	sv_udp_download = Cvar_Get("sv_udp_download", "1", CVAR_ARCHIVE, NULL);
 
+	sv_vis_matrix = Cvar_Get("sv_vis_matrix", va("%d", CM_VIS_MATRIX_BUDGET >> 10), CVAR_LATCH,
+			"Memory budget in kilobytes for precomputed PVS and PHS (0 to disable)\n");
+
 	// set this so clients and server browsers can see it
 	Cvar_Get("sv_protocol", va("%i", PROTOCOL_MAJOR), CVAR_SERVER_INFO | CVAR_NO_SET, NULL);
 }
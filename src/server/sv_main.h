@@ -30,16 +30,20 @@ void Sv_Frame(const uint32_t msec);
 
 #ifdef __SV_LOCAL_H__
 // cvars
+extern cvar_t *sv_collision_bvh;
+extern cvar_t *sv_collision_capture;
 extern cvar_t *sv_download_url;
 extern cvar_t *sv_enforce_time;
 extern cvar_t *sv_hostname;
 extern cvar_t *sv_hz;
 extern cvar_t *sv_max_clients;
+extern cvar_t *sv_net_thread;
 extern cvar_t *sv_no_areas;
 extern cvar_t *sv_public;
 extern cvar_t *sv_rcon_password;
 extern cvar_t *sv_timeout;
 extern cvar_t *sv_udp_download;
+extern cvar_t *sv_vis_matrix;
 
 // per-level and static server structures
 extern sv_server_t sv;
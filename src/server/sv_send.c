@@ -118,7 +118,7 @@ void Sv_BroadcastCommand(const char *fmt, ...) {
 /**
  * @brief Writes to the specified datagram, noting the offset of the message.
  */
-static void Sv_ClientDatagramMessage(sv_client_t *cl, byte *data, size_t len) {
+static void Sv_ClientDatagramMessage(sv_client_t *cl, const byte *data, size_t len) {
 
 	if (len > MAX_MSG_SIZE) {
 		Com_Error(ERR_DROP, "Single datagram message exceeded MAX_MSG_LEN\n");
@@ -144,6 +144,192 @@ static void Sv_ClientDatagramMessage(sv_client_t *cl, byte *data, size_t len) {
 	}
 }
 
+/**
+ * @brief Writes a run of queued multicasts, which are contiguous in the queue,
+ * to the specified datagram at once, noting the offset of each message. If the
+ * run would overflow the datagram, the messages are written individually so
+ * that overflow is handled as usual.
+ */
+static void Sv_ClientDatagramMulticasts(sv_client_t *cl, const sv_multicast_t *multicasts,
+		size_t count) {
+
+	const byte *data = sv.multicast_queue.data;
+
+	const sv_multicast_t *first = multicasts, *last = multicasts + count - 1;
+	const size_t len = last->offset + last->len - first->offset;
+
+	mem_buf_t *buffer = &cl->datagram.buffer;
+
+	if (buffer->size + len > buffer->max_size) {
+		for (size_t i = 0; i < count; i++) {
+			Sv_ClientDatagramMessage(cl, data + multicasts[i].offset, multicasts[i].len);
+		}
+		return;
+	}
+
+	GList *messages = NULL;
+
+	for (size_t i = 0; i < count; i++) {
+		sv_client_message_t *msg = g_malloc0(sizeof(*msg));
+
+		msg->offset = buffer->size + multicasts[i].offset - first->offset;
+		msg->len = multicasts[i].len;
+
+		messages = g_list_prepend(messages, msg);
+	}
+
+	cl->datagram.messages = g_list_concat(cl->datagram.messages, g_list_reverse(messages));
+
+	Mem_WriteBuffer(buffer, data + first->offset, len);
+}
+
+/**
+ * @return The PVS or PHS row of the given cluster for multicasting. The row of
+ * the most recent multicast of each type is kept, since many sounds and temp
+ * entities within a frame originate from the same cluster.
+ */
+static const byte *Sv_MulticastVis(const int32_t cluster, const int32_t type) {
+
+	sv_multicast_vis_t *vis = &sv.multicast_vis[type];
+
+	if (!vis->valid || vis->cluster != cluster) {
+		const byte *bits = type == DVIS_PVS ? Cm_ClusterPVSBits(cluster) : Cm_ClusterPHSBits(cluster);
+
+		memcpy(vis->bits, bits, (Cm_NumClusters() + 7) >> 3);
+		vis->cluster = cluster;
+		vis->valid = true;
+	}
+
+	return vis->bits;
+}
+
+/**
+ * @return True if the client's view is within the given area and vis row.
+ */
+static _Bool Sv_MulticastVisible(const sv_client_view_t *view, const byte *vis, const int32_t area) {
+
+	if (!Cm_AreasConnected(area, view->area))
+		return false;
+
+	if (view->cluster == -1)
+		return false;
+
+	return vis[view->cluster >> 3] & (1 << (view->cluster & 7));
+}
+
+/**
+ * @brief Delivers the queued unreliable multicasts. The recipients of each are
+ * resolved against the cached views of the active clients, and then each
+ * client is written the runs of consecutive multicasts it receives.
+ */
+static void Sv_FlushMulticasts(void) {
+	const sv_client_view_t *views[MAX_CLIENTS];
+
+	sv_multicast_queue_t *queue = &sv.multicast_queue;
+
+	if (!queue->num_multicasts)
+		return;
+
+	uint64_t active = 0;
+
+	sv_client_t *cl = svs.clients;
+	for (int32_t j = 0; j < sv_max_clients->integer; j++, cl++) {
+
+		if (cl->state != SV_CLIENT_ACTIVE || cl->entity->ai)
+			continue;
+
+		active |= 1ull << j;
+		views[j] = Sv_ClientView(cl);
+	}
+
+	// resolve the recipients of each multicast
+	for (size_t i = 0; i < queue->num_multicasts; i++) {
+		sv_multicast_t *m = &queue->multicasts[i];
+
+		m->clients &= active;
+
+		if (m->to == MULTICAST_ALL)
+			continue;
+
+		const byte *vis = Sv_MulticastVis(m->cluster, m->to == MULTICAST_PHS ? DVIS_PHS : DVIS_PVS);
+
+		for (uint64_t bits = m->clients; bits; bits &= bits - 1) {
+			const int32_t j = __builtin_ctzll(bits);
+
+			if (!Sv_MulticastVisible(views[j], vis, m->area)) {
+				m->clients &= ~(1ull << j);
+			}
+		}
+	}
+
+	// and write them to each client in contiguous runs
+	for (uint64_t bits = active; bits; bits &= bits - 1) {
+		const int32_t j = __builtin_ctzll(bits);
+		const uint64_t bit = 1ull << j;
+
+		for (size_t i = 0; i < queue->num_multicasts;) {
+
+			if (!(queue->multicasts[i].clients & bit)) {
+				i++;
+				continue;
+			}
+
+			size_t k = i + 1;
+			while (k < queue->num_multicasts && (queue->multicasts[k].clients & bit)) {
+				k++;
+			}
+
+			Sv_ClientDatagramMulticasts(svs.clients + j, queue->multicasts + i, k - i);
+			i = k;
+		}
+	}
+
+	queue->num_multicasts = 0;
+	queue->size = 0;
+}
+
+/**
+ * @brief Queues the contents of sv.multicast for delivery to the clients that
+ * the given filter permits, and which are within the given cluster's PVS or PHS.
+ * The filter is evaluated now, since it may depend on game state.
+ */
+static void Sv_QueueMulticast(multicast_t to, int32_t cluster, int32_t area, EntityFilterFunc filter) {
+
+	sv_multicast_queue_t *queue = &sv.multicast_queue;
+
+	if (queue->num_multicasts == MAX_MULTICASTS || queue->size + sv.multicast.size > sizeof(queue->data)) {
+		Sv_FlushMulticasts();
+	}
+
+	sv_multicast_t *m = &queue->multicasts[queue->num_multicasts++];
+
+	m->offset = queue->size;
+	m->len = sv.multicast.size;
+	m->to = to;
+	m->cluster = cluster;
+	m->area = area;
+
+	if (filter) { // allow the game module to filter the recipients
+		m->clients = 0;
+
+		const sv_client_t *cl = svs.clients;
+		for (int32_t j = 0; j < sv_max_clients->integer; j++, cl++) {
+
+			if (cl->state != SV_CLIENT_ACTIVE || cl->entity->ai)
+				continue;
+
+			if (filter(cl->entity)) {
+				m->clients |= 1ull << j;
+			}
+		}
+	} else {
+		m->clients = ~0ull;
+	}
+
+	memcpy(queue->data + queue->size, sv.multicast.data, sv.multicast.size);
+	queue->size += sv.multicast.size;
+}
+
 /**
  * @brief Sends the contents of the mutlicast buffer to a single client
  */
@@ -162,6 +348,7 @@ void Sv_Unicast(const g_entity_t *ent, const _Bool reliable) {
 		if (reliable) {
 			Mem_WriteBuffer(&cl->net_chan.message, sv.multicast.data, sv.multicast.size);
 		} else {
+			Sv_FlushMulticasts(); // preserve the order of the client's datagram messages
 			Sv_ClientDatagramMessage(cl, sv.multicast.data, sv.multicast.size);
 		}
 	}
@@ -171,11 +358,11 @@ void Sv_Unicast(const g_entity_t *ent, const _Bool reliable) {
 
 /**
  * @brief Sends the contents of sv.multicast to a subset of the clients,
- * then clears sv.multicast.
+ * then clears sv.multicast. Reliable multicasts are written immediately, while
+ * unreliable ones are queued until the end of the frame.
  */
 void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter) {
-	byte vis[MAX_BSP_LEAFS >> 3];
-	int32_t area;
+	int32_t cluster, area;
 
 	origin = origin ?: vec3_origin;
 
@@ -186,29 +373,18 @@ void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter)
 			reliable = true;
 			/* no break */
 		case MULTICAST_ALL:
-			memset(vis, 1, sizeof(vis));
-			area = 0;			
+			cluster = -1;
+			area = 0;
 			break;
 
 		case MULTICAST_PHS_R:
-			reliable = true;
-			/* no break */
-		case MULTICAST_PHS: {
-			const int32_t leaf = Cm_PointLeafnum(origin, 0);
-			const int32_t cluster = Cm_LeafCluster(leaf);
-			Cm_ClusterPHS(cluster, vis);
-			area = Cm_LeafArea(leaf);
-		}
-
-			break;
-
 		case MULTICAST_PVS_R:
 			reliable = true;
 			/* no break */
+		case MULTICAST_PHS:
 		case MULTICAST_PVS: {
 			const int32_t leaf = Cm_PointLeafnum(origin, 0);
-			const int32_t cluster = Cm_LeafCluster(leaf);
-			Cm_ClusterPVS(cluster, vis);
+			cluster = Cm_LeafCluster(leaf);
 			area = Cm_LeafArea(leaf);
 		}
 			break;
@@ -219,6 +395,20 @@ void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter)
 			return;
 	}
 
+	if (!reliable) {
+		Sv_QueueMulticast(to, cluster, area, filter);
+		Mem_ClearBuffer(&sv.multicast);
+		return;
+	}
+
+	const byte *vis = NULL;
+
+	if (to == MULTICAST_PHS_R) {
+		vis = Sv_MulticastVis(cluster, DVIS_PHS);
+	} else if (to == MULTICAST_PVS_R) {
+		vis = Sv_MulticastVis(cluster, DVIS_PVS);
+	}
+
 	// send the data to all relevant clients
 	sv_client_t *cl = svs.clients;
 	for (int32_t j = 0; j < sv_max_clients->integer; j++, cl++) {
@@ -226,29 +416,11 @@ void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter)
 		if (cl->state == SV_CLIENT_FREE)
 			continue;
 
-		if (cl->state != SV_CLIENT_ACTIVE && !reliable)
-			continue;
-
 		if (cl->entity->ai)
 			continue;
 
-		if (to != MULTICAST_ALL && to != MULTICAST_ALL_R) {
-			const pm_state_t *pm = &cl->entity->client->ps.pm_state;
-			vec3_t org, off;
-
-			UnpackVector(pm->view_offset, off);
-			VectorAdd(pm->origin, off, org);
-
-			const int32_t leaf = Cm_PointLeafnum(org, 0);
-
-			const int32_t client_area = Cm_LeafArea(leaf);
-			if (!Cm_AreasConnected(area, client_area))
-				continue;
-
-			const int32_t cluster = Cm_LeafCluster(leaf);
-			if (!(vis[cluster >> 3] & (1 << (cluster & 7))))
-				continue;
-		}
+		if (vis && !Sv_MulticastVisible(Sv_ClientView(cl), vis, area))
+			continue;
 
 		if (filter) { // allow the game module to filter the recipients
 			if (!filter(cl->entity)) {
@@ -256,11 +428,7 @@ void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter)
 			}
 		}
 
-		if (reliable) {
-			Mem_WriteBuffer(&cl->net_chan.message, sv.multicast.data, sv.multicast.size);
-		} else {
-			Sv_ClientDatagramMessage(cl, sv.multicast.data, sv.multicast.size);
-		}
+		Mem_WriteBuffer(&cl->net_chan.message, sv.multicast.data, sv.multicast.size);
 	}
 
 	Mem_ClearBuffer(&sv.multicast);
@@ -331,23 +499,83 @@ void Sv_PositionedSound(const vec3_t origin, const g_entity_t *ent, const uint16
 }
 
 /**
- * @brief
+ * @brief A run of clients whose frames are built by one thread.
  */
-static void Sv_SendClientDatagram(sv_client_t *cl) {
-	byte buffer[MAX_MSG_SIZE];
-	mem_buf_t buf;
+typedef struct {
+	sv_client_t **clients;
+	size_t num_clients;
+} sv_client_frames_t;
+
+/**
+ * @brief Builds and writes the frame message for each of the specified clients.
+ */
+static void Sv_BuildClientFrames(void *data) {
+	const sv_client_frames_t *frames = (sv_client_frames_t *) data;
+
+	for (size_t i = 0; i < frames->num_clients; i++) {
+		sv_client_t *cl = frames->clients[i];
+
+		Sv_BuildClientFrame(cl);
+
+		Mem_InitBuffer(&cl->frame_message, cl->frame_buffer, sizeof(cl->frame_buffer));
+		cl->frame_message.allow_overflow = true;
+
+		// send over all the relevant entity_state_t and the player_state_t
+		Sv_WriteClientFrame(cl, &cl->frame_message);
+	}
+}
 
-	Sv_BuildClientFrame(cl);
+/**
+ * @brief Builds the frame messages for the specified clients, dividing them
+ * among the thread pool. Frame building touches only per-client state and
+ * reads the world, so the clients are independent of each other.
+ */
+static void Sv_BuildClientFramesParallel(sv_client_t **clients, size_t num_clients) {
+	sv_client_frames_t frames[MAX_THREADS + 1];
+	thread_t *threads[MAX_THREADS + 1];
+
+	const size_t num_jobs = MAX(MIN((size_t) Thread_Count() + 1, num_clients), 1);
+
+	for (size_t i = 0, first = 0; i < num_jobs; i++) {
+		const size_t last = num_clients * (i + 1) / num_jobs;
+
+		frames[i].clients = clients + first;
+		frames[i].num_clients = last - first;
+
+		first = last;
+	}
+
+	// workers must not raise errors, so resolve the views here, which may; the
+	// entity numbers which Net_WriteDeltaEntity checks are fixed by the snapshot
+	for (size_t i = 0; i < num_clients; i++) {
+		if (clients[i]->entity->client) {
+			Sv_ClientView(clients[i]);
+		}
+	}
+
+	// dispatch all but the first job, which we run ourselves
+	for (size_t i = 1; i < num_jobs; i++) {
+		threads[i] = Thread_Create(Sv_BuildClientFrames, &frames[i]);
+	}
 
-	Mem_InitBuffer(&buf, buffer, sizeof(buffer));
-	buf.allow_overflow = true;
+	Sv_BuildClientFrames(&frames[0]);
+
+	for (size_t i = 1; i < num_jobs; i++) {
+		Thread_Wait(threads[i]);
+	}
+}
+
+/**
+ * @brief Transmits the client's frame message, built by Sv_BuildClientFrames,
+ * followed by its pending datagram messages.
+ */
+static void Sv_SendClientDatagram(sv_client_t *cl) {
+
+	mem_buf_t buf = cl->frame_message;
 
 	// accumulate the total size for rate throttling
 	size_t frame_size = 0;
 
-	// send over all the relevant entity_state_t and the player_state_t
-	Sv_WriteClientFrame(cl, &buf);
-
 	// the frame itself (player state and delta entities) must fit into a single message,
 	// since it is parsed as a single command by the client
 	if (buf.overflowed || buf.size > MAX_MSG_SIZE - 16) {
@@ -363,8 +591,7 @@ static void Sv_SendClientDatagram(sv_client_t *cl) {
 		if (buf.size + msg->len > (MAX_MSG_SIZE - 16)) {
 			Com_Debug("Fragmenting datagram @ %u bytes\n", (uint32_t) buf.size);
 
-			Netchan_Transmit(&cl->net_chan, buf.data, buf.size);
-			frame_size += buf.size;
+			frame_size += Netchan_Transmit(&cl->net_chan, buf.data, buf.size);
 
 			Mem_ClearBuffer(&buf);
 		}
@@ -374,11 +601,12 @@ static void Sv_SendClientDatagram(sv_client_t *cl) {
 	}
 
 	// send the pending packet, which may include reliable messages
-	Netchan_Transmit(&cl->net_chan, buf.data, buf.size);
-	frame_size += buf.size;
+	frame_size += Netchan_Transmit(&cl->net_chan, buf.data, buf.size);
 
-	// record the total size for rate estimation
-	cl->frame_size[sv.frame_num % sv_hz->integer] = frame_size;
+	// spend the client's bandwidth
+	if (Sv_RateLimited(cl)) {
+		cl->rate_tokens -= frame_size;
+	}
 }
 
 /**
@@ -389,13 +617,9 @@ static void Sv_DemoCompleted(void) {
 }
 
 /**
- * @brief Returns true if the client is over its current bandwidth estimation
- * and should not be sent another packet.
+ * @return True if the client's bandwidth is limited by its rate.
  */
-static _Bool Sv_RateDrop(sv_client_t *cl) {
-
-	if (sv.frame_num < sv_hz->integer)
-		return false;
+_Bool Sv_RateLimited(const sv_client_t *cl) {
 
 	if (cl->rate == 0)
 		return false;
@@ -403,14 +627,27 @@ static _Bool Sv_RateDrop(sv_client_t *cl) {
 	if (cl->net_chan.remote_address.type == NA_LOOP)
 		return false;
 
-	size_t total = 0;
+	return true;
+}
 
-	for (int32_t i = 0; i < sv_hz->integer; i++) {
-		total += cl->frame_size[(sv.frame_num - i) % sv_hz->integer];
-		if (total > cl->rate) {
-			cl->surpress_count++;
-			return true;
-		}
+/**
+ * @brief Refills the client's token bucket for this frame. Returns true if the
+ * client has nonetheless exhausted its bandwidth, and should not be sent
+ * another packet. Otherwise, Sv_WriteClientFrame fits the frame's entities to
+ * the remaining tokens.
+ */
+static _Bool Sv_RateDrop(sv_client_t *cl) {
+
+	if (!Sv_RateLimited(cl))
+		return false;
+
+	const vec_t burst = cl->rate * RATE_BURST;
+
+	cl->rate_tokens = MIN(cl->rate_tokens + cl->rate / (vec_t) sv_hz->integer, burst);
+
+	if (cl->rate_tokens <= 0.0) {
+		cl->surpress_count++;
+		return true;
 	}
 
 	return false;
@@ -462,15 +699,22 @@ static size_t Sv_GetDemoMessage(byte *buffer) {
 
 /**
  * @brief Send the frame and all pending datagram messages since the last frame.
+ * The frames of all active clients are built first, in parallel if the thread
+ * pool allows, and then transmitted serially.
  */
 void Sv_SendClientPackets(void) {
-	sv_client_t * cl;
+	sv_client_t *clients[MAX_CLIENTS];
+	size_t num_clients = 0;
+	sv_client_t *cl;
 	int32_t i;
 
 	if (!svs.initialized)
 		return;
 
-	// send a message to each connected client
+	// deliver the multicasts queued during the frame
+	Sv_FlushMulticasts();
+
+	// drop overflowed clients and select those which will be sent a frame
 	for (i = 0, cl = svs.clients; i < sv_max_clients->integer; i++, cl++) {
 
 		if (cl->state == SV_CLIENT_FREE) // don't bother
@@ -483,6 +727,34 @@ void Sv_SendClientPackets(void) {
 			continue;
 		}
 
+		cl->frame_message.size = 0;
+
+		// refill every client's bandwidth, so that the connection's reliable
+		// traffic does not leave a newly spawned client in debt
+		const _Bool drop = Sv_RateDrop(cl);
+
+		if (sv.state != SV_ACTIVE_DEMO && cl->state == SV_CLIENT_ACTIVE) {
+
+			if (!drop) { // enforce rate throttle
+				clients[num_clients++] = cl;
+			}
+		}
+	}
+
+	if (num_clients) {
+		Sv_BuildSnapshot();
+	}
+
+	Sv_BuildClientFramesParallel(clients, num_clients);
+
+	// send a message to each connected client, batching the datagrams
+	Net_BeginDatagrams(NS_UDP_SERVER);
+
+	for (i = 0, cl = svs.clients; i < sv_max_clients->integer; i++, cl++) {
+
+		if (cl->state == SV_CLIENT_FREE) // don't bother
+			continue;
+
 		if (sv.state == SV_ACTIVE_DEMO) { // send the demo packet
 			byte buffer[MAX_MSG_SIZE];
 			size_t size;
@@ -492,12 +764,13 @@ void Sv_SendClientPackets(void) {
 			}
 		} else if (cl->state == SV_CLIENT_ACTIVE) { // send the game packet
 
-			if (Sv_RateDrop(cl)) { // enforce rate throttle
-				cl->frame_size[sv.frame_num % sv_hz->integer] = 0;
-			} else {
+			if (cl->frame_message.size) {
 				Sv_SendClientDatagram(cl);
 			}
 
+			// downloads use whatever bandwidth the frame left
+			Sv_NextDownload(cl);
+
 			// clean up for the next frame
 			Mem_ClearBuffer(&cl->datagram.buffer);
 
@@ -508,9 +781,17 @@ void Sv_SendClientPackets(void) {
 			cl->datagram.messages = NULL;
 
 		} else { // just update reliable if needed
-			if (cl->net_chan.message.size || quetoo.time - cl->net_chan.last_sent > 1000)
-				Netchan_Transmit(&cl->net_chan, NULL, 0);
+			Sv_NextDownload(cl);
+
+			if (Netchan_Pending(&cl->net_chan) || quetoo.time - cl->net_chan.last_sent > 1000) {
+				const size_t size = Netchan_Transmit(&cl->net_chan, NULL, 0);
+
+				if (Sv_RateLimited(cl)) {
+					cl->rate_tokens -= size;
+				}
+			}
 		}
 	}
-}
 
+	Net_FlushDatagrams(NS_UDP_SERVER);
+}
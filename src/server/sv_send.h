@@ -25,6 +25,7 @@
 #include "sv_types.h"
 
 #ifdef __SV_LOCAL_H__
+_Bool Sv_RateLimited(const sv_client_t *cl);
 void Sv_SendClientPackets(void);
 void Sv_Unicast(const g_entity_t *ent, const _Bool reliable);
 void Sv_Multicast(const vec3_t origin, multicast_t to, EntityFilterFunc filter);
@@ -41,6 +41,20 @@
  */
 #define MAX_ENT_CLUSTERS 32
 
+/**
+ * @brief The clipping transform of an entity. This is cached across links, and
+ * rebuilt only when the origin, angles or bounds it was derived from change.
+ */
+typedef struct {
+	vec3_t origin, angles, mins, maxs;
+	_Bool valid;
+
+	matrix4x4_t matrix; // local to world
+	matrix4x4_t inverse_matrix; // world to local
+
+	vec3_t abs_mins, abs_maxs; // the bounds, transformed to world space
+} sv_entity_transform_t;
+
 /**
  * @brief The server-specific view of an entity. An sv_entity_t corresponds to
  * precisely one g_entity_t, where most general-purpose entity state resides.
@@ -53,12 +67,79 @@ typedef struct {
 	int32_t num_clusters; // if -1, use top_node
 
 	int32_t areas[2];
-	struct sv_sector_s *sector;
 
-	matrix4x4_t matrix;
-	matrix4x4_t inverse_matrix;
+	sv_entity_transform_t transform;
 } sv_entity_t;
 
+/**
+ * @brief The largest encoding Net_WriteDeltaEntity may produce: the number
+ * and bits, three positions and angles, and every remaining field.
+ */
+#define MAX_DELTA_ENTITY_SIZE 64
+
+/**
+ * @brief The number of previous frames, per entity, from which encoded deltas
+ * are cached. Clients acknowledging the same frame share a slot.
+ */
+#define DELTA_ENTITY_FRAMES 4
+
+/**
+ * @brief An entity delta encoded by Net_WriteDeltaEntity, memoized so that
+ * clients delta'ing between identical states may share it. The encoding is a
+ * pure function of the two states, so a cached delta is valid whenever both
+ * states match. Each entry is guarded by a sequence lock, because frames for
+ * different clients are written concurrently.
+ */
+typedef struct {
+	uint32_t seq; // odd while the entry is being written
+	int32_t from_frame; // the frame delta'd from, or -1 for the baseline
+
+	entity_state_t from, to;
+
+	byte data[MAX_DELTA_ENTITY_SIZE];
+	size_t size;
+} sv_delta_entity_t;
+
+/**
+ * @brief A PVS or PHS row retained for multicasting, so that multicasts from
+ * the same cluster as the previous one need not resolve it again.
+ */
+typedef struct {
+	_Bool valid;
+	int32_t cluster;
+	byte bits[MAX_BSP_LEAFS >> 3];
+} sv_multicast_vis_t;
+
+/**
+ * @brief The number of unreliable multicasts, and the total size of their
+ * messages, that may be queued before the queue is flushed.
+ */
+#define MAX_MULTICASTS 1024
+#define MULTICAST_QUEUE_SIZE (MAX_MSG_SIZE * 4)
+
+/**
+ * @brief An unreliable multicast, queued for delivery at the end of the frame.
+ */
+typedef struct {
+	size_t offset, len; // the message, within the queue's data
+	multicast_t to;
+	int32_t cluster, area; // of the multicast origin
+	uint64_t clients; // the recipients, as permitted by the filter (MAX_CLIENTS bits)
+} sv_multicast_t;
+
+/**
+ * @brief Unreliable multicasts are queued, and their recipients resolved all at
+ * once, so that the messages of a busy frame are written to each client's
+ * datagram in contiguous runs.
+ */
+typedef struct {
+	sv_multicast_t multicasts[MAX_MULTICASTS];
+	size_t num_multicasts;
+
+	byte data[MULTICAST_QUEUE_SIZE];
+	size_t size;
+} sv_multicast_queue_t;
+
 /**
  * @brief Server states.
  */
@@ -69,6 +150,18 @@ typedef enum {
 	SV_ACTIVE_DEMO
 } sv_state_t;
 
+/**
+ * @brief The connection bundle of the level's static config strings and its
+ * baselines, built and Huffman coded once at load, and shared by all connecting
+ * clients. Config strings which may change during play are sent individually.
+ */
+typedef struct {
+	byte *data;
+	size_t size;
+	char hash[64]; // the content hash, by which clients cache the bundle
+	_Bool unbundled[MAX_CONFIG_STRINGS]; // sent individually, after the bundle
+} sv_bundle_t;
+
 /**
  * @brief The sv_server_t struct is wiped at each level load.
  */
@@ -87,21 +180,51 @@ typedef struct {
 	sv_entity_t entities[MAX_ENTITIES]; // the server-local entity structures
 	entity_state_t baselines[MAX_ENTITIES]; // g_entity_t baselines
 
+	// the config strings and baselines, for connecting clients
+	sv_bundle_t bundle;
+
+	// encoded entity deltas, shared by all clients; the first slot is from the baseline
+	sv_delta_entity_t delta_entities[MAX_ENTITIES][DELTA_ENTITY_FRAMES + 1];
+	uint32_t delta_entity_hits, delta_entity_misses;
+
 	// the multicast buffer is used to send a message to a set of clients
 	// it is flushed each time Sv_Multicast is called
 	mem_buf_t multicast;
 	byte multicast_buffer[MAX_MSG_SIZE];
 
+	// the PVS and PHS rows of the most recent multicasts
+	sv_multicast_vis_t multicast_vis[2];
+
+	// unreliable multicasts pending delivery
+	sv_multicast_queue_t multicast_queue;
+
 	// demo server information
 	file_t *demo_file;
+
+	// world collision queries are recorded here for bench_collision
+	file_t *collision_capture;
 } sv_server_t;
 
+/**
+ * @brief An immutable snapshot of every entity state that may be sent to
+ * clients, taken once per server frame. Client frames record which of these
+ * entities they include, rather than copying the states themselves.
+ */
+typedef struct {
+	int32_t frame_num; // the server frame the snapshot was taken at
+	byte entities[MAX_ENTITIES >> 3]; // the entities with a visible presence
+	entity_state_t states[MAX_ENTITIES];
+} sv_snapshot_t;
+
 typedef struct {
 	int32_t area_bytes;
 	byte area_bits[MAX_BSP_AREAS >> 3]; // portal area visibility bits
 	player_state_t ps;
-	uint16_t num_entities;
-	uint32_t entity_state; // index into svs.entity_states array
+	byte entities[MAX_ENTITIES >> 3]; // the entities of the frame's snapshot visible to the client
+	byte not_solid[MAX_ENTITIES >> 3]; // the client's own missiles, not solid for prediction
+	byte deferred[MAX_ENTITIES >> 3]; // entities whose state is unchanged from the delta frame
+	int32_t delta_frame; // the frame this frame was delta'd from, or -1
+	int32_t oldest_frame; // the oldest snapshot referenced through deferred entities
 	uint32_t sent_time; // for ping calculations
 } sv_frame_t;
 
@@ -116,6 +239,23 @@ typedef struct {
  */
 #define SV_HZ 30
 
+/**
+ * @brief Clients may accumulate up to this fraction of a second of their rate,
+ * so that a quiet period affords a brief burst.
+ */
+#define RATE_BURST 0.25
+
+/**
+ * @brief Downloads are streamed from the file in pieces of this size.
+ */
+#define DOWNLOAD_CHUNK_SIZE 4096
+
+/**
+ * @brief Rate limited downloads send smaller chunks, as their rate allows, but
+ * not smaller than this.
+ */
+#define DOWNLOAD_CHUNK_MIN 512
+
 /**
  * @brief Clients are dropped after 60 seconds without receiving a packet.
  */
@@ -170,16 +310,29 @@ typedef struct {
 } sv_client_datagram_t;
 
 /**
- * @brief Each client my download a single file at a time via the game's UDP
+ * @brief Each client may download a single file at a time via the game's UDP
  * protocol. This only serves as a fallback for when HTTP downloading is not
  * configured or unavailable.
  */
 typedef struct {
-	byte *buffer;
-	int32_t size;
-	int32_t count;
+	file_t *file; // streamed from, a chunk at a time
+	int64_t size;
+	int64_t count; // the bytes queued so far
 } sv_client_download_t;
 
+/**
+ * @brief The client's view origin, and the leaf, cluster and area containing
+ * it. These are resolved only when the view origin changes, and are shared by
+ * multicasts and frame building.
+ */
+typedef struct {
+	_Bool valid;
+	vec3_t origin;
+	int32_t leaf, cluster, area;
+	int32_t clusters[MAX_ENT_LEAFS]; // the distinct clusters around the origin
+	size_t num_clusters;
+} sv_client_view_t;
+
 /**
  * @brief Per-client accounting for protocol flow control and low-level
  * connection state management.
@@ -197,7 +350,11 @@ typedef struct {
 
 	uint32_t frame_latency[SV_CLIENT_LATENCY_COUNT]; // used to calculate ping
 
-	uint32_t frame_size[SV_HZ_MAX]; // used to rate drop packets
+	uint64_t last_receive_time; // the arrival time of the last packet, in microseconds
+	int64_t last_receive_interval; // the time between the last two packets
+	vec_t jitter; // smoothed variation in packet interval, in microseconds
+
+	vec_t rate_tokens; // the bytes the client may yet be sent, refilled at its rate
 	uint32_t rate;
 	uint32_t surpress_count; // number of messages rate suppressed
 
@@ -212,6 +369,13 @@ typedef struct {
 
 	sv_frame_t frames[PACKET_BACKUP]; // updates can be delta'd from here
 
+	sv_client_view_t view; // see Sv_ClientView
+
+	// the frame message for the current server frame, which is built in
+	// parallel with other clients' and then transmitted serially
+	mem_buf_t frame_message;
+	byte frame_buffer[MAX_MSG_SIZE];
+
 	sv_client_download_t download; // UDP file downloads
 
 	uint32_t last_message; // quetoo.time when packet was last received
@@ -256,15 +420,9 @@ typedef struct {
 
 	sv_client_t *clients; // server-side client structures
 
-	// the server maintains an array of entity states it uses to calculate
-	// delta compression from frame to frame
-
-	// the size of this array is based on the number of clients we might be
-	// asked to support at any point in time during the current game
-
-	uint32_t num_entity_states; // sv_max_clients->integer * UPDATE_BACKUP * MAX_PACKET_ENTITIES
-	uint32_t next_entity_state; // next entity_state to use for newly spawned entities
-	entity_state_t *entity_states; // entity states array used for delta compression
+	// the server takes a snapshot of all entity states each frame, and keeps
+	// PACKET_BACKUP of them to delta compress client frames against
+	sv_snapshot_t *snapshots;
 
 	net_addr_t masters[MAX_MASTERS];
 	uint32_t next_heartbeat;
@@ -22,86 +22,210 @@
 #include "sv_local.h"
 
 /**
- * @brief The world is divided into evenly sized sectors to aid in entity
- * management. This works like a meta-BSP tree, providing fast searches via
- * recursion to find entities within an arbitrary box.
+ * @brief A node in a doubly-linked list of entities. Nodes are numbered
+ * `entity * MAX_ENT_CLUSTERS + slot`, and -1 terminates a list.
  */
-typedef struct sv_sector_s {
-	int32_t axis; // -1 = leaf
-	vec_t dist;
-	struct sv_sector_s *children[2];
-	GList *entities;
-} sv_sector_t;
+typedef struct {
+	int32_t prev, next;
+} sv_cluster_link_t;
+
+/**
+ * @brief The cluster lists an entity is linked into, one slot per cluster.
+ */
+typedef struct {
+	int32_t clusters[MAX_ENT_CLUSTERS];
+	int32_t num_clusters;
+	sv_cluster_link_t links[MAX_ENT_CLUSTERS];
+} sv_cluster_entity_t;
 
-#define SECTOR_DEPTH	4
-#define SECTOR_NODES	32
+/**
+ * @brief Entities which touch more than MAX_ENT_CLUSTERS clusters, and are
+ * therefore culled by their top_node, are linked into this list instead.
+ */
+#define LARGE_ENTITIES MAX_BSP_LEAFS
 
 /**
- * @brief The world structure contains all sectors and also the current query
- * context issued to Sv_BoxEntities.
+ * @brief The world structure contains the spatial index of solid entities,
+ * and the entities linked to each cluster.
  */
 typedef struct {
-	sv_sector_t sectors[SECTOR_NODES];
-	uint16_t num_sectors;
+	sv_grid_t grid; // solid entities, by entity number
 
+	int32_t cluster_entities[LARGE_ENTITIES + 1]; // list heads, by cluster
+	sv_cluster_entity_t entities[MAX_ENTITIES];
+} sv_world_t;
+
+/**
+ * @brief The query context issued to Sv_BoxEntities. This is kept on the stack
+ * so that queries may be issued from any number of threads.
+ */
+typedef struct {
 	const vec_t *box_mins, *box_maxs;
 
 	g_entity_t **box_entities;
 	size_t num_box_entities, max_box_entities;
 
 	uint32_t box_type; // BOX_SOLID, BOX_TRIGGER, ..
-} sv_world_t;
+} sv_box_entities_t;
 
 static sv_world_t sv_world;
 
 /**
- * @brief Builds a uniformly subdivided tree for the given world size.
+ * @brief Opens a collision capture for the current level. World queries are
+ * recorded to it until the level ends, for replay by `bench_collision`.
  */
-static sv_sector_t *Sv_CreateSector(int32_t depth, vec3_t mins, vec3_t maxs) {
-	vec3_t size, mins1, maxs1, mins2, maxs2;
+void Sv_CaptureCollision(void) {
 
-	sv_sector_t *sector = &sv_world.sectors[sv_world.num_sectors];
-	sv_world.num_sectors++;
+	const char *path = va("captures/%s.cmc", sv.name);
 
-	if (depth == SECTOR_DEPTH) {
-		sector->axis = -1;
-		sector->children[0] = sector->children[1] = NULL;
-		return sector;
+	if (!(sv.collision_capture = Fs_OpenWrite(path))) {
+		Com_Warn("Couldn't open %s\n", path);
+		return;
 	}
 
-	VectorSubtract(maxs, mins, size);
-	if (size[0] > size[1])
-		sector->axis = 0;
-	else
-		sector->axis = 1;
+	cm_capture_header_t header;
+	memset(&header, 0, sizeof(header));
+
+	header.magic = CM_CAPTURE_MAGIC;
+	g_strlcpy(header.map, sv.config_strings[CS_MODELS], sizeof(header.map));
 
-	sector->dist = 0.5 * (maxs[sector->axis] + mins[sector->axis]);
-	VectorCopy(mins, mins1);
-	VectorCopy(mins, mins2);
-	VectorCopy(maxs, maxs1);
-	VectorCopy(maxs, maxs2);
+	Fs_Write(sv.collision_capture, &header, sizeof(header), 1);
 
-	maxs1[sector->axis] = mins2[sector->axis] = sector->dist;
+	Com_Print("  Capturing collision to %s\n", path);
+}
+
+/**
+ * @brief Records a world collision query to the capture, if one is open.
+ */
+static void Sv_CaptureQuery(const cm_capture_type_t type, const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, const int32_t contents) {
+
+	if (!sv.collision_capture)
+		return;
+
+	cm_capture_t capture;
+	memset(&capture, 0, sizeof(capture));
+
+	capture.type = type;
+	capture.contents = contents;
 
-	sector->children[0] = Sv_CreateSector(depth + 1, mins2, maxs2);
-	sector->children[1] = Sv_CreateSector(depth + 1, mins1, maxs1);
+	if (start)
+		VectorCopy(start, capture.start);
+	if (end)
+		VectorCopy(end, capture.end);
+	if (mins)
+		VectorCopy(mins, capture.mins);
+	if (maxs)
+		VectorCopy(maxs, capture.maxs);
 
-	return sector;
+	Fs_Write(sv.collision_capture, &capture, sizeof(capture), 1);
 }
 
 /**
- * @brief Resolve our area nodes for a newly loaded level. This is called prior to
- * linking any entities.
+ * @brief Sizes the spatial index for a newly loaded level. This is called prior
+ * to linking any entities.
  */
 void Sv_InitWorld(void) {
 
-	for (uint16_t i = 0; i < sv_world.num_sectors; i++) {
-		g_list_free(sv_world.sectors[i].entities);
-	}
+	Sv_FreeGrid(&sv_world.grid);
 
 	memset(&sv_world, 0, sizeof(sv_world));
+	memset(sv_world.cluster_entities, 0xff, sizeof(sv_world.cluster_entities));
+
+	Sv_InitGrid(&sv_world.grid, sv.cm_models[0]->mins, sv.cm_models[0]->maxs, MAX_ENTITIES);
+}
+
+/**
+ * @return The cluster list node with the specified number.
+ */
+static inline sv_cluster_link_t *Sv_ClusterLink(const int32_t node) {
+	return &sv_world.entities[node / MAX_ENT_CLUSTERS].links[node % MAX_ENT_CLUSTERS];
+}
+
+/**
+ * @brief Links the entity into the list of the given cluster, using the
+ * specified slot.
+ */
+static void Sv_LinkCluster(const uint16_t e, const int32_t slot, const int32_t cluster) {
+
+	sv_cluster_entity_t *ent = &sv_world.entities[e];
+	sv_cluster_link_t *link = &ent->links[slot];
+
+	const int32_t node = e * MAX_ENT_CLUSTERS + slot;
+
+	ent->clusters[slot] = cluster;
+
+	link->prev = -1;
+	link->next = sv_world.cluster_entities[cluster];
+
+	if (link->next != -1) {
+		Sv_ClusterLink(link->next)->prev = node;
+	}
+
+	sv_world.cluster_entities[cluster] = node;
+}
+
+/**
+ * @brief Removes the entity from every cluster list it is linked into.
+ */
+static void Sv_UnlinkClusters(const uint16_t e) {
+
+	sv_cluster_entity_t *ent = &sv_world.entities[e];
+
+	for (int32_t i = 0; i < ent->num_clusters; i++) {
+		const sv_cluster_link_t *link = &ent->links[i];
+
+		if (link->prev == -1) {
+			sv_world.cluster_entities[ent->clusters[i]] = link->next;
+		} else {
+			Sv_ClusterLink(link->prev)->next = link->next;
+		}
+
+		if (link->next != -1) {
+			Sv_ClusterLink(link->next)->prev = link->prev;
+		}
+	}
+
+	ent->num_clusters = 0;
+}
+
+/**
+ * @brief Marks the entities in the specified cluster list.
+ */
+static void Sv_MarkClusterEntities(const int32_t cluster, byte *entities) {
+
+	for (int32_t node = sv_world.cluster_entities[cluster]; node != -1; ) {
+		const int32_t e = node / MAX_ENT_CLUSTERS;
+
+		entities[e >> 3] |= 1 << (e & 7);
+		node = Sv_ClusterLink(node)->next;
+	}
+}
+
+/**
+ * @brief Marks every entity linked to a cluster set in the given visibility
+ * vector, as well as every entity that is too large to be linked to clusters,
+ * in the specified entity bit vector. Callers must still test each marked
+ * entity for visibility, but need not test the others.
+ */
+void Sv_ClusterEntities(const byte *vis, byte *entities) {
+
+	const int32_t num_clusters = Cm_NumClusters();
+
+	for (int32_t i = 0; i < num_clusters; i += 8) {
+
+		const byte bits = vis[i >> 3];
+		if (!bits)
+			continue;
 
-	Sv_CreateSector(0, sv.cm_models[0]->mins, sv.cm_models[0]->maxs);
+		for (int32_t j = 0; j < 8 && i + j < num_clusters; j++) {
+			if (bits & (1 << j)) {
+				Sv_MarkClusterEntities(i + j, entities);
+			}
+		}
+	}
+
+	Sv_MarkClusterEntities(LARGE_ENTITIES, entities);
 }
 
 /**
@@ -110,16 +234,67 @@ void Sv_InitWorld(void) {
  */
 void Sv_UnlinkEntity(g_entity_t *ent) {
 
-	sv_entity_t *sent = &sv.entities[NUM_FOR_ENTITY(ent)];
+	const uint16_t e = NUM_FOR_ENTITY(ent);
+
+	if (Sv_GridUnlink(&sv_world.grid, e)) {
+		sv_entity_t *sent = &sv.entities[e];
+
+		Sv_UnlinkClusters(e);
 
-	if (sent->sector) {
-		sv_sector_t *sector = (sv_sector_t *) sent->sector;
-		sector->entities = g_list_remove(sector->entities, ent);
+		const sv_entity_transform_t transform = sent->transform;
 
 		memset(sent, 0, sizeof(*sent));
+
+		sent->transform = transform;
 	}
 }
 
+/**
+ * @brief Updates the clipping transform of the specified entity, if it has
+ * moved, rotated or resized since it was last linked.
+ */
+static void Sv_UpdateEntityTransform(const g_entity_t *ent, sv_entity_transform_t *transform) {
+
+	const vec_t *angles = ent->solid == SOLID_BSP ? ent->s.angles : vec3_origin;
+
+	if (transform->valid &&
+			VectorCompare(transform->origin, ent->s.origin) &&
+			VectorCompare(transform->angles, angles) &&
+			VectorCompare(transform->mins, ent->mins) &&
+			VectorCompare(transform->maxs, ent->maxs)) {
+		return;
+	}
+
+	VectorCopy(ent->s.origin, transform->origin);
+	VectorCopy(angles, transform->angles);
+	VectorCopy(ent->mins, transform->mins);
+	VectorCopy(ent->maxs, transform->maxs);
+
+	Matrix4x4_CreateFromEntity(&transform->matrix, ent->s.origin, angles, 1.0);
+	Matrix4x4_Invert_Simple(&transform->inverse_matrix, &transform->matrix);
+
+	ClearBounds(transform->abs_mins, transform->abs_maxs);
+
+	for (int32_t i = 0; i < 8; i++) {
+		vec3_t corner, point;
+
+		corner[0] = (i & 1) ? ent->maxs[0] : ent->mins[0];
+		corner[1] = (i & 2) ? ent->maxs[1] : ent->mins[1];
+		corner[2] = (i & 4) ? ent->maxs[2] : ent->mins[2];
+
+		Matrix4x4_Transform(&transform->matrix, corner, point);
+		AddPointToBounds(point, transform->abs_mins, transform->abs_maxs);
+	}
+
+	// spread the bounds just as the entity's absolute bounds are
+	for (int32_t i = 0; i < 3; i++) {
+		transform->abs_mins[i] -= 1.0;
+		transform->abs_maxs[i] += 1.0;
+	}
+
+	transform->valid = true;
+}
+
 /**
  * @brief Called whenever an entity changes origin, mins, maxs, or solid to add it to
  * the clipping hull.
@@ -193,6 +368,8 @@ void Sv_LinkEntity(g_entity_t *ent) {
 	sent->areas[0] = sent->areas[1] = 0;
 
 	// get all leafs, including solids
+	Sv_CaptureQuery(CM_CAPTURE_BOX_LEAFNUMS, NULL, NULL, ent->abs_mins, ent->abs_maxs, 0);
+
 	const size_t len = Cm_BoxLeafnums(ent->abs_mins, ent->abs_maxs, leafs, lengthof(leafs),
 			&top_node, 0);
 
@@ -238,51 +415,47 @@ void Sv_LinkEntity(g_entity_t *ent) {
 		}
 	}
 
-	if (ent->solid == SOLID_NOT)
-		return;
+	// link it into the lists of the clusters it touches, for Sv_ClusterEntities
+	const uint16_t e = NUM_FOR_ENTITY(ent);
 
-	// find the first sector that the ent's box crosses
-	sv_sector_t *sector = sv_world.sectors;
-	while (true) {
+	Sv_UnlinkClusters(e);
 
-		if (sector->axis == -1)
-			break;
-
-		if (ent->abs_mins[sector->axis] > sector->dist)
-			sector = sector->children[0];
-		else if (ent->abs_maxs[sector->axis] < sector->dist)
-			sector = sector->children[1];
-		else
-			break; // crosses the node
+	if (sent->num_clusters == -1) {
+		Sv_LinkCluster(e, 0, LARGE_ENTITIES);
+		sv_world.entities[e].num_clusters = 1;
+	} else {
+		for (i = 0; i < (size_t) sent->num_clusters; i++) {
+			Sv_LinkCluster(e, i, sent->clusters[i]);
+		}
+		sv_world.entities[e].num_clusters = sent->num_clusters;
 	}
 
-	// add it to the sector
-	sent->sector = sector;
-	sector->entities = g_list_prepend(sector->entities, ent);
+	if (ent->solid == SOLID_NOT)
+		return;
 
-	// and update its clipping matrices
-	const vec_t *angles = ent->solid == SOLID_BSP ? ent->s.angles : vec3_origin;
+	// add it to the spatial index
+	Sv_GridLink(&sv_world.grid, e, ent->abs_mins, ent->abs_maxs);
 
-	Matrix4x4_CreateFromEntity(&sent->matrix, ent->s.origin, angles, 1.0);
-	Matrix4x4_Invert_Simple(&sent->inverse_matrix, &sent->matrix);
+	// and update its clipping transform
+	Sv_UpdateEntityTransform(ent, &sent->transform);
 }
 
 /**
  * @return True if the entity matches the current world filter, false otherwise.
  */
-static _Bool Sv_BoxEntities_Filter(const g_entity_t *ent) {
+static _Bool Sv_BoxEntities_Filter(const sv_box_entities_t *data, const g_entity_t *ent) {
 
 	switch (ent->solid) {
 		case SOLID_TRIGGER:
 		case SOLID_PROJECTILE:
-			if (sv_world.box_type & BOX_OCCUPY)
+			if (data->box_type & BOX_OCCUPY)
 				return true;
 			break;
 
 		case SOLID_DEAD:
 		case SOLID_BOX:
 		case SOLID_BSP:
-			if (sv_world.box_type & BOX_COLLIDE)
+			if (data->box_type & BOX_COLLIDE)
 				return true;
 			break;
 
@@ -294,40 +467,26 @@ static _Bool Sv_BoxEntities_Filter(const g_entity_t *ent) {
 }
 
 /**
- * @brief
+ * @brief GridQueryFunc for Sv_BoxEntities, which accumulates the entities
+ * matching the filter.
  */
-static void Sv_BoxEntities_r(sv_sector_t *sector) {
-
-	GList *e = sector->entities;
-	while (e) {
-		g_entity_t *ent = (g_entity_t *) e->data;
+static _Bool Sv_BoxEntities_Query(int32_t e, void *data) {
+	sv_box_entities_t *box = (sv_box_entities_t *) data;
 
-		if (Sv_BoxEntities_Filter(ent)) {
+	g_entity_t *ent = ENTITY_FOR_NUM(e);
 
-			if (BoxIntersect(ent->abs_mins, ent->abs_maxs, sv_world.box_mins, sv_world.box_maxs)) {
+	if (Sv_BoxEntities_Filter(box, ent)) {
 
-				sv_world.box_entities[sv_world.num_box_entities] = ent;
-				sv_world.num_box_entities++;
+		box->box_entities[box->num_box_entities] = ent;
+		box->num_box_entities++;
 
-				if (sv_world.num_box_entities == sv_world.max_box_entities) {
-					Com_Warn("sv_world.max_box_entities reached\n");
-					return;
-				}
-			}
+		if (box->num_box_entities == box->max_box_entities) {
+			Com_Warn("max_box_entities reached\n");
+			return false;
 		}
-
-		e = e->next;
 	}
 
-	if (sector->axis == -1)
-		return; // terminal node
-
-	// recurse down both sides
-	if (sv_world.box_maxs[sector->axis] > sector->dist)
-		Sv_BoxEntities_r(sector->children[0]);
-
-	if (sv_world.box_mins[sector->axis] < sector->dist)
-		Sv_BoxEntities_r(sector->children[1]);
+	return true;
 }
 
 /**
@@ -340,20 +499,18 @@ static void Sv_BoxEntities_r(sv_sector_t *sector) {
 size_t Sv_BoxEntities(const vec3_t mins, const vec3_t maxs, g_entity_t **list, const size_t len,
 		const uint32_t type) {
 
-	sv_world.box_mins = mins;
-	sv_world.box_maxs = maxs;
-	sv_world.box_entities = list;
-	sv_world.num_box_entities = 0;
-	sv_world.max_box_entities = len;
-	sv_world.box_type = type;
+	sv_box_entities_t data = {
+		.box_mins = mins,
+		.box_maxs = maxs,
+		.box_entities = list,
+		.num_box_entities = 0,
+		.max_box_entities = len,
+		.box_type = type
+	};
 
-	Sv_BoxEntities_r(sv_world.sectors);
-	
-	sv_world.box_mins = vec3_origin;
-	sv_world.box_maxs = vec3_origin;
-	sv_world.box_entities = NULL;
+	Sv_GridQuery(&sv_world.grid, mins, maxs, Sv_BoxEntities_Query, &data);
 
-	return sv_world.num_box_entities;
+	return data.num_box_entities;
 }
 
 /**
@@ -393,6 +550,8 @@ int32_t Sv_PointContents(const vec3_t point) {
 	g_entity_t *entities[MAX_ENTITIES];
 
 	// get base contents from world
+	Sv_CaptureQuery(CM_CAPTURE_POINT_CONTENTS, point, NULL, NULL, NULL, 0);
+
 	int32_t contents = Cm_PointContents(point, 0);
 
 	// as well as contents from all intersected entities
@@ -406,7 +565,7 @@ int32_t Sv_PointContents(const vec3_t point) {
 		if (head_node != -1) {
 
 			const sv_entity_t *sent = &sv.entities[NUM_FOR_ENTITY(ent)];
-			contents |= Cm_TransformedPointContents(point, head_node, &sent->inverse_matrix);
+			contents |= Cm_TransformedPointContents(point, head_node, &sent->transform.inverse_matrix);
 		}
 	}
 
@@ -465,10 +624,16 @@ static void Sv_ClipTraceToEntities(sv_trace_t *trace) {
 		if (head_node != -1) {
 
 			const sv_entity_t *sent = &sv.entities[NUM_FOR_ENTITY(ent)];
-			
+
+			// rotated models are linked with loose bounds, so test the tight ones
+			if (!BoxIntersect(trace->box_mins, trace->box_maxs,
+					sent->transform.abs_mins, sent->transform.abs_maxs)) {
+				continue;
+			}
+
 			const cm_trace_t tr = Cm_TransformedBoxTrace(
 				trace->start, trace->end, trace->mins, trace->maxs, head_node, trace->contents,
-				&sent->matrix, &sent->inverse_matrix);
+				&sent->transform.matrix, &sent->transform.inverse_matrix);
 
 			// check for a full or partial intersection
 			if (tr.all_solid || tr.fraction < trace->trace.fraction) {
@@ -519,6 +684,8 @@ cm_trace_t Sv_Trace(const vec3_t start, const vec3_t end, const vec3_t mins, con
 		maxs = vec3_origin;
 
 	// clip to world
+	Sv_CaptureQuery(CM_CAPTURE_BOX_TRACE, start, end, mins, maxs, contents);
+
 	trace.trace = Cm_BoxTrace(start, end, mins, maxs, 0, contents);
 	if (trace.trace.fraction < 1.0) {
 		trace.trace.ent = svs.game->entities;
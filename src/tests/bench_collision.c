@@ -0,0 +1,334 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <SDL2/SDL_timer.h>
+
+#include "tests.h"
+#include "collision/cmodel.h"
+
+/**
+ * @brief The number of traces issued by each benchmark, unless overridden.
+ */
+#define BENCH_TRACES 0x10000
+
+/**
+ * @brief The traces per batch, approximating a burst of shotgun pellets.
+ */
+#define BENCH_BATCH 32
+
+static vec3_t mins = { -16.0, -16.0, -24.0 };
+static vec3_t maxs = { 16.0, 16.0, 32.0 };
+
+static vec_t *starts[3], *ends[3];
+static cm_trace_t *scalar, *batch;
+
+/**
+ * @return The current time, in nanoseconds.
+ */
+static uint64_t Bench_Nanoseconds(void) {
+	return SDL_GetPerformanceCounter() * 1000000000.0 / SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Populates the benchmark corpus with bursts of traces fanning out from
+ * random points within the world model.
+ */
+static void Bench_Populate(const cm_bsp_model_t *world, size_t count) {
+
+	for (int32_t i = 0; i < 3; i++) {
+		starts[i] = Mem_Malloc(count * sizeof(vec_t));
+		ends[i] = Mem_Malloc(count * sizeof(vec_t));
+	}
+
+	scalar = Mem_Malloc(count * sizeof(cm_trace_t));
+	batch = Mem_Malloc(count * sizeof(cm_trace_t));
+
+	vec3_t origin, dir;
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (i % BENCH_BATCH == 0) {
+			for (int32_t j = 0; j < 3; j++) {
+				origin[j] = world->mins[j] + Randomf() * (world->maxs[j] - world->mins[j]);
+				dir[j] = Randomc();
+			}
+			VectorNormalize(dir);
+		}
+
+		for (int32_t j = 0; j < 3; j++) {
+			starts[j][i] = origin[j];
+			ends[j][i] = origin[j] + (dir[j] + Randomc() * 0.1) * 1024.0;
+		}
+	}
+}
+
+/**
+ * @brief Times Cm_BoxTrace against Cm_BoxTraceBatch over the corpus, and
+ * verifies that they agree.
+ */
+static void Bench_BoxTrace(size_t count) {
+
+	Cm_ClearTraceStats();
+
+	uint64_t start = Bench_Nanoseconds();
+
+	for (size_t i = 0; i < count; i++) {
+		const vec3_t s = { starts[0][i], starts[1][i], starts[2][i] };
+		const vec3_t e = { ends[0][i], ends[1][i], ends[2][i] };
+
+		scalar[i] = Cm_BoxTrace(s, e, mins, maxs, 0, MASK_CLIP_PLAYER);
+	}
+
+	const uint64_t scalar_ns = Bench_Nanoseconds() - start;
+
+	const cm_trace_stats_t stats = Cm_TraceStats();
+
+	start = Bench_Nanoseconds();
+
+	for (size_t i = 0; i < count; i += BENCH_BATCH) {
+		const size_t len = MIN(count - i, (size_t) BENCH_BATCH);
+
+		const vec_t *s[3] = { starts[0] + i, starts[1] + i, starts[2] + i };
+		const vec_t *e[3] = { ends[0] + i, ends[1] + i, ends[2] + i };
+
+		Cm_BoxTraceBatch(len, s, e, mins, maxs, 0, MASK_CLIP_PLAYER, batch + i);
+	}
+
+	const uint64_t batch_ns = Bench_Nanoseconds() - start;
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (fabsf(scalar[i].fraction - batch[i].fraction) > 0.0001 ||
+				scalar[i].all_solid != batch[i].all_solid) {
+			mismatches++;
+		}
+	}
+
+	Com_Print("Cm_BoxTrace      %8.1f ns/trace\n", scalar_ns / (double) count);
+	Com_Print("Cm_BoxTraceBatch %8.1f ns/trace (%d per batch)\n", batch_ns / (double) count, BENCH_BATCH);
+	Com_Print("%zu of %zu traces differ\n", mismatches, count);
+
+	Com_Print("%.1f brushes tested, %.1f skipped per trace\n",
+			stats.brushes_tested / (double) stats.traces, stats.brushes_skipped / (double) stats.traces);
+}
+
+/**
+ * @brief Times Cm_BoxTrace over the corpus with the BSP and then with a BVH
+ * built for every model.
+ */
+static void Bench_Bvh(const char *map, size_t count) {
+	extern int32_t cm_bvh_mode;
+
+	const int32_t modes[] = { CM_BVH_NEVER, CM_BVH_ALWAYS };
+	const char *names[] = { "BSP", "BVH" };
+
+	for (size_t m = 0; m < lengthof(modes); m++) {
+		int64_t size;
+
+		cm_bvh_mode = modes[m];
+		Cm_LoadBspModel(map, &size);
+
+		Cm_ClearTraceStats();
+
+		const uint64_t start = Bench_Nanoseconds();
+
+		for (size_t i = 0; i < count; i++) {
+			const vec3_t s = { starts[0][i], starts[1][i], starts[2][i] };
+			const vec3_t e = { ends[0][i], ends[1][i], ends[2][i] };
+
+			Cm_BoxTrace(s, e, mins, maxs, 0, MASK_CLIP_PLAYER);
+		}
+
+		const uint64_t ns = Bench_Nanoseconds() - start;
+		const cm_trace_stats_t stats = Cm_TraceStats();
+
+		Com_Print("Cm_BoxTrace (%s) %8.1f ns/trace, %.1f brushes tested per trace\n", names[m],
+				ns / (double) count, stats.brushes_tested / (double) stats.traces);
+	}
+
+	cm_bvh_mode = CM_BVH_NEVER;
+}
+
+/**
+ * @brief Per-query-type timings for a replayed capture.
+ */
+typedef struct {
+	const char *name;
+	uint64_t *samples;
+	size_t count;
+	uint64_t total;
+} bench_timings_t;
+
+/**
+ * @brief Sort comparator for timings.
+ */
+static int32_t Bench_CompareSamples(const void *a, const void *b) {
+	const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * @brief Prints the percentiles and throughput of the given timings.
+ */
+static void Bench_PrintTimings(bench_timings_t *t) {
+
+	if (!t->count) {
+		return;
+	}
+
+	qsort(t->samples, t->count, sizeof(uint64_t), Bench_CompareSamples);
+
+	const uint64_t *s = t->samples;
+	const size_t n = t->count;
+
+	Com_Print("%-18s %9zu ops  p50 %6" PRIu64 "  p90 %6" PRIu64 "  p99 %6" PRIu64
+			"  p99.9 %7" PRIu64 "  max %8" PRIu64 " ns  %10.0f ops/sec\n", t->name, n,
+			s[n / 2], s[n * 90 / 100], s[n * 99 / 100], s[n * 999 / 1000], s[n - 1],
+			n / (t->total / 1000000000.0));
+}
+
+/**
+ * @brief Replays a collision capture recorded by the server with
+ * `sv_collision_capture`, timing each query individually.
+ */
+static void Bench_Replay(const char *path, const int32_t iterations) {
+	void *buffer;
+
+	const int64_t len = Fs_Load(path, &buffer);
+	if (len < (int64_t) sizeof(cm_capture_header_t)) {
+		Com_Error(ERR_FATAL, "Failed to load %s\n", path);
+	}
+
+	const cm_capture_header_t *header = (cm_capture_header_t *) buffer;
+	if (header->magic != CM_CAPTURE_MAGIC) {
+		Com_Error(ERR_FATAL, "%s is not a collision capture\n", path);
+	}
+
+	const cm_capture_t *captures = (cm_capture_t *) (header + 1);
+	const size_t count = (len - sizeof(*header)) / sizeof(cm_capture_t);
+
+	int64_t size;
+	Cm_LoadBspModel(header->map, &size);
+
+	Com_Print("Replaying %zu queries from %s against %s, %d times\n", count, path, header->map,
+			iterations);
+
+	bench_timings_t timings[CM_CAPTURE_TYPES] = {
+		[CM_CAPTURE_BOX_TRACE] = { .name = "Cm_BoxTrace" },
+		[CM_CAPTURE_POINT_CONTENTS] = { .name = "Cm_PointContents" },
+		[CM_CAPTURE_BOX_LEAFNUMS] = { .name = "Cm_BoxLeafnums" },
+	};
+
+	for (int32_t i = 0; i < CM_CAPTURE_TYPES; i++) {
+		timings[i].samples = Mem_Malloc(count * iterations * sizeof(uint64_t));
+	}
+
+	Cm_ClearTraceStats();
+
+	for (int32_t i = 0; i < iterations; i++) {
+
+		const cm_capture_t *c = captures;
+		for (size_t j = 0; j < count; j++, c++) {
+			int32_t leafs[MAX_ENTITIES];
+
+			if (c->type < 0 || c->type >= CM_CAPTURE_TYPES) {
+				Com_Error(ERR_FATAL, "Invalid capture type %d at %zu\n", c->type, j);
+			}
+
+			const uint64_t start = Bench_Nanoseconds();
+
+			switch (c->type) {
+				case CM_CAPTURE_BOX_TRACE:
+					Cm_BoxTrace(c->start, c->end, c->mins, c->maxs, 0, c->contents);
+					break;
+				case CM_CAPTURE_POINT_CONTENTS:
+					Cm_PointContents(c->start, 0);
+					break;
+				case CM_CAPTURE_BOX_LEAFNUMS:
+					Cm_BoxLeafnums(c->mins, c->maxs, leafs, lengthof(leafs), NULL, 0);
+					break;
+			}
+
+			const uint64_t ns = Bench_Nanoseconds() - start;
+
+			bench_timings_t *t = &timings[c->type];
+
+			t->samples[t->count++] = ns;
+			t->total += ns;
+		}
+	}
+
+	const cm_trace_stats_t stats = Cm_TraceStats();
+
+	for (int32_t i = 0; i < CM_CAPTURE_TYPES; i++) {
+		Bench_PrintTimings(&timings[i]);
+		Mem_Free(timings[i].samples);
+	}
+
+	if (stats.traces) {
+		Com_Print("%.1f brushes tested, %.1f skipped per trace\n",
+				stats.brushes_tested / (double) stats.traces, stats.brushes_skipped / (double) stats.traces);
+	}
+
+	Fs_Free(buffer);
+}
+
+/**
+ * @brief Benchmark entry point.
+ *
+ * Usage: bench_collision [map] [traces]
+ *        bench_collision -replay <capture> [iterations]
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	Fs_Init(true);
+
+	if (argc > 2 && !g_strcmp0(argv[1], "-replay")) {
+		const int32_t iterations = argc > 3 ? atoi(argv[3]) : 1;
+
+		Bench_Replay(argv[2], MAX(iterations, 1));
+	} else {
+		const char *map = argc > 1 ? argv[1] : "maps/torn.bsp";
+		const size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : BENCH_TRACES;
+
+		int64_t size;
+		const cm_bsp_model_t *world = Cm_LoadBspModel(map, &size);
+
+		Com_Print("Loaded %s (%" PRId64 " bytes)\n", map, size);
+
+		Bench_Populate(world, count);
+
+		Bench_BoxTrace(count);
+
+		Bench_Bvh(map, count);
+	}
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return 0;
+}
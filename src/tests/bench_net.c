@@ -0,0 +1,252 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+
+#include <SDL2/SDL_timer.h>
+
+#include "tests.h"
+#include "filesystem.h"
+#include "net/net_huffman.h"
+
+/**
+ * @brief The number of times each message is encoded and decoded.
+ */
+#define BENCH_ITERATIONS 16
+
+/**
+ * @brief Benchmark state, accumulated over all demos.
+ */
+static struct {
+	uint64_t messages;
+	uint64_t raw_bytes;
+	uint64_t packet_bytes; // what would be sent, falling back to raw
+	uint64_t compressed; // messages which compression made smaller
+
+	uint64_t encode_ns;
+	uint64_t decode_ns;
+
+	uint64_t freqs[256];
+	_Bool train;
+} bench;
+
+/**
+ * @return The current time, in nanoseconds.
+ */
+static uint64_t Bench_Nanoseconds(void) {
+	return SDL_GetPerformanceCounter() * 1000000000.0 / SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Encodes and decodes the given message, timing both, and verifies the
+ * round trip. When training, only the byte frequencies are gathered.
+ */
+static void Bench_Message(const byte *data, size_t len) {
+	byte encoded[MAX_MSG_SIZE], decoded[MAX_MSG_SIZE];
+
+	if (bench.train) {
+		for (size_t i = 0; i < len; i++) {
+			bench.freqs[data[i]]++;
+		}
+		return;
+	}
+
+	size_t size = 0;
+
+	uint64_t start = Bench_Nanoseconds();
+
+	for (int32_t i = 0; i < BENCH_ITERATIONS; i++) {
+		size = Net_HuffmanEncode(data, len, encoded, sizeof(encoded));
+	}
+
+	bench.encode_ns += Bench_Nanoseconds() - start;
+
+	start = Bench_Nanoseconds();
+
+	for (int32_t i = 0; i < BENCH_ITERATIONS; i++) {
+		if (!Net_HuffmanDecode(encoded, size, decoded, len)) {
+			Com_Error(ERR_FATAL, "Failed to decode %zu bytes\n", len);
+		}
+	}
+
+	bench.decode_ns += Bench_Nanoseconds() - start;
+
+	if (memcmp(data, decoded, len)) {
+		Com_Error(ERR_FATAL, "Decoded message differs\n");
+	}
+
+	bench.messages++;
+	bench.raw_bytes += len;
+
+	// as in Netchan_Compress, the encoding must pay for its length
+	if (size && size + 3 < len) {
+		bench.packet_bytes += size + 3;
+		bench.compressed++;
+	} else {
+		bench.packet_bytes += len + 1;
+	}
+}
+
+/**
+ * @brief Feeds each message of the given demo to the benchmark.
+ */
+static void Bench_Demo(const char *path, void *data __attribute__((unused))) {
+	void *buffer;
+
+	const int64_t len = Fs_Load(path, &buffer);
+	if (len == -1) {
+		Com_Warn("Failed to load %s\n", path);
+		return;
+	}
+
+	const byte *b = buffer, *end = b + len;
+	size_t count = 0;
+
+	while (b + sizeof(int32_t) <= end) {
+		int32_t size;
+
+		memcpy(&size, b, sizeof(size));
+		size = LittleLong(size);
+
+		b += sizeof(size);
+
+		if (size == -1) // properly terminated demo file
+			break;
+
+		if (size < 0 || size > MAX_MSG_SIZE || b + size > end) {
+			Com_Warn("%s is corrupt after %zu messages\n", path, count);
+			break;
+		}
+
+		Bench_Message(b, size);
+
+		b += size;
+		count++;
+	}
+
+	Com_Print("%s: %zu messages\n", path, count);
+
+	Fs_Free(buffer);
+}
+
+/**
+ * @brief Prints the gathered byte frequencies, scaled to 16 bits, in the form
+ * of the table in net_huffman.c, and returns them in `model`.
+ */
+static void Bench_PrintFrequencies(uint32_t *model) {
+	uint64_t max = 1;
+
+	for (int32_t i = 0; i < 256; i++) {
+		max = MAX(max, bench.freqs[i]);
+	}
+
+	Com_Print("// NET_HUFFMAN_MODEL %d\n", NET_HUFFMAN_MODEL + 1);
+	Com_Print("static const uint32_t net_huffman_freqs[256] = {\n");
+
+	for (int32_t i = 0; i < 256; i++) {
+		model[i] = MAX(bench.freqs[i] * 0xffff / max, 1u);
+		Com_Print("%s%u,%s", i % 16 ? " " : "\t", model[i], i % 16 == 15 ? "\n" : "");
+	}
+
+	Com_Print("};\n");
+}
+
+/**
+ * @brief Feeds the specified demos, or all demos in the search path, to the
+ * benchmark.
+ */
+static void Bench_Corpus(int32_t argc, char **argv) {
+
+	if (argc) {
+		for (int32_t i = 0; i < argc; i++) {
+			Bench_Demo(argv[i], NULL);
+		}
+	} else {
+		Fs_Enumerate("demos/*.demo", Bench_Demo, NULL);
+	}
+}
+
+/**
+ * @brief Prints the compression ratio and cost of the current model.
+ */
+static void Bench_PrintResults(void) {
+
+	if (bench.raw_bytes) {
+		Com_Print("%" PRIu64 " messages, %" PRIu64 " bytes\n", bench.messages, bench.raw_bytes);
+		Com_Print("Compressed %" PRIu64 " of %" PRIu64 " messages, ratio %.3f\n", bench.compressed,
+				bench.messages, bench.packet_bytes / (double) bench.raw_bytes);
+		Com_Print("Encode %.2f ns/byte, decode %.2f ns/byte\n",
+				bench.encode_ns / (double) (bench.raw_bytes * BENCH_ITERATIONS),
+				bench.decode_ns / (double) (bench.raw_bytes * BENCH_ITERATIONS));
+	} else {
+		Com_Print("No demos found\n");
+	}
+}
+
+/**
+ * @brief Benchmark entry point.
+ *
+ * Usage: bench_net [-train] [demo ...]
+ *
+ * Reports the compression ratio and the encode and decode cost of the static
+ * Huffman model over the messages of the specified demos, or of all demos
+ * found in the search path. With -train, prints a new model trained on those
+ * demos, and then reports the ratio and cost of the new model over them.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	Fs_Init(true);
+
+	Net_InitHuffman();
+
+	int32_t first = 1;
+
+	if (argc > 1 && !g_strcmp0(argv[1], "-train")) {
+		bench.train = true;
+		first++;
+	}
+
+	Bench_Corpus(argc - first, argv + first);
+
+	if (bench.train) {
+		uint32_t model[256];
+
+		Bench_PrintFrequencies(model);
+
+		// measure the new model over the corpus it was trained on
+		Net_InitHuffmanModel(model);
+
+		bench.train = false;
+		Bench_Corpus(argc - first, argv + first);
+	}
+
+	Bench_PrintResults();
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return 0;
+}
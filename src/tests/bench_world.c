@@ -0,0 +1,282 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <SDL2/SDL_timer.h>
+
+#include "tests.h"
+#include "server/sv_local.h"
+
+/**
+ * @brief The number of entities, unless overridden.
+ */
+#define BENCH_ENTITIES 1024
+
+/**
+ * @brief The number of moves and queries issued per entity.
+ */
+#define BENCH_ROUNDS 64
+
+static vec3_t world_mins = { -4096.0, -4096.0, -1024.0 };
+static vec3_t world_maxs = { 4096.0, 4096.0, 1024.0 };
+
+/**
+ * @brief An entity's bounds.
+ */
+typedef struct {
+	vec3_t mins, maxs;
+} bench_box_t;
+
+static bench_box_t *boxes;
+
+/**
+ * @brief The sector tree that the grid replaced: a fixed, four level kd-tree
+ * splitting on X and Y, with a GList of entities in each node.
+ */
+typedef struct bench_sector_s {
+	int32_t axis;
+	vec_t dist;
+	struct bench_sector_s *children[2];
+	GList *entities;
+} bench_sector_t;
+
+#define SECTOR_DEPTH	4
+#define SECTOR_NODES	32
+
+static bench_sector_t sectors[SECTOR_NODES];
+static uint16_t num_sectors;
+static bench_sector_t **entity_sectors;
+
+/**
+ * @brief Builds a uniformly subdivided tree for the given world size.
+ */
+static bench_sector_t *Bench_CreateSector(int32_t depth, vec3_t mins, vec3_t maxs) {
+	vec3_t size, mins1, maxs1, mins2, maxs2;
+
+	bench_sector_t *sector = &sectors[num_sectors++];
+
+	if (depth == SECTOR_DEPTH) {
+		sector->axis = -1;
+		sector->children[0] = sector->children[1] = NULL;
+		return sector;
+	}
+
+	VectorSubtract(maxs, mins, size);
+	sector->axis = size[0] > size[1] ? 0 : 1;
+
+	sector->dist = 0.5 * (maxs[sector->axis] + mins[sector->axis]);
+	VectorCopy(mins, mins1);
+	VectorCopy(mins, mins2);
+	VectorCopy(maxs, maxs1);
+	VectorCopy(maxs, maxs2);
+
+	maxs1[sector->axis] = mins2[sector->axis] = sector->dist;
+
+	sector->children[0] = Bench_CreateSector(depth + 1, mins2, maxs2);
+	sector->children[1] = Bench_CreateSector(depth + 1, mins1, maxs1);
+
+	return sector;
+}
+
+/**
+ * @brief Links the entity into the sector tree.
+ */
+static void Bench_SectorLink(int32_t e) {
+
+	if (entity_sectors[e]) {
+		entity_sectors[e]->entities = g_list_remove(entity_sectors[e]->entities, GINT_TO_POINTER(e));
+	}
+
+	bench_sector_t *sector = sectors;
+	while (sector->axis != -1) {
+		if (boxes[e].mins[sector->axis] > sector->dist)
+			sector = sector->children[0];
+		else if (boxes[e].maxs[sector->axis] < sector->dist)
+			sector = sector->children[1];
+		else
+			break;
+	}
+
+	entity_sectors[e] = sector;
+	sector->entities = g_list_prepend(sector->entities, GINT_TO_POINTER(e));
+}
+
+/**
+ * @return The number of entities in the sector tree intersecting the box.
+ */
+static size_t Bench_SectorQuery(const bench_sector_t *sector, const vec3_t mins, const vec3_t maxs) {
+	size_t count = 0;
+
+	for (const GList *e = sector->entities; e; e = e->next) {
+		const bench_box_t *box = &boxes[GPOINTER_TO_INT(e->data)];
+		if (BoxIntersect(box->mins, box->maxs, mins, maxs)) {
+			count++;
+		}
+	}
+
+	if (sector->axis == -1)
+		return count;
+
+	if (maxs[sector->axis] > sector->dist)
+		count += Bench_SectorQuery(sector->children[0], mins, maxs);
+
+	if (mins[sector->axis] < sector->dist)
+		count += Bench_SectorQuery(sector->children[1], mins, maxs);
+
+	return count;
+}
+
+/**
+ * @brief GridQueryFunc counting the results.
+ */
+static _Bool Bench_GridQuery(int32_t item __attribute__((unused)), void *data) {
+	(*(size_t *) data)++;
+	return true;
+}
+
+/**
+ * @return The current time, in nanoseconds.
+ */
+static uint64_t Bench_Nanoseconds(void) {
+	return SDL_GetPerformanceCounter() * 1000000000.0 / SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Moves the entity to a random position. Most entities are player
+ * sized, and a few are large movers.
+ */
+static void Bench_Move(int32_t e) {
+	vec3_t origin, size;
+
+	for (int32_t i = 0; i < 3; i++) {
+		origin[i] = world_mins[i] + Randomf() * (world_maxs[i] - world_mins[i]);
+		size[i] = (e % 16) ? 16.0 + Randomf() * 48.0 : 64.0 + Randomf() * 1024.0;
+	}
+
+	VectorSubtract(origin, size, boxes[e].mins);
+	VectorAdd(origin, size, boxes[e].maxs);
+}
+
+/**
+ * @brief Random query boxes, mixing point-sized and trace-sized boxes.
+ */
+static void Bench_QueryBox(int32_t i, vec3_t mins, vec3_t maxs) {
+	vec3_t origin;
+
+	const vec_t size = (i % 4) ? 32.0 : 512.0;
+
+	for (int32_t j = 0; j < 3; j++) {
+		origin[j] = world_mins[j] + Randomf() * (world_maxs[j] - world_mins[j]);
+		mins[j] = origin[j] - size;
+		maxs[j] = origin[j] + size;
+	}
+}
+
+/**
+ * @brief Benchmark entry point.
+ *
+ * Usage: bench_world [entities]
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	Mem_Init();
+
+	const int32_t count = argc > 1 ? atoi(argv[1]) : BENCH_ENTITIES;
+	const int32_t rounds = count * BENCH_ROUNDS;
+
+	boxes = Mem_Malloc(count * sizeof(bench_box_t));
+	entity_sectors = Mem_Malloc(count * sizeof(bench_sector_t *));
+
+	sv_grid_t grid;
+	Sv_InitGrid(&grid, world_mins, world_maxs, count);
+	Bench_CreateSector(0, world_mins, world_maxs);
+
+	for (int32_t i = 0; i < count; i++) {
+		Bench_Move(i);
+		Bench_SectorLink(i);
+		Sv_GridLink(&grid, i, boxes[i].mins, boxes[i].maxs);
+	}
+
+	// link and unlink, moving entities about the world
+	uint64_t sector_ns = 0, grid_ns = 0;
+
+	for (int32_t i = 0; i < rounds; i++) {
+		const int32_t e = i % count;
+		Bench_Move(e);
+
+		uint64_t start = Bench_Nanoseconds();
+		Bench_SectorLink(e);
+		sector_ns += Bench_Nanoseconds() - start;
+
+		start = Bench_Nanoseconds();
+		Sv_GridLink(&grid, e, boxes[e].mins, boxes[e].maxs);
+		grid_ns += Bench_Nanoseconds() - start;
+	}
+
+	Com_Print("Link      sectors %8.1f ns  grid %8.1f ns\n", sector_ns / (double) rounds,
+			grid_ns / (double) rounds);
+
+	// and query boxes, verifying that both agree
+	size_t sector_count = 0, grid_count = 0, mismatches = 0;
+	sector_ns = grid_ns = 0;
+
+	for (int32_t i = 0; i < rounds; i++) {
+		vec3_t mins, maxs;
+		Bench_QueryBox(i, mins, maxs);
+
+		uint64_t start = Bench_Nanoseconds();
+		const size_t s = Bench_SectorQuery(sectors, mins, maxs);
+		sector_ns += Bench_Nanoseconds() - start;
+
+		size_t g = 0;
+
+		start = Bench_Nanoseconds();
+		Sv_GridQuery(&grid, mins, maxs, Bench_GridQuery, &g);
+		grid_ns += Bench_Nanoseconds() - start;
+
+		sector_count += s;
+		grid_count += g;
+
+		if (s != g) {
+			mismatches++;
+		}
+	}
+
+	Com_Print("Query     sectors %8.1f ns  grid %8.1f ns  (%.1f entities per query)\n",
+			sector_ns / (double) rounds, grid_ns / (double) rounds, grid_count / (double) rounds);
+	Com_Print("%zu of %d queries differ (%zu vs %zu entities)\n", mismatches, rounds, sector_count,
+			grid_count);
+
+	Sv_FreeGrid(&grid);
+
+	for (uint16_t i = 0; i < num_sectors; i++) {
+		g_list_free(sectors[i].entities);
+	}
+
+	Mem_Free(boxes);
+	Mem_Free(entity_sectors);
+
+	Mem_Shutdown();
+
+	Test_Shutdown();
+	return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "cmd.h"
+#include "cvar.h"
+#include "net/net_chan.h"
+
+/**
+ * @brief The unreliable message, which is shorter than any reliable one.
+ */
+#define UNRELIABLE "frame"
+
+static net_chan_t client, server;
+
+static mem_buf_t msg;
+static byte buffer[MAX_MSG_SIZE];
+
+/**
+ * @brief The reliable stream written by the server and read by the client.
+ */
+static struct {
+	uint32_t written, read;
+	uint32_t unreliable; // the number of unreliable messages read
+} stream;
+
+/**
+ * @brief Setup fixture.
+ */
+void setup(void) {
+
+	Mem_Init();
+
+	Fs_Init(false);
+
+	Cmd_Init();
+
+	Cvar_Init();
+
+	Netchan_Init();
+
+	net_addr_t addr = { .type = NA_LOOP };
+
+	Netchan_Setup(NS_UDP_CLIENT, &client, &addr, 1);
+	Netchan_Setup(NS_UDP_SERVER, &server, &addr, 1);
+
+	Mem_InitBuffer(&msg, buffer, sizeof(buffer));
+
+	memset(&stream, 0, sizeof(stream));
+
+	srand(1);
+}
+
+/**
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+
+	Netchan_Release(&client);
+	Netchan_Release(&server);
+
+	Netchan_Shutdown();
+
+	Cvar_Shutdown();
+
+	Cmd_Shutdown();
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+}
+
+/**
+ * @brief Writes a reliable message of random length, with a payload derived
+ * from its position in the stream, to the server, if there is room for it.
+ */
+static void Check_WriteReliable(void) {
+
+	const int32_t len = 1 + rand() % 3000;
+
+	if (server.message.size + len + 6 < server.message.max_size) {
+
+		Net_WriteLong(&server.message, stream.written);
+		Net_WriteShort(&server.message, len);
+
+		for (int32_t i = 0; i < len; i++) {
+			Net_WriteByte(&server.message, (stream.written + i) & 0xff);
+		}
+
+		stream.written++;
+	}
+}
+
+/**
+ * @brief Reads the reliable messages, which must arrive in order and intact,
+ * and the unreliable message, if any, from the payload of a datagram received
+ * by the client.
+ */
+static void Check_ReadPayload(void) {
+
+	while (msg.size - msg.read > strlen(UNRELIABLE)) {
+
+		const uint32_t id = Net_ReadLong(&msg);
+		const int32_t len = Net_ReadShort(&msg);
+
+		ck_assert_uint_eq(id, stream.read);
+
+		for (int32_t i = 0; i < len; i++) {
+			ck_assert_int_eq(Net_ReadByte(&msg), (id + i) & 0xff);
+		}
+
+		stream.read++;
+	}
+
+	if (msg.read < msg.size) {
+		ck_assert(msg.size - msg.read == strlen(UNRELIABLE));
+		ck_assert(!memcmp(msg.data + msg.read, UNRELIABLE, strlen(UNRELIABLE)));
+
+		stream.unreliable++;
+	}
+}
+
+/**
+ * @brief Receives the datagrams for the specified channel, discarding `loss`
+ * percent of them.
+ */
+static void Check_Receive(net_chan_t *chan, int32_t loss) {
+	net_addr_t from;
+
+	while (Net_ReceiveDatagram(chan->source, &from, &msg)) {
+
+		ck_assert_msg(msg.size <= NETCHAN_MTU, "%zu byte datagram", msg.size);
+
+		if (rand() % 100 < loss)
+			continue;
+
+		if (!Netchan_Process(chan, &msg))
+			continue;
+
+		if (chan == &client) {
+			Check_ReadPayload();
+		}
+	}
+}
+
+/**
+ * @brief Streams reliable messages from the server to the client, with the
+ * specified packet loss, and ensures that every message is delivered.
+ */
+static void Check_Stream(int32_t loss) {
+
+	for (int32_t frame = 0; frame < 20000; frame++) {
+
+		quetoo.time = frame * 10;
+
+		if (frame < 15000 && rand() % 3 == 0) {
+			Check_WriteReliable();
+		}
+
+		Netchan_Transmit(&server, (byte *) UNRELIABLE, strlen(UNRELIABLE));
+		Check_Receive(&client, loss);
+
+		Netchan_Transmit(&client, NULL, 0);
+		Check_Receive(&server, loss);
+	}
+
+	ck_assert_uint_gt(stream.written, 0);
+	ck_assert_uint_eq(stream.read, stream.written);
+	ck_assert_uint_gt(stream.unreliable, 0);
+
+	ck_assert(!Netchan_Pending(&server));
+}
+
+START_TEST(check_Netchan_Transmit)
+	{
+		Check_Stream(0);
+	}END_TEST
+
+START_TEST(check_Netchan_Transmit_Loss)
+	{
+		Check_Stream(30);
+	}END_TEST
+
+START_TEST(check_Netchan_Transmit_Compress)
+	{
+		client.compress = server.compress = true;
+
+		Check_Stream(30);
+	}END_TEST
+
+/**
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_net_chan");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+	tcase_set_timeout(tcase, 60);
+
+	tcase_add_test(tcase, check_Netchan_Transmit);
+	tcase_add_test(tcase, check_Netchan_Transmit_Loss);
+	tcase_add_test(tcase, check_Netchan_Transmit_Compress);
+
+	Suite *suite = suite_create("check_net_chan");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "net/net_message.h"
+
+static mem_buf_t msg;
+static byte buffer[1024];
+
+/**
+ * @brief Setup fixture.
+ */
+void setup(void) {
+
+	Mem_InitBuffer(&msg, buffer, sizeof(buffer));
+
+	const vec3_t mins = { -4096.0, -4096.0, -1024.0 };
+	const vec3_t maxs = { 4096.0, 4096.0, 1024.0 };
+
+	Net_SetBounds(mins, maxs);
+}
+
+/**
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+}
+
+START_TEST(check_Net_WriteBits)
+	{
+		Net_WriteBits(&msg, 1, 1);
+		Net_WriteBits(&msg, 0x55, 7);
+		Net_WriteBits(&msg, 0x12345, 17);
+
+		ck_assert_msg(msg.size == 4, "Bits not packed: %zu bytes", msg.size);
+
+		Net_WriteByte(&msg, 0xaa);
+		Net_WriteBits(&msg, 0xdeadbeef, 32);
+
+		ck_assert_msg(msg.size == 9, "Bits not aligned after byte: %zu bytes", msg.size);
+
+		Net_BeginReading(&msg);
+
+		ck_assert_int_eq(Net_ReadBits(&msg, 1), 1);
+		ck_assert_int_eq(Net_ReadBits(&msg, 7), 0x55);
+		ck_assert_int_eq(Net_ReadBits(&msg, 17), 0x12345);
+		ck_assert_int_eq(Net_ReadByte(&msg), 0xaa);
+		ck_assert_uint_eq(Net_ReadBits(&msg, 32), 0xdeadbeef);
+
+		ck_assert(msg.read == msg.size);
+
+	}END_TEST
+
+START_TEST(check_Net_WriteQuantizedPosition)
+	{
+		const vec3_t inside = { 1234.5678, -4000.0, 1023.99 };
+		const vec3_t outside = { 1.0, 2.0, 3000.0 };
+
+		Net_WriteQuantizedPosition(&msg, inside);
+		Net_WriteQuantizedPosition(&msg, outside);
+
+		Net_BeginReading(&msg);
+
+		vec3_t pos;
+
+		Net_ReadQuantizedPosition(&msg, pos);
+		for (int32_t i = 0; i < 3; i++) {
+			ck_assert(fabsf(pos[i] - inside[i]) <= 0.5 / (1 << NET_POSITION_PRECISION));
+		}
+
+		Net_ReadQuantizedPosition(&msg, pos);
+		ck_assert(VectorCompare(pos, outside));
+
+		ck_assert(msg.read == msg.size);
+
+	}END_TEST
+
+START_TEST(check_Net_WriteDir)
+	{
+		for (int32_t i = 0; i < NUM_APPROXIMATE_NORMALS; i++) {
+			vec3_t dir;
+
+			Mem_ClearBuffer(&msg);
+
+			Net_WriteDir(&msg, approximate_normals[i]);
+
+			ck_assert(msg.size == 2);
+
+			Net_BeginReading(&msg);
+			Net_ReadDir(&msg, dir);
+
+			ck_assert_msg(DotProduct(dir, approximate_normals[i]) > 0.999, "Normal %d", i);
+		}
+
+	}END_TEST
+
+/**
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_net_message");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Net_WriteBits);
+	tcase_add_test(tcase, check_Net_WriteQuantizedPosition);
+	tcase_add_test(tcase, check_Net_WriteDir);
+
+	Suite *suite = suite_create("check_net_message");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
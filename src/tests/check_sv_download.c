@@ -0,0 +1,180 @@
+/*
+ * Copyright(c) 1997-2001 id Software, Inc.
+ * Copyright(c) 2002 The Quakeforge Project.
+ * Copyright(c) 2006 Quetoo.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "tests.h"
+#include "server/sv_local.h"
+
+#define DOWNLOAD_NAME "check_sv_download.dat"
+#define DOWNLOAD_SIZE (3 * DOWNLOAD_CHUNK_SIZE + 123)
+
+static byte data[DOWNLOAD_SIZE];
+
+static sv_client_download_t download;
+
+/**
+ * @brief Setup fixture.
+ */
+void setup(void) {
+
+	Mem_Init();
+
+	Fs_Init(true);
+
+	for (int32_t i = 0; i < DOWNLOAD_SIZE; i++) {
+		data[i] = (i * 7 + 3) & 0xff;
+	}
+
+	file_t *file = Fs_OpenWrite(DOWNLOAD_NAME);
+	ck_assert_msg(file != NULL, "Failed to open %s", DOWNLOAD_NAME);
+
+	ck_assert(Fs_Write(file, data, 1, DOWNLOAD_SIZE) == DOWNLOAD_SIZE);
+	ck_assert(Fs_Close(file));
+
+	memset(&download, 0, sizeof(download));
+}
+
+/**
+ * @brief Teardown fixture.
+ */
+void teardown(void) {
+
+	Sv_CloseDownload(&download);
+
+	Fs_Unlink(DOWNLOAD_NAME);
+
+	Fs_Shutdown();
+
+	Mem_Shutdown();
+}
+
+/**
+ * @return The checksum of the bytes preceding offset, as the client sends it.
+ */
+static char *Check_Checksum(int64_t offset) {
+
+	const int64_t len = MIN(offset, DOWNLOAD_RESUME_CHECK);
+
+	return g_compute_checksum_for_data(G_CHECKSUM_SHA1, data + offset - len, len);
+}
+
+/**
+ * @brief Streams the open download with the specified budget per chunk, and
+ * ensures that the file is delivered intact from the offset at which it began.
+ */
+static void Check_Stream(size_t budget) {
+	byte buffer[DOWNLOAD_CHUNK_SIZE];
+
+	int64_t offset = download.count;
+
+	while (download.file) {
+		const int64_t len = Sv_ReadDownload(&download, buffer, budget);
+
+		ck_assert(len > 0 && len <= (int64_t) budget);
+		ck_assert(!memcmp(buffer, data + offset, len));
+
+		offset += len;
+		ck_assert_int_eq(download.count, offset);
+	}
+
+	ck_assert_int_eq(download.count, DOWNLOAD_SIZE);
+	ck_assert_int_eq(download.size, DOWNLOAD_SIZE);
+}
+
+START_TEST(check_Sv_ReadDownload)
+	{
+		ck_assert(Sv_OpenDownload(&download, DOWNLOAD_NAME, 0, ""));
+
+		Check_Stream(DOWNLOAD_CHUNK_SIZE);
+	}END_TEST
+
+START_TEST(check_Sv_OpenDownload_Resume)
+	{
+		const int64_t offset = DOWNLOAD_CHUNK_SIZE + 17;
+
+		char *checksum = Check_Checksum(offset);
+		ck_assert(Sv_OpenDownload(&download, DOWNLOAD_NAME, offset, checksum));
+		g_free(checksum);
+
+		ck_assert_int_eq(download.count, offset);
+
+		Check_Stream(DOWNLOAD_CHUNK_SIZE);
+	}END_TEST
+
+START_TEST(check_Sv_OpenDownload_Refuse)
+	{
+		const int64_t offset = DOWNLOAD_CHUNK_SIZE + 17;
+
+		char *checksum = Check_Checksum(offset - 1);
+		ck_assert(!Sv_OpenDownload(&download, DOWNLOAD_NAME, offset, checksum));
+		g_free(checksum);
+
+		ck_assert(download.file == NULL);
+
+		ck_assert(!Sv_OpenDownload(&download, DOWNLOAD_NAME, DOWNLOAD_SIZE + 1, ""));
+		ck_assert(!Sv_OpenDownload(&download, DOWNLOAD_NAME, -1, ""));
+		ck_assert(!Sv_OpenDownload(&download, "check_sv_download.missing", 0, ""));
+
+		ck_assert(download.file == NULL);
+	}END_TEST
+
+START_TEST(check_Sv_DownloadBudget)
+	{
+		ck_assert_uint_eq(Sv_DownloadBudget(0.0), 0);
+		ck_assert_uint_eq(Sv_DownloadBudget(-100.0), 0);
+
+		// the lowest rates can never accumulate a whole chunk, but must progress
+		for (int32_t rate = CLIENT_RATE_MIN; rate < DOWNLOAD_CHUNK_SIZE / RATE_BURST; rate += 1024) {
+			const size_t budget = Sv_DownloadBudget(rate * RATE_BURST);
+
+			ck_assert(budget >= DOWNLOAD_CHUNK_MIN && budget <= DOWNLOAD_CHUNK_SIZE);
+		}
+
+		ck_assert_uint_eq(Sv_DownloadBudget(1.0), DOWNLOAD_CHUNK_MIN);
+		ck_assert_uint_eq(Sv_DownloadBudget(1000000.0), DOWNLOAD_CHUNK_SIZE);
+
+		ck_assert(Sv_OpenDownload(&download, DOWNLOAD_NAME, 0, ""));
+
+		Check_Stream(Sv_DownloadBudget(CLIENT_RATE_MIN * RATE_BURST));
+	}END_TEST
+
+/**
+ * @brief Test entry point.
+ */
+int32_t main(int32_t argc, char **argv) {
+
+	Test_Init(argc, argv);
+
+	TCase *tcase = tcase_create("check_sv_download");
+	tcase_add_checked_fixture(tcase, setup, teardown);
+
+	tcase_add_test(tcase, check_Sv_ReadDownload);
+	tcase_add_test(tcase, check_Sv_OpenDownload_Resume);
+	tcase_add_test(tcase, check_Sv_OpenDownload_Refuse);
+	tcase_add_test(tcase, check_Sv_DownloadBudget);
+
+	Suite *suite = suite_create("check_sv_download");
+	suite_add_tcase(suite, tcase);
+
+	int32_t failed = Test_Run(suite);
+
+	Test_Shutdown();
+	return failed;
+}
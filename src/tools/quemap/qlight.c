@@ -166,6 +166,9 @@ int32_t LIGHT_Main(void) {
 
 	LightWorld();
 
+	// release the collision model, which maps the file we're about to rewrite
+	Cm_LoadBspModel(NULL, NULL);
+
 	WriteBSPFile(bsp_name);
 
 	const time_t end = time(NULL);